@@ -19,6 +19,7 @@
 # along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 import re
+import struct
 import sys	
 import egret_ext
 import egret_api
@@ -26,12 +27,31 @@ from optparse import OptionParser
 #import time
 
 # Precondition: regexStr successfully compiles and all strings in testStrings
-# match the regular expression
-def get_group_info(regexStr, testStrings):
+# match the regular expression (native is the result of egret_ext.match for
+# testStrings when it is already known)
+def get_group_info(regexStr, testStrings, native = None):
    # check for empty list
    if len(testStrings) == 0:
        return {}
 
+   # use the group spans found by the engine when it can match the regex
+   if native == None:
+       native = egret_ext.match(regexStr, testStrings)
+   if native != None:
+       (names, results) = native
+       if len(names) == 0:
+           return None
+       useNames = any(name != None for name in names)
+       groupDict = {}
+       for testStr, spans in zip(testStrings, results):
+           groups = [ None if span == None else testStr[span[0]:span[1]] for span in spans ]
+           if useNames:
+               groupDict[testStr] = { name: group for (name, group) in zip(names, groups)
+                   if name != None }
+           else:
+               groupDict[testStr] = tuple(groups)
+       return groupDict
+
    # compile regex
    regex = re.compile(regexStr)
 
@@ -55,16 +75,57 @@ def get_group_info(regexStr, testStrings):
 
    return groupDict
 
+# Writes the strings in the binary format described in src/BinaryOutput.h:
+# header, status, records (class byte + varint length + bytes) and an index
+# of record offsets.  Unlike the text output it can hold any string.
+def write_binary_output(fileName, status, matches, nonMatches):
+   def varint(n):
+       out = bytearray()
+       while n >= 0x80:
+           out.append((n & 0x7F) | 0x80)
+           n >>= 7
+       out.append(n)
+       return bytes(out)
+
+   headerSize = 24
+   body = bytearray()
+   statusBytes = status.encode("utf-8")
+   body += varint(len(statusBytes)) + statusBytes
+
+   offsets = []
+   records = [ (1, s) for s in sorted(matches) ] + [ (0, s) for s in sorted(nonMatches) ]
+   for (strClass, s) in records:
+       offsets.append(headerSize + len(body))
+       strBytes = s.encode("utf-8")
+       body += bytes([strClass]) + varint(len(strBytes)) + strBytes
+
+   header = b"EGRB" + struct.pack("<B3xQQ", 1, len(records), headerSize + len(body))
+   index = b"".join(struct.pack("<Q", offset) for offset in offsets)
+
+   binFile = open(fileName, "wb")
+   binFile.write(header + body + index)
+   binFile.close()
+
 parser = OptionParser()
 parser.add_option("-f", "--file", dest = "fileName", help = "file containing regex")
 parser.add_option("-r", "--regex", dest = "regex", help = "regular expression")
 parser.add_option("-b", "--base_substring", dest = "baseSubstring",
     default = "evil", help = "base substring for regex strings")
 parser.add_option("-o", "--output_file", dest = "outputFile", help = "output file name")
+parser.add_option("--binary", action = "store_true", dest = "binaryOutput",
+    default = False, help = "write output file in binary format")
 parser.add_option("-d", "--debug", action = "store_true", dest = "debugMode",
     default = False, help = "display debug info")
 parser.add_option("-s", "--stat", action = "store_true", dest = "statMode",
     default = False, help = "display stats")
+parser.add_option("--min-cover", action = "store_true", dest = "minCover",
+    default = False, help = "use the fewest paths that cover the regex")
+parser.add_option("--minimize", action = "store_true", dest = "minimize",
+    default = False, help = "drop strings that add no new coverage")
+parser.add_option("--mutate", dest = "mutations", default = "",
+    help = "mutations to apply to path strings (comma separated or all)")
+parser.add_option("--trace", dest = "traceFile", default = "",
+    help = "write a Chrome trace of the engine run to a file")
 parser.add_option("-g", "--groups", action = "store_true", dest = "showGroups",
     default = False, help = "show groups")
 opts, args = parser.parse_args()
@@ -73,6 +134,9 @@ opts, args = parser.parse_args()
 if opts.fileName != None and opts.regex != None:
     print("Cannot specify both a regular expression and input file")
     sys.exit(-1)
+if opts.binaryOutput and opts.outputFile == None:
+    print("Binary output requires an output file")
+    sys.exit(-1)
 
 # get the regular expression
 descStr = ""
@@ -91,7 +155,8 @@ else:
 
 # execute regex-test
 #start_time = time.process_time()
-inputStrs = egret_ext.run(regexStr, opts.baseSubstring, opts.debugMode, opts.statMode)
+inputStrs = egret_ext.run(regexStr, opts.baseSubstring, opts.debugMode, opts.statMode,
+    None, opts.minCover, opts.minimize, opts.mutations, opts.traceFile)
 status = inputStrs[0]
 inputStrs = inputStrs[1:]
 hasError = (status[0:5] == "ERROR")
@@ -99,21 +164,29 @@ hasWarning = (not hasError and status != "SUCCESS")
 
 if not hasError:
 
-  # test each string against the regex
+  # test each string against the regex (natively when the engine can,
+  # otherwise with re) - the native match also finds the group spans
   regex = re.compile(regexStr)
   matches = []
   nonMatches = []
-  for inputStr in inputStrs:
-    search = regex.fullmatch(inputStr)
-    if search:
+  matchSpans = []
+  native = egret_ext.match(regexStr, inputStrs)
+  if native == None:
+    results = [ () if regex.fullmatch(inputStr) else None for inputStr in inputStrs ]
+  else:
+    results = native[1]
+  for inputStr, spans in zip(inputStrs, results):
+    if spans != None:
         matches.append(inputStr)
+        matchSpans.append(spans)
     else:
         nonMatches.append(inputStr)
   #elapsed_time = time.process_time() - start_time
 
   # display groups if requested
   if opts.showGroups:
-      groupDict = get_group_info(regexStr, matches)
+      groupDict = get_group_info(regexStr, matches,
+          None if native == None else (native[0], matchSpans))
       if groupDict == None:
           showGroups = False
           if hasWarning:
@@ -140,6 +213,14 @@ if not hasError:
     #print(fmt.format("Time", elapsed_time))
 
 
+# write binary output
+if opts.binaryOutput:
+    if hasError:
+        write_binary_output(opts.outputFile, status, [], [])
+        sys.exit(-1)
+    write_binary_output(opts.outputFile, status, matches, nonMatches)
+    sys.exit(0)
+
 # write the output header
 header = "Regex: " + regexStr + "\n\n"
 if descStr != "":
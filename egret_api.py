@@ -21,8 +21,23 @@
 import re
 import egret_ext
 
-def run_egret(regexStr, baseSubstring, testList):
-    inputStrs = egret_ext.run(regexStr, baseSubstring, False, False)
+# Returns a session handle - passing it to run_egret lets the engine reuse work
+# from the previous regex when the new one is only a small edit
+def new_session():
+    return egret_ext.new_session()
+
+# Sets the memory limit in bytes for each engine run (0 for no limit)
+def set_memory_limit(numBytes):
+    egret_ext.set_memory_limit(numBytes)
+
+# Returns a dict with the predicted number of paths, strings and bytes a run
+# would produce (plus any warnings) without running it - raises
+# egret_ext.error if the regex cannot be processed
+def estimate_egret(regexStr, baseSubstring = "evil"):
+    return egret_ext.estimate(regexStr, baseSubstring)
+
+def run_egret(regexStr, baseSubstring, testList, engineSession = None):
+    inputStrs = egret_ext.run(regexStr, baseSubstring, False, False, engineSession)
     status = inputStrs[0]
     if status[0:5] == "ERROR":
         return ([], [], status, [])
@@ -37,10 +52,14 @@ def run_egret(regexStr, baseSubstring, testList):
     regex = re.compile(regexStr)
 
     inputStrs = sorted(list(set(inputStrs) | set(testList)))
-    
-    for inputStr in inputStrs:
-        search = regex.fullmatch(inputStr)
-        if search:
+
+    # the engine matches most regexes natively, re handles the rest
+    accepted = egret_ext.classify(regexStr, inputStrs)
+    if accepted == None:
+        accepted = [ regex.fullmatch(inputStr) != None for inputStr in inputStrs ]
+
+    for inputStr, isMatch in zip(inputStrs, accepted):
+        if isMatch:
             matches.append(inputStr)
         else:
             nonMatches.append(inputStr)
@@ -62,6 +81,29 @@ def get_group_info(regexStr, testStrings):
     if len(testStrings) == 0:
         return (None, None, None)
 
+    # use the group spans found by the engine when it can match the regex
+    native = egret_ext.match(regexStr, testStrings)
+    if native != None:
+        (names, results) = native
+        if len(names) == 0:
+            return (None, None, None)
+        useNames = any(name != None for name in names)
+        if useNames:
+            groupHdr = [ name for name in names if name != None ]
+        else:
+            groupHdr = [ str(i) for i in range(0, len(names)) ]
+        groupRows = []
+        for testStr, spans in zip(testStrings, results):
+            row = []
+            for name, span in zip(names, spans):
+                if useNames and name == None:
+                    continue
+                row.append(None if span == None else testStr[span[0]:span[1]])
+            row.insert(0, testStr)
+            groupRows.append(row)
+        groupHdr.insert(0, 'String')
+        return (groupHdr, groupRows, len(groupHdr) - 1)
+
     # compile regex
     regex = re.compile(regexStr)
 
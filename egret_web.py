@@ -34,16 +34,19 @@ data['baseSubstr'] = ''
 data['testString'] = ''
 data['showGroups'] = False
 data['useDiffBase'] = False
+engineSession = egret_api.new_session() # Lets the engine reuse work between edits of the regex
 UPLOAD_FOLDER = '/tmp' # Uploads module requires this to be set, but nothing is actually saved there
 ALLOWED_EXTENSIONS = set(['txt'])
 
 # configuration
 DEBUG = True
+MEMORY_LIMIT = 512 * 1024 * 1024 # Bytes a single regex may use before it is rejected
 
 # create our application
 app = Flask(__name__)
 app.config.from_object(__name__)
 app.config['UPLOAD_FOLDER'] = UPLOAD_FOLDER
+egret_api.set_memory_limit(MEMORY_LIMIT)
 
 
 # Helper Functions
@@ -111,7 +114,7 @@ def process_submit():
       
     if data['regex'] != '':
       (data['passList'], data['failList'], data['errorMsg'], data['warnings']) = \
-        egret_api.run_egret(data['regex'], baseSubstr, session)
+        egret_api.run_egret(data['regex'], baseSubstr, session, engineSession)
     else:
       (data['passList'], data['failList'], data['errorMsg'], data['warnings']) = \
         ([], [], None, None)
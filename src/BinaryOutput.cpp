@@ -0,0 +1,93 @@
+/*  BinaryOutput.cpp: compact binary format for generated strings
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "BinaryOutput.h"
+using namespace std;
+
+static void append_fixed(string &buf, uint64_t value, int num_bytes);
+static void append_varint(string &buf, uint64_t value);
+
+void
+write_binary_output(ostream &out, const vector <string> &results,
+    const vector <StringClass> &classes)
+{
+  assert(!results.empty());
+
+  uint64_t count = results.size() - 1;
+  assert(classes.empty() || classes.size() == count);
+
+  // status and records
+  string body;
+  append_varint(body, results[0].length());
+  body += results[0];
+
+  const uint64_t HEADER_SIZE = 24;
+  vector <uint64_t> offsets;
+  for (uint64_t i = 0; i < count; i++) {
+    const string &str = results[i + 1];
+    offsets.push_back(HEADER_SIZE + body.length());
+    body += (char) (classes.empty() ? UNCLASSIFIED_STRING : classes[i]);
+    append_varint(body, str.length());
+    body += str;
+  }
+
+  // header
+  string header = "EGRB";
+  append_fixed(header, BINARY_OUTPUT_VERSION, 1);
+  append_fixed(header, 0, 3);
+  append_fixed(header, count, 8);
+  append_fixed(header, HEADER_SIZE + body.length(), 8);
+  assert(header.length() == HEADER_SIZE);
+
+  // index
+  string index;
+  for (uint64_t i = 0; i < count; i++) {
+    append_fixed(index, offsets[i], 8);
+  }
+
+  out.write(header.data(), header.length());
+  out.write(body.data(), body.length());
+  out.write(index.data(), index.length());
+}
+
+static void
+append_fixed(string &buf, uint64_t value, int num_bytes)
+{
+  for (int i = 0; i < num_bytes; i++) {
+    buf += (char) (value & 0xFF);
+    value >>= 8;
+  }
+}
+
+static void
+append_varint(string &buf, uint64_t value)
+{
+  while (value >= 0x80) {
+    buf += (char) ((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  buf += (char) value;
+}
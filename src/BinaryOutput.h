@@ -0,0 +1,56 @@
+/*  BinaryOutput.h: compact binary format for generated strings
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Layout (all integers little endian, varints are LEB128):
+//
+//   header	"EGRB", version (1 byte), 3 reserved bytes,
+//		string count (8 bytes), index offset (8 bytes)
+//   status	varint length + bytes (SUCCESS, the warnings or the error)
+//   records	per string: class (1 byte), varint length + bytes
+//   index	per string: record offset from start of file (8 bytes)
+//
+// The index lets a reader that maps the file jump straight to any string.
+// Strings may contain any byte, including newlines.  egret.py writes the same
+// format (see write_binary_output there).
+
+#ifndef BINARY_OUTPUT_H
+#define BINARY_OUTPUT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef enum
+{
+  NON_MATCH_STRING = 0,		// string is rejected by the regex
+  MATCH_STRING = 1,		// string is accepted by the regex
+  UNCLASSIFIED_STRING = 2	// string has not been checked against the regex
+} StringClass;
+
+const unsigned int BINARY_OUTPUT_VERSION = 1;
+
+// writes engine results (status first, as returned by run_engine) to out;
+// classes holds one entry per string (or is empty if none are classified)
+void write_binary_output(ostream &out, const vector <string> &results,
+    const vector <StringClass> &classes);
+
+#endif // BINARY_OUTPUT_H
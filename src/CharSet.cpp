@@ -19,7 +19,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <iostream>
 #include <set>
 #include <sstream>
@@ -28,10 +30,14 @@
 #include "error.h"
 using namespace std;
 
+// sets with more non-ASCII intervals than this get a CodePointTable
+const unsigned int MAX_SEARCHED_INTERVALS = 16;
+
 void
 CharSet::add_item(CharSetItem item)
 {
   items.push_back(item);
+  intervals_built = false;
 }
 
 bool
@@ -63,7 +69,7 @@ CharSet::is_string_candidate()
   return false;
 }
 
-char
+string
 CharSet::get_valid_character()
 {
   vector <CharSetItem>::iterator it;
@@ -72,7 +78,7 @@ CharSet::get_valid_character()
     // If set is not complemented, choose the first explicit character.
     for (it = items.begin(); it != items.end(); it++) {
       if (it->type == CHARACTER_ITEM) {
-	return it->character;
+	return encode_utf8(it->character);
       }
     }
     // If set is not complemented and there are no explicit character,
@@ -83,24 +89,24 @@ CharSet::get_valid_character()
 	  break; 	// Ignore - alreay processed in earlier loop.
         case CHAR_CLASS_ITEM:
           switch (it->character) {
-  	    case 'w':	return 'a';
-	    case 'd':	return '0';
-	    case 's':	return ' ';
-	    case 'W':	return ';';
-	    case 'D':	return 'a';
-	    case 'S':	return 'a';
-	    case '.':	return 'a';
+  	    case 'w':	return "a";
+	    case 'd':	return "0";
+	    case 's':	return " ";
+	    case 'W':	return ";";
+	    case 'D':	return "a";
+	    case 'S':	return "a";
+	    case '.':	return "a";
 	    default:
 	    {
 	      stringstream s;
 	      s << "ERROR (internal): Invalid character class in character set: "
-	           << it->character;
+	           << (char) it->character;
 	      throw EgretException(s.str());
   	    }
 	  }
           break;
         case CHAR_RANGE_ITEM:
-  	  return it->range_start;
+  	  return encode_utf8(it->range_start);
 	  break;
       }
     }
@@ -109,34 +115,43 @@ CharSet::get_valid_character()
 
   // At this point, the character set is complemented. Find the first valid character.
   for (char c = 'a'; c <= 'z'; c++) {
-    if (is_valid_character(c)) return c;
+    if (is_valid_character(c)) return string(1, c);
   }
   for (char c = 'A'; c <= 'Z'; c++) {
-    if (is_valid_character(c)) return c;
+    if (is_valid_character(c)) return string(1, c);
   }
   for (char c = '0'; c <= '9'; c++) {
-    if (is_valid_character(c)) return c;
+    if (is_valid_character(c)) return string(1, c);
   }
-  if (is_valid_character(' ')) return ' ';
+  if (is_valid_character(' ')) return " ";
 
   for (char c = 33; c <= 47; c++) {
-    if (is_valid_character(c)) return c;
+    if (is_valid_character(c)) return string(1, c);
   }
   for (char c = 58; c <= 64; c++) {
-    if (is_valid_character(c)) return c;
+    if (is_valid_character(c)) return string(1, c);
   }
   for (char c = 91; c <= 96; c++) {
-    if (is_valid_character(c)) return c;
+    if (is_valid_character(c)) return string(1, c);
   }
   for (char c = 123; c <= 126; c++) {
-    if (is_valid_character(c)) return c;
+    if (is_valid_character(c)) return string(1, c);
+  }
+
+  // otherwise use the first member past ASCII
+  const vector <CharInterval> &members = get_intervals();
+  vector <CharInterval>::const_iterator mi;
+  for (mi = members.begin(); mi != members.end(); mi++) {
+    for (CodePoint c = max(mi->first, (CodePoint) 160); c <= mi->last; c++) {
+      if (is_valid_code_point(c)) return encode_utf8(c);
+    }
   }
 
   throw EgretException("ERROR (internal): Could not find good char in complemented char set");
 }
 
 bool
-CharSet::is_valid_character(char character)
+CharSet::is_valid_character(CodePoint character)
 {
   assert(complement);
 
@@ -182,7 +197,7 @@ CharSet::is_valid_character(char character)
 	  {
 	    stringstream s;
 	    s << "ERROR (internal): Invalid character class in character set: "
-	      << it->character;
+	      << (char) it->character;
 	    throw EgretException(s.str());
 	  }
   	}
@@ -197,26 +212,153 @@ CharSet::is_valid_character(char character)
 }
 
 set <string>
-CharSet::gen_evil_strings(string path_string, const set <char> &punct_marks)
+CharSet::gen_evil_strings(const string &path_string, const vector <string> &test_chars)
 {
-  set <char> test_chars  = create_test_chars(punct_marks);
-  string path_suffix = path_string.substr(path_prefix.length() + 1);
+  unsigned int suffix_start = prefix_length + get_valid_character().length();
 
   set <string> evil_strings;
-  set <char>::iterator cs;
+  vector <string>::const_iterator cs;
   for (cs = test_chars.begin(); cs != test_chars.end(); cs++) {
-    string new_string;
-    new_string = path_prefix + *cs + path_suffix;
-    evil_strings.insert(new_string);
+    string evil_string;
+    evil_string.reserve(path_string.length() + cs->length());
+    evil_string.append(path_string, 0, prefix_length);
+    evil_string += *cs;
+    evil_string.append(path_string, suffix_start, string::npos);
+    evil_strings.insert(evil_strings.end(), evil_string);
   }
 
   return evil_strings;
 }
 
-set <char>
+string
+CharSet::get_partition(const string &evil_string, const string &path_string)
+{
+  // evil strings replace the single character after the prefix
+  unsigned int idx = prefix_length;
+  if (idx >= evil_string.length()) return "";
+  return get_char_partition(decode_utf8(evil_string, idx));
+}
+
+string
+CharSet::get_char_partition(CodePoint character)
+{
+  vector <CharSetItem>::iterator it;
+  for (it = items.begin(); it != items.end(); it++) {
+    if (it->type == CHARACTER_ITEM && it->character == character)
+      return "char " + encode_utf8(character);
+  }
+
+  string partition = contains(character) ? "in " : "out ";
+  if (character >= 128) return partition + "non-ascii";
+  if (islower(character)) return partition + "lower";
+  if (isupper(character)) return partition + "upper";
+  if (isdigit(character)) return partition + "digit";
+  if (isspace(character)) return partition + "space";
+  if (character == '_') return partition + "underscore";
+  if (ispunct(character)) return partition + "punct";
+  return partition + "other";
+}
+
+bool
+CharSet::contains(CodePoint character)
+{
+  get_intervals();
+  if (character < 128) return (ascii_members[character >> 6] >> (character & 63)) & 1;
+  if (use_table) {
+    if (!table_built) {
+      table.build(intervals);
+      table_built = true;
+    }
+    return table.contains(character);
+  }
+  return in_intervals(intervals, character);
+}
+
+const vector <CharInterval> &
+CharSet::get_intervals()
+{
+  if (intervals_built) return intervals;
+
+  intervals = get_listed_intervals();
+  vector <CharSetItem>::iterator it;
+  for (it = items.begin(); it != items.end(); it++) {
+    if (it->type != CHAR_CLASS_ITEM) continue;
+    switch (it->character) {
+      case 'w':
+      case 'd':
+      case 's':
+      {
+        const vector <CharInterval> &members = get_class_intervals(it->character);
+        intervals.insert(intervals.end(), members.begin(), members.end());
+        break;
+      }
+      case 'W':
+      case 'D':
+      case 'S':
+      {
+        vector <CharInterval> members =
+          complement_intervals(get_class_intervals(tolower(it->character)));
+        intervals.insert(intervals.end(), members.begin(), members.end());
+        break;
+      }
+      case '.':
+      {
+        CharInterval before = {0, '\n' - 1};
+        CharInterval after = {'\n' + 1, MAX_CODE_POINT};
+        intervals.push_back(before);
+        intervals.push_back(after);
+        break;
+      }
+    }
+  }
+  normalize_intervals(intervals);
+  if (complement) intervals = complement_intervals(intervals);
+
+  // most characters tested are ASCII, so those are looked up in a bitmap
+  ascii_members[0] = 0;
+  ascii_members[1] = 0;
+  vector <CharInterval>::iterator iv;
+  for (iv = intervals.begin(); iv != intervals.end() && iv->first < 128; iv++) {
+    for (CodePoint c = iv->first; c <= iv->last && c < 128; c++) {
+      ascii_members[c >> 6] |= 1ULL << (c & 63);
+    }
+  }
+
+  // a search of a few intervals is as fast as the table, so the table is only
+  // used for sets like the Unicode classes (and only built once a non-ASCII
+  // character is looked up)
+  unsigned int non_ascii = intervals.end() - iv;
+  use_table = (non_ascii > MAX_SEARCHED_INTERVALS);
+  table_built = false;
+
+  intervals_built = true;
+  return intervals;
+}
+
+vector <CharInterval>
+CharSet::get_listed_intervals()
+{
+  vector <CharInterval> listed;
+  vector <CharSetItem>::iterator it;
+  for (it = items.begin(); it != items.end(); it++) {
+    if (it->type == CHARACTER_ITEM) {
+      CharInterval interval = {it->character, it->character};
+      listed.push_back(interval);
+    }
+    else if (it->type == CHAR_RANGE_ITEM) {
+      CharInterval interval = {it->range_start, it->range_end};
+      listed.push_back(interval);
+    }
+  }
+  normalize_intervals(listed);
+  return listed;
+}
+
+set <string>
 CharSet::create_test_chars(const set<char> &punct_marks)
 {
   set <char> test_chars;
+  set <CodePoint> unicode_chars;
   bool lowercase_flag = false;
   bool uppercase_flag = false;
   bool digit_flag = false;
@@ -238,7 +380,11 @@ CharSet::create_test_chars(const set<char> &punct_marks)
   vector <CharSetItem>::iterator it;
   for (it = items.begin(); it != items.end(); it++) {
     if (it->type == CHARACTER_ITEM) {
-      char c = it->character;
+      CodePoint c = it->character;
+      if (c >= 128) {
+        unicode_chars.insert(c);
+        continue;
+      }
       test_chars.insert(c);
       if (islower(c)) {
 	lowercase_flag = true;
@@ -258,21 +404,31 @@ CharSet::create_test_chars(const set<char> &punct_marks)
   // Process ranges second
   for (it = items.begin(); it != items.end(); it++) {
     if (it->type == CHAR_RANGE_ITEM) {
-      char start = it->range_start;
-      char end = it->range_end;
+      CodePoint start = it->range_start;
+      CodePoint end = it->range_end;
+
+      // Range past ASCII - add its first character and the character after it
+      // (often a neighboring range's gap, such as the \xd7 between [\xc0-\xd6]
+      // and [\xd8-\xf6])
+      if (end >= 128) {
+        if (is_valid_code_point(start)) unicode_chars.insert(start);
+        if (end < MAX_CODE_POINT && is_valid_code_point(end + 1) && !contains(end + 1)) {
+          unicode_chars.insert(end + 1);
+        }
+      }
 
       // Lowercase range
-      if (start >= 'a' && end <= 'z') {
+      else if (start >= 'a' && end <= 'z') {
 	lowercase_flag = true;
 	bool found_letter = false;
-	for (char c = start; c <= end; c++) {
+	for (CodePoint c = start; c <= end; c++) {
 	  if (found_letter == false && lowercase[c - 'a'] == false) {
 	    test_chars.insert(c);
 	    found_letter = true;
 	  }
 	  if (lowercase[c - 'a'] == true) {
 	    stringstream s;
-	    s << "Duplicate in character set: " << c;
+	    s << "Duplicate in character set: " << (char) c;
 	    addWarning(s.str());
 	  }
 	  lowercase[c - 'a'] = true;
@@ -283,14 +439,14 @@ CharSet::create_test_chars(const set<char> &punct_marks)
       else if (start >= 'A' && end <= 'Z') {
 	uppercase_flag = true;
 	bool found_letter = false;
-	for (char c = start; c <= end; c++) {
+	for (CodePoint c = start; c <= end; c++) {
 	  if (found_letter == false && uppercase[c - 'A'] == false) {
 	    test_chars.insert(c);
 	    found_letter = true;
 	  }
 	  if (uppercase[c - 'A'] == true) {
 	    stringstream s;
-	    s << "Duplicate in character set: " << c;
+	    s << "Duplicate in character set: " << (char) c;
 	    addWarning(s.str());
 	  }
 	  uppercase[c - 'A'] = true;
@@ -301,14 +457,14 @@ CharSet::create_test_chars(const set<char> &punct_marks)
       else if (start >= '0' && end <= '9') {
 	digit_flag = true;
 	bool found_letter = false;
-	for (char c = start; c <= end; c++) {
+	for (CodePoint c = start; c <= end; c++) {
 	  if (found_letter == false && digits[c - '0'] == false) {
 	    test_chars.insert(c);
 	    found_letter = true;
 	  }
 	  if (digits[c - '0'] == true) {
 	    stringstream s;
-	    s << "Duplicate in character set: " << c;
+	    s << "Duplicate in character set: " << (char) c;
 	    addWarning(s.str());
 	  }
 	  digits[c - '0'] = true;
@@ -316,7 +472,8 @@ CharSet::create_test_chars(const set<char> &punct_marks)
       }
       else {
 	stringstream s;
-        s << "ERROR (internal): Invalid range: " << start << "-" << end;
+        s << "ERROR (internal): Invalid range: " << encode_utf8(start) << "-"
+          << encode_utf8(end);
         throw EgretException(s.str());
       }
     }
@@ -369,7 +526,7 @@ CharSet::create_test_chars(const set<char> &punct_marks)
 	{
 	  stringstream s;
 	  s << "ERROR (internal): Invalid character class in character set: "
-	    << it->character;
+	    << (char) it->character;
 	  throw EgretException(s.str());
 	}
       }
@@ -429,7 +586,16 @@ CharSet::create_test_chars(const set<char> &punct_marks)
     }
   }
 
-  return test_chars;
+  set <string> test_strings;
+  set <char>::iterator ci;
+  for (ci = test_chars.begin(); ci != test_chars.end(); ci++) {
+    test_strings.insert(string(1, *ci));
+  }
+  set <CodePoint>::iterator ui;
+  for (ui = unicode_chars.begin(); ui != unicode_chars.end(); ui++) {
+    test_strings.insert(encode_utf8(*ui));
+  }
+  return test_strings;
 }
 
 bool
@@ -441,7 +607,7 @@ CharSet::allows_punctuation()
   for (it = items.begin(); it != items.end(); it++) {
     switch (it->type) {
       case CHARACTER_ITEM:
-	if (ispunct(it->character)) return true;
+	if (it->character < 128 && ispunct(it->character)) return true;
         break;
       case CHAR_CLASS_ITEM:
         switch (it->character) {
@@ -461,6 +627,38 @@ CharSet::allows_punctuation()
   return false;
 }
 
+string
+CharSet::get_key()
+{
+  stringstream s;
+  if (complement) s << "^";
+
+  vector <CharSetItem>::iterator it;
+  for (it = items.begin(); it != items.end(); it++) {
+    switch (it->type) {
+    case CHARACTER_ITEM:
+      s << "c" << encode_utf8(it->character);
+      break;
+    case CHAR_CLASS_ITEM:
+      s << "\\" << (char) it->character;
+      break;
+    case CHAR_RANGE_ITEM:
+      s << "r" << encode_utf8(it->range_start) << encode_utf8(it->range_end);
+      break;
+    }
+  }
+  return s.str();
+}
+
+unsigned long
+CharSet::get_memory_usage()
+{
+  return sizeof(CharSet) + items.capacity() * sizeof(CharSetItem)
+    + intervals.capacity() * sizeof(CharInterval)
+    + table.get_memory_usage()
+    + substring.capacity();
+}
+
 void
 CharSet::print()
 {
@@ -470,14 +668,30 @@ CharSet::print()
   for (it = items.rbegin(); it != items.rend(); it++) {
     switch (it->type) {
     case CHARACTER_ITEM:
-      cout << it->character;
+      cout << encode_utf8(it->character);
       break;
     case CHAR_CLASS_ITEM:
-      cout << "\\" << it->character;
+      cout << "\\" << (char) it->character;
       break;
     case CHAR_RANGE_ITEM:
-      cout << it->range_start << "-" << it->range_end;
+      cout << encode_utf8(it->range_start) << "-" << encode_utf8(it->range_end);
       break;
     }
   }
 }
+
+const vector <string> &
+TestCharCache::get_test_chars(CharSet *char_set)
+{
+  map <CharSet *, const vector <string> *>::iterator found = lookups.find(char_set);
+  if (found != lookups.end()) return *found->second;
+
+  string key = char_set->get_key();
+  map <string, vector <string> >::iterator it = tables.find(key);
+  if (it == tables.end()) {
+    set <string> test_chars = char_set->create_test_chars(punct_marks);
+    it = tables.insert(make_pair(key, vector <string>(test_chars.begin(), test_chars.end()))).first;
+  }
+  lookups[char_set] = &it->second;
+  return it->second;
+}
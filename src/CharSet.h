@@ -22,9 +22,11 @@
 #ifndef CHARSET_H
 #define CHARSET_H
 
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
+#include "Unicode.h"
 using namespace std;
 
 typedef enum
@@ -37,19 +39,22 @@ typedef enum
 struct CharSetItem
 {
   CharSetItemType type;
-  char character;	// for CHARACTER_ITEM and CHAR_CLASS_ITEM
-  char range_start;	// for CHAR_RANGE_ITEM
-  char range_end;	// for CHAR_RANGE_ITEM
+  CodePoint character;	// for CHARACTER_ITEM and CHAR_CLASS_ITEM
+  CodePoint range_start;	// for CHAR_RANGE_ITEM
+  CodePoint range_end;	// for CHAR_RANGE_ITEM
 };
 
 class CharSet {
 
 public:
 
-  CharSet() { complement = false; }
+  CharSet() {
+    complement = false; intervals_built = false; use_table = false; table_built = false;
+    prefix_length = 0;
+  }
 
-  void set_path_prefix(string p) { path_prefix = p; }
-  void set_complement(bool c) { complement = c; }
+  void set_prefix_length(unsigned int l) { prefix_length = l; }
+  void set_complement(bool c) { complement = c; intervals_built = false; }
   bool is_complement() { return complement; }
 
   // add an item to the character set
@@ -58,15 +63,42 @@ public:
   // determines if character set is a string candidate
   bool is_string_candidate();
 
-  // gets a single valid character
-  char get_valid_character();
+  // gets a single valid character (UTF-8 encoded)
+  string get_valid_character();
 
-  // generate evil strings
-  set <string> gen_evil_strings(string path_string, const set <char> &punct_marks);
+  // generate evil strings by splicing each test character (from
+  // TestCharCache) into the path string
+  set <string> gen_evil_strings(const string &path_string, const vector <string> &test_chars);
+
+  // returns the input partition exercised by an evil string from gen_evil_strings
+  string get_partition(const string &evil_string, const string &path_string);
+
+  // returns the input partition of a character (explicitly listed characters
+  // are their own partition, others are split by membership and kind)
+  string get_char_partition(CodePoint character);
+
+  // returns true if the character matches the character set
+  bool contains(CodePoint character);
+
+  // returns the code points in the set as sorted, disjoint intervals
+  const vector <CharInterval> &get_intervals();
+
+  // returns the intervals of the characters and ranges listed in the set
+  // (ignoring classes and complement)
+  vector <CharInterval> get_listed_intervals();
 
   // returns true if character set allows punctuation
   bool allows_punctuation();
 
+  // creates a set of test characters (UTF-8 encoded)
+  set <string> create_test_chars(const set <char> &punct_marks);
+
+  // returns a string that uniquely describes the character set
+  string get_key();
+
+  // returns the bytes used by the character set
+  unsigned long get_memory_usage();
+
   // print the character set
   void print();
 
@@ -74,14 +106,42 @@ private:
 
   vector <CharSetItem> items;	// set of items comprising the set
   bool complement;		// true if set is complemented
-  string path_prefix;		// path string up to visiting this node
+  unsigned int prefix_length;	// length of path string up to visiting this node
   string substring;		// substring corresponding to this char set
+  bool intervals_built;		// set once intervals and ascii_members are built
+  vector <CharInterval> intervals;	// members as sorted, disjoint intervals
+  unsigned long long ascii_members[2];	// bit per member below 128
+  bool use_table;		// true if non-ASCII members are looked up in table
+  bool table_built;		// set once table is built (on the first lookup)
+  CodePointTable table;		// members, for sets with many non-ASCII intervals
 
   // determines if a character is valid in a complemented character set
-  bool is_valid_character(char character);
+  bool is_valid_character(CodePoint character);
+};
+
+// Test characters for the character sets of one regex.  The table for a set
+// is built the first time it is needed and shared by every set with the same
+// key, so duplicate warnings are added once per distinct set.
+class TestCharCache {
+
+public:
+
+  TestCharCache(const set <char> &p) { punct_marks = p; }
+
+  // returns the test characters (UTF-8 encoded, sorted) for the character set
+  const vector <string> &get_test_chars(CharSet *char_set);
+
+  // returns the punctuation marks used to build the tables
+  const set <char> &get_punct_marks() { return punct_marks; }
+
+  // returns the number of distinct tables built
+  unsigned int get_num_tables() { return tables.size(); }
+
+private:
 
-  // creates a set of test characters
-  set <char> create_test_chars(const set <char> &punct_marks);
+  set <char> punct_marks;			// punctuation marks in the regex
+  map <string, vector <string> > tables;	// test characters for each set key
+  map <CharSet *, const vector <string> *> lookups;	// table for each set seen
 };
 
 #endif // CHARSET_H
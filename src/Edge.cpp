@@ -24,71 +24,26 @@
 #include <string>
 #include <vector>
 #include "Edge.h"
+#include "Unicode.h"
 using namespace std;
 
-string
-Edge::get_substring()
+Edge::~Edge()
 {
   switch (type) {
-  case CHARACTER_EDGE:
-    return string(1, character);
+  case LITERAL_EDGE:
+    delete payload.literal;
+    break;
   case CHAR_SET_EDGE:
-    return string(1, char_set->get_valid_character());
+    delete payload.char_set;
+    break;
   case STRING_EDGE:
-    return regex_str->get_substring();
-  case END_LOOP_EDGE:
-    return regex_loop->get_substring();
+    delete payload.regex_str;
+    break;
+  case BEGIN_LOOP_EDGE:
+    delete payload.regex_loop;
+    break;
   default:
-    return "";
-  }
-}
-
-bool
-Edge::process_edge_in_path(string path_prefix, string base_substring)
-{
-  if (type == BEGIN_LOOP_EDGE) {
-    regex_loop->process_begin_loop(path_prefix, processed);
-  }
-
-  if (type == END_LOOP_EDGE) {
-    regex_loop->process_end_loop(path_prefix, processed);
-  }
-
-  // no further work needed if transition already processed
-  if (processed) return false;
-  processed = true;
-
-  // set the path prefix for nodes that need processing
-  switch (type) {
-    case CHAR_SET_EDGE:
-      char_set->set_path_prefix(path_prefix);
-      return true;
-    case STRING_EDGE:
-      regex_str->set_path_prefix(path_prefix);
-      regex_str->set_substring(base_substring);
-      return true;
-    case END_LOOP_EDGE:
-      return true;
-    default:
-      return false;
-  }
-}
-
-set <string>
-Edge::gen_evil_strings(string path_string, const set <char> &punct_marks)
-{
-  switch (type) {
-    case CHAR_SET_EDGE:
-      return char_set->gen_evil_strings(path_string, punct_marks);
-    case STRING_EDGE:
-      return regex_str->gen_evil_strings(path_string, punct_marks);
-    case END_LOOP_EDGE:
-      return regex_loop->gen_evil_strings(path_string);
-    default:
-    {
-      set <string> empty;
-      return empty;
-    }
+    break;
   }
 }
 
@@ -97,26 +52,29 @@ Edge::print()
 {
   switch (type) {
   case CHARACTER_EDGE:
-    cout << "CHARACTER " << character << endl;
+    cout << "CHARACTER " << encode_utf8(payload.character) << endl;
+    break;
+  case LITERAL_EDGE:
+    cout << "LITERAL " << *payload.literal << endl;
     break;
   case CHAR_SET_EDGE:
     cout << "CHAR_SET ";
-    char_set->print();
+    payload.char_set->print();
     cout << endl;
     break;
   case STRING_EDGE:
     cout << "STRING ";
-    regex_str->print();
+    payload.regex_str->print();
     cout << endl;
     break;
   case BEGIN_LOOP_EDGE:
     cout << "BEGIN_LOOP ";
-    regex_loop->print();
+    payload.regex_loop->print();
     cout << endl;
     break;
   case END_LOOP_EDGE:
     cout << "END_LOOP ";
-    regex_loop->print();
+    payload.regex_loop->print();
     cout << endl;
     break;
   case CARET_EDGE:
@@ -130,3 +88,13 @@ Edge::print()
     break;
   }
 }
+
+Edge *
+find_transition(const vector <Transition> &edges, unsigned int to)
+{
+  vector <Transition>::const_iterator it;
+  for (it = edges.begin(); it != edges.end(); it++) {
+    if (it->to == to) return it->edge;
+  }
+  return NULL;
+}
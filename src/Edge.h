@@ -24,13 +24,16 @@
 
 #include <set>
 #include <string>
+#include <vector>
 #include "CharSet.h"
 #include "RegexString.h"
 #include "RegexLoop.h"
+#include "Unicode.h"
 using namespace std;
 
 typedef enum {
   CHARACTER_EDGE,
+  LITERAL_EDGE,
   CHAR_SET_EDGE,
   STRING_EDGE,
   BEGIN_LOOP_EDGE,
@@ -40,39 +43,219 @@ typedef enum {
   EPSILON_EDGE
 } EdgeType;
 
+// An edge is a type and one payload word (the character, or the object
+// holding the data for its type), so the edges walked by a path stay small.
+// The payload is owned by the edge.  An edge is shared by the NFAs built from
+// the fragment it belongs to (including the fragments a session keeps for
+// the next run), so each NFA holds it and the last NFA to release it frees
+// it.  The begin and end edges of a loop share its RegexLoop, which the begin
+// edge owns (they are always in the same NFAs).
+
 class Edge {
 
 public:
 
-  Edge() { processed = false; }
-  Edge(EdgeType t) { type = t; processed = false; }
-  Edge(EdgeType t, char c) { type = t; character = c; processed = false; }
-  Edge(EdgeType t, CharSet *c) { type = t; char_set = c; processed = false; }
-  Edge(EdgeType t, RegexString *r) { type = t; regex_str = r; processed = false; }
-  Edge(EdgeType t, RegexLoop *r) { type = t; regex_loop = r; processed = false; }
+  Edge() { type = EPSILON_EDGE; processed = false; refs = 0; payload.character = 0; }
+  Edge(EdgeType t) { type = t; processed = false; refs = 0; payload.character = 0; }
+  Edge(EdgeType t, CodePoint c) { type = t; processed = false; refs = 0; payload.character = c; }
+  Edge(EdgeType t, const string &l) {
+    type = t; processed = false; refs = 0; payload.literal = new string(l);
+  }
+  Edge(EdgeType t, CharSet *c) { type = t; processed = false; refs = 0; payload.char_set = c; }
+  Edge(EdgeType t, RegexString *r) { type = t; processed = false; refs = 0; payload.regex_str = r; }
+  Edge(EdgeType t, RegexLoop *r) { type = t; processed = false; refs = 0; payload.regex_loop = r; }
+  ~Edge();
 
-  EdgeType getType() { return type; }
+  // an edge owns its payload, so it is not copied
+  Edge(const Edge &other) = delete;
+  Edge &operator= (const Edge &other) = delete;
 
-  // get valid substring associated with edge
-  string get_substring();
+  // adds an NFA holding the edge
+  void hold() { refs++; }
 
-  // perform path processing on the edge, returns true if edge should be used in
-  // creating evil strings
-  bool process_edge_in_path(string path_prefix, string base_substring);
+  // removes an NFA holding the edge, freeing it if none are left
+  static void release(Edge *edge) { if (--edge->refs == 0) delete edge; }
+
+  EdgeType getType() { return type; }
+  CodePoint get_character() { return payload.character; }
+  const string &get_literal() { return *payload.literal; }
+  CharSet *get_char_set() { return payload.char_set; }
+  RegexString *get_regex_string() { return payload.regex_str; }
+  RegexLoop *get_regex_loop() { return payload.regex_loop; }
 
-  // generate evil strings
-  set <string> gen_evil_strings(string path_string, const set <char> &punct_marks);
+  // clear the processed flag so the edge can be used in a new run
+  void reset() { processed = false; }
+
+  // perform path processing on the edge reached after the first prefix_length
+  // characters of path_string and append the edge's valid substring to
+  // path_string, returns true if edge should be used in creating evil strings
+  // (switches on the type once and runs that type's EdgeHandler)
+  inline bool process_in_path(string &path_string, unsigned int prefix_length,
+      const string &base_substring);
 
   // print the edge
   void print();
 
 private:
+
+  template <EdgeType T> friend struct EdgeHandler;
+
   EdgeType type;		// type of edge
   bool processed;		// set if processed in a path
-  char character;		// character (for CHARACTER_EDGE)
-  CharSet *char_set;		// character set (for CHAR_SET_EDGE)
-  RegexString *regex_str;	// regex string (for STRING_EDGE)
-  RegexLoop *regex_loop;	// regex loop (for BEGIN_LOOP_EDGE and END_LOOP_EDGE)
+  unsigned int refs;		// number of NFAs holding the edge
+  union {
+    CodePoint character;	// character (for CHARACTER_EDGE)
+    const string *literal;	// run of characters (for LITERAL_EDGE)
+    CharSet *char_set;		// character set (for CHAR_SET_EDGE)
+    RegexString *regex_str;	// regex string (for STRING_EDGE)
+    RegexLoop *regex_loop;	// regex loop (for BEGIN_LOOP_EDGE and END_LOOP_EDGE)
+  } payload;
+};
+
+// an edge out of an NFA state and the state it leads to
+struct Transition
+{
+  unsigned int to;	// state reached
+  Edge *edge;		// edge taken
+};
+
+// returns the edge to state to in the edges out of a state (NULL if none)
+Edge *find_transition(const vector <Transition> &edges, unsigned int to);
+
+// Path processing and evil string handling for the edges of one type.  Code
+// that knows an edge's type calls these directly; otherwise
+// Edge::process_in_path switches on the type once per edge.  process_in_path
+// is only given an edge of type T, and the evil string functions are only
+// defined for the types that have evil strings.
+
+// anchors and epsilons add nothing to a path (epsilon edges are shared
+// between NFAs so they must not be modified)
+template <EdgeType T> struct EdgeHandler
+{
+  static bool process_in_path(Edge *edge, string &path_string, unsigned int prefix_length,
+      const string &base_substring) {
+    return false;
+  }
 };
 
+template <> struct EdgeHandler <CHARACTER_EDGE>
+{
+  static bool process_in_path(Edge *edge, string &path_string, unsigned int prefix_length,
+      const string &base_substring) {
+    append_utf8(path_string, edge->payload.character);
+    return false;
+  }
+};
+
+template <> struct EdgeHandler <LITERAL_EDGE>
+{
+  static bool process_in_path(Edge *edge, string &path_string, unsigned int prefix_length,
+      const string &base_substring) {
+    path_string += *edge->payload.literal;
+    return false;
+  }
+};
+
+template <> struct EdgeHandler <BEGIN_LOOP_EDGE>
+{
+  static bool process_in_path(Edge *edge, string &path_string, unsigned int prefix_length,
+      const string &base_substring) {
+    edge->payload.regex_loop->process_begin_loop(prefix_length, edge->processed);
+    edge->processed = true;
+    return false;
+  }
+};
+
+template <> struct EdgeHandler <CHAR_SET_EDGE>
+{
+  static bool process_in_path(Edge *edge, string &path_string, unsigned int prefix_length,
+      const string &base_substring) {
+    bool first = !edge->processed;
+    if (first) {
+      edge->processed = true;
+      edge->payload.char_set->set_prefix_length(prefix_length);
+    }
+    path_string += edge->payload.char_set->get_valid_character();
+    return first;
+  }
+  static set <string> gen_evil_strings(Edge *edge, const string &path_string,
+      TestCharCache &test_chars) {
+    CharSet *char_set = edge->get_char_set();
+    return char_set->gen_evil_strings(path_string, test_chars.get_test_chars(char_set));
+  }
+  static string get_partition(Edge *edge, const string &evil_string, const string &path_string) {
+    return edge->get_char_set()->get_partition(evil_string, path_string);
+  }
+};
+
+template <> struct EdgeHandler <STRING_EDGE>
+{
+  static bool process_in_path(Edge *edge, string &path_string, unsigned int prefix_length,
+      const string &base_substring) {
+    bool first = !edge->processed;
+    if (first) {
+      edge->processed = true;
+      edge->payload.regex_str->set_prefix_length(prefix_length);
+      edge->payload.regex_str->set_substring(base_substring);
+    }
+    path_string += edge->payload.regex_str->get_substring();
+    return first;
+  }
+  static set <string> gen_evil_strings(Edge *edge, const string &path_string,
+      TestCharCache &test_chars) {
+    return edge->get_regex_string()->gen_evil_strings(path_string, test_chars.get_punct_marks());
+  }
+  static string get_partition(Edge *edge, const string &evil_string, const string &path_string) {
+    return edge->get_regex_string()->get_partition(evil_string, path_string);
+  }
+};
+
+template <> struct EdgeHandler <END_LOOP_EDGE>
+{
+  static bool process_in_path(Edge *edge, string &path_string, unsigned int prefix_length,
+      const string &base_substring) {
+    RegexLoop *regex_loop = edge->payload.regex_loop;
+    regex_loop->process_end_loop(path_string, prefix_length, edge->processed);
+    bool first = !edge->processed;
+    edge->processed = true;
+    path_string += regex_loop->get_substring();
+    return first;
+  }
+  static set <string> gen_evil_strings(Edge *edge, const string &path_string,
+      TestCharCache &test_chars) {
+    return edge->get_regex_loop()->gen_evil_strings(path_string);
+  }
+  static string get_partition(Edge *edge, const string &evil_string, const string &path_string) {
+    return edge->get_regex_loop()->get_partition(evil_string, path_string);
+  }
+};
+
+inline bool
+Edge::process_in_path(string &path_string, unsigned int prefix_length,
+    const string &base_substring)
+{
+  switch (type) {
+    case CHARACTER_EDGE:
+      return EdgeHandler <CHARACTER_EDGE>::process_in_path(this, path_string, prefix_length,
+          base_substring);
+    case LITERAL_EDGE:
+      return EdgeHandler <LITERAL_EDGE>::process_in_path(this, path_string, prefix_length,
+          base_substring);
+    case CHAR_SET_EDGE:
+      return EdgeHandler <CHAR_SET_EDGE>::process_in_path(this, path_string, prefix_length,
+          base_substring);
+    case STRING_EDGE:
+      return EdgeHandler <STRING_EDGE>::process_in_path(this, path_string, prefix_length,
+          base_substring);
+    case BEGIN_LOOP_EDGE:
+      return EdgeHandler <BEGIN_LOOP_EDGE>::process_in_path(this, path_string, prefix_length,
+          base_substring);
+    case END_LOOP_EDGE:
+      return EdgeHandler <END_LOOP_EDGE>::process_in_path(this, path_string, prefix_length,
+          base_substring);
+    default:
+      return false;
+  }
+}
+
 #endif // EDGE_H
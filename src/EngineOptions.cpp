@@ -0,0 +1,98 @@
+/*  EngineOptions.cpp: options that change which strings the engine generates
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include "EngineOptions.h"
+#include "NFA.h"
+#include "StringMutator.h"
+using namespace std;
+
+bool
+EngineOptions::set_shard(const string &text)
+{
+  stringstream s(text);
+  long index;
+  long count;
+  char slash;
+  if (!(s >> index >> slash >> count) || !s.eof() || slash != '/') return false;
+  if (count < 1 || index < 0 || index >= count) return false;
+
+  shard_index = index;
+  shard_count = count;
+  return true;
+}
+
+bool
+EngineOptions::set_mutations(const string &text)
+{
+  unsigned int enabled = 0;
+  stringstream s(text);
+  string name;
+  while (getline(s, name, ',')) {
+    if (name == "all") {
+      enabled |= (1 << NUM_MUTATIONS) - 1;
+      continue;
+    }
+    MutationType type = find_mutation(name);
+    if (type == NUM_MUTATIONS) return false;
+    enabled |= 1 << type;
+  }
+
+  mutations = enabled;
+  return true;
+}
+
+string
+EngineOptions::get_key() const
+{
+  stringstream key;
+  key << ((traversal == MIN_COVER_TRAVERSAL) ? "min_cover" : "basis");
+  if (minimize) key << " minimize";
+  if (shard_count > 1) key << " shard " << shard_index << "/" << shard_count;
+  if (mutations != 0) key << " mutations " << mutations;
+  return key.str();
+}
+
+bool
+parse_count(const string &text, unsigned long &count)
+{
+  if (text.empty() || !isdigit((unsigned char) text[0])) return false;
+  char *end;
+  errno = 0;
+  unsigned long value = strtoul(text.c_str(), &end, 10);
+  if (*end != '\0' || errno == ERANGE) return false;
+  count = value;
+  return true;
+}
+
+bool
+parse_count(const string &text, unsigned int &count)
+{
+  unsigned long value;
+  if (!parse_count(text, value) || value > UINT_MAX) return false;
+  count = value;
+  return true;
+}
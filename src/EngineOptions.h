@@ -0,0 +1,70 @@
+/*  EngineOptions.h: options that change which strings the engine generates
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A sharded run still finds every path (so edge processing and warnings match
+// the unsharded run), but only generates strings for every Nth path.  The union
+// of the strings from all N shards is the set of strings of the unsharded run.
+
+#ifndef ENGINE_OPTIONS_H
+#define ENGINE_OPTIONS_H
+
+#include <string>
+#include "NFA.h"
+using namespace std;
+
+// options that change which strings the engine generates
+struct EngineOptions
+{
+  EngineOptions() {
+    traversal = BASIS_TRAVERSAL;
+    minimize = false;
+    shard_index = 0;
+    shard_count = 1;
+    mutations = 0;
+  }
+
+  // sets the shard from text of the form i/N (0 <= i < N), returns false if
+  // the text is not a valid shard
+  bool set_shard(const string &text);
+
+  // enables the mutations in text, a comma separated list of operator names
+  // or "all", returns false if a name is unknown
+  bool set_mutations(const string &text);
+
+  // returns true if strings for the path with the given index belong to this shard
+  bool in_shard(unsigned int path_index) const { return path_index % shard_count == shard_index; }
+
+  // returns a string that uniquely describes the options
+  string get_key() const;
+
+  TraversalMode traversal;	// how paths through the NFA are chosen
+  bool minimize;		// drop strings that add no edge or input coverage
+  unsigned int shard_index;	// shard generated by this run
+  unsigned int shard_count;	// number of shards the paths are split into
+  unsigned int mutations;	// bit per MutationType applied to path strings
+};
+
+// parses a non-negative decimal integer for a command line option, returns
+// false if text has anything else in it or the value does not fit
+bool parse_count(const string &text, unsigned long &count);
+bool parse_count(const string &text, unsigned int &count);
+
+#endif // ENGINE_OPTIONS_H
@@ -0,0 +1,100 @@
+/*  EngineSession.cpp: state kept between engine runs for incremental builds
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <set>
+#include <string>
+#include "Edge.h"
+#include "EngineSession.h"
+#include "NFA.h"
+#include "Stats.h"
+using namespace std;
+
+// Limit on the number of remembered subtree keys.  Once exceeded, the session
+// starts over so a long session does not grow without bound.
+static const unsigned int MAX_SUBTREE_IDS = 100000;
+
+int
+EngineSession::get_subtree_id(string key)
+{
+  map <string, int>::iterator it = subtree_ids.find(key);
+  if (it != subtree_ids.end()) return it->second;
+
+  int id = subtree_ids.size();
+  subtree_ids[key] = id;
+  return id;
+}
+
+bool
+EngineSession::find_fragment(int id, NFA &nfa)
+{
+  map <int, NFA>::iterator it = prev_fragments.find(id);
+  if (it == prev_fragments.end()) return false;
+
+  nfa = it->second;
+  return true;
+}
+
+void
+EngineSession::save_fragment(int id, const NFA &nfa, bool reused)
+{
+  curr_fragments[id] = nfa;
+  if (reused) reused_count++;
+  else built_count++;
+}
+
+bool
+EngineSession::is_edge_used(Edge *edge)
+{
+  return used_edges.find(edge) != used_edges.end();
+}
+
+void
+EngineSession::mark_edge_used(Edge *edge)
+{
+  used_edges.insert(edge);
+}
+
+void
+EngineSession::end_run(bool success)
+{
+  // a failed run (typically a regex in the middle of being typed) keeps the
+  // fragments from the last good regex
+  if (success) {
+    prev_fragments = curr_fragments;
+  }
+  curr_fragments.clear();
+  used_edges.clear();
+  reused_count = 0;
+  built_count = 0;
+
+  if (subtree_ids.size() > MAX_SUBTREE_IDS) {
+    subtree_ids.clear();
+    prev_fragments.clear();
+  }
+}
+
+void
+EngineSession::add_stats(Stats &stats)
+{
+  stats.add("SESSION", "Reused NFA fragments", reused_count);
+  stats.add("SESSION", "Built NFA fragments", built_count);
+}
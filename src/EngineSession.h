@@ -0,0 +1,74 @@
+/*  EngineSession.h: state kept between engine runs for incremental builds
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINE_SESSION_H
+#define ENGINE_SESSION_H
+
+#include <map>
+#include <set>
+#include <string>
+#include "Edge.h"
+#include "NFA.h"
+#include "Stats.h"
+using namespace std;
+
+// An engine session remembers the NFA fragment built for each subtree of the
+// previous regex.  Subtrees are identified by a structural key so that an
+// unchanged subtree in an edited regex maps to the same id and its fragment
+// can be reused instead of rebuilt.
+class EngineSession {
+
+public:
+
+  EngineSession() { reused_count = 0; built_count = 0; }
+
+  // returns the id for a subtree key (assigning a new id if needed)
+  int get_subtree_id(string key);
+
+  // finds a fragment for the subtree built in the previous run
+  bool find_fragment(int id, NFA &nfa);
+
+  // saves a fragment built (or reused) in the current run
+  void save_fragment(int id, const NFA &nfa, bool reused);
+
+  // returns true if edge already belongs to a fragment reused in this run
+  bool is_edge_used(Edge *edge);
+
+  // marks edge as belonging to a fragment reused in this run
+  void mark_edge_used(Edge *edge);
+
+  // ends the current run - fragments are only kept from successful runs
+  void end_run(bool success);
+
+  // add session stats
+  void add_stats(Stats &stats);
+
+private:
+
+  map <string, int> subtree_ids;	// structural key -> subtree id
+  map <int, NFA> prev_fragments;	// fragments from the previous run
+  map <int, NFA> curr_fragments;	// fragments from the current run
+  set <Edge *> used_edges;		// edges of fragments reused in this run
+  int reused_count;			// fragments reused in this run
+  int built_count;			// fragments built in this run
+};
+
+#endif // ENGINE_SESSION_H
@@ -0,0 +1,303 @@
+/*  JobServer.cpp: runs engine jobs described by JSON lines
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "JobServer.h"
+#include "Stats.h"
+#include "WorkQueue.h"
+#include "egret.h"
+#include "error.h"
+#include "json.h"
+using namespace std;
+
+struct Job
+{
+  unsigned long line_number;
+  string line;
+  unsigned long seq;		// position of the job in the input
+};
+
+// Writes results in input order.  A result that finishes early is held until
+// the results before it are written, and the reader waits once too many
+// results are held so memory stays bounded on long inputs.
+class OrderedOutput {
+
+public:
+
+  OrderedOutput(ostream &_out, unsigned long _window) : out(_out) {
+    window = _window;
+    next_seq = 0;
+  }
+
+  // blocks until the job at seq can start without exceeding the window
+  void wait_for_room(unsigned long seq);
+
+  // writes the result for seq (and any held results that follow it)
+  void write(unsigned long seq, const string &result);
+
+private:
+
+  ostream &out;				// where results are written
+  unsigned long window;			// maximum jobs ahead of the next write
+  unsigned long next_seq;		// next result to write
+  map <unsigned long, string> held;	// results waiting on earlier results
+  mutex lock;				// protects all members
+  condition_variable written;		// signaled when next_seq advances
+};
+
+static void worker(WorkQueue <Job> *jobs, ostream *out, mutex *out_lock);
+static void ordered_worker(WorkQueue <Job> *jobs, OrderedOutput *out, bool regex_lines,
+    const JobRequest *defaults);
+
+void
+parse_json_job(const string &line, JobRequest &job)
+{
+  job.id = "";
+  job.regex = "";
+  job.base_substring = "evil";
+  job.options = EngineOptions();
+
+  JsonObject object = parse_json_object(line);
+
+  if (object.find("id") != object.end()) {
+    job.id = json_value(object["id"]);
+  }
+  if (object.find("regex") == object.end() || !object["regex"].is_string) {
+    throw EgretException("ERROR: Job does not have a regex string");
+  }
+  job.regex = object["regex"].text;
+  if (object.find("base_substring") != object.end()) {
+    job.base_substring = object["base_substring"].text;
+  }
+  if (object.find("traversal") != object.end()) {
+    string traversal = object["traversal"].text;
+    if (traversal == "min_cover") job.options.traversal = MIN_COVER_TRAVERSAL;
+    else if (traversal != "basis") {
+      throw EgretException("ERROR: Job has an unknown traversal " + traversal);
+    }
+  }
+  if (object.find("minimize") != object.end()) {
+    job.options.minimize = (object["minimize"].text == "true");
+  }
+  if (object.find("mutations") != object.end()) {
+    if (!job.options.set_mutations(object["mutations"].text)) {
+      throw EgretException("ERROR: Job has unknown mutations " + object["mutations"].text);
+    }
+  }
+  if (object.find("shard") != object.end()) {
+    if (!job.options.set_shard(object["shard"].text)) {
+      throw EgretException("ERROR: Job has an invalid shard " + object["shard"].text);
+    }
+  }
+}
+
+string
+run_job(const string &regex, const string &base_substring, const EngineOptions &options)
+{
+  stringstream result;
+
+  // run the engine
+  Stats stats;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  vector <string> strs = run_engine(regex, base_substring, stats, options);
+  chrono::duration <double, milli> elapsed = chrono::steady_clock::now() - start;
+
+  // first string is the error or warnings (or SUCCESS)
+  string status = strs[0];
+  if (status.substr(0, 5) == "ERROR") {
+    result << "\"status\":\"ERROR\",\"error\":" << json_string(status);
+  }
+  else {
+    vector <string> warnings;
+    if (status != "SUCCESS") {
+      stringstream s(status);
+      string warning;
+      while (getline(s, warning)) {
+        if (warning != "") warnings.push_back(warning);
+      }
+    }
+    strs.erase(strs.begin());
+
+    result << "\"status\":" << (warnings.empty() ? "\"SUCCESS\"" : "\"WARNING\"");
+    result << ",\"warnings\":" << json_string_list(warnings);
+    result << ",\"strings\":" << json_string_list(strs);
+    result << ",\"stats\":" << stats.get_json();
+  }
+  result << ",\"time_ms\":" << elapsed.count();
+
+  return result.str();
+}
+
+string
+job_error(const string &message)
+{
+  return "\"status\":\"ERROR\",\"error\":" + json_string(message);
+}
+
+string
+job_result(unsigned long line_number, const string &id, const string &fields)
+{
+  stringstream result;
+  result << "{\"line\":" << line_number;
+  if (id != "") result << ",\"id\":" << id;
+  result << "," << fields << "}";
+  return result.str();
+}
+
+string
+run_json_job(const string &line, unsigned long line_number)
+{
+  JobRequest job;
+  try {
+    parse_json_job(line, job);
+  }
+  catch (EgretException const &e) {
+    return job_result(line_number, job.id, job_error(e.getError()));
+  }
+
+  return job_result(line_number, job.id, run_job(job.regex, job.base_substring, job.options));
+}
+
+void
+serve_json_jobs(istream &in, ostream &out, unsigned int num_workers)
+{
+  if (num_workers == 0) num_workers = 1;
+
+  // The reader blocks once the queue is full so a fast producer cannot
+  // buffer the whole input in memory.
+  WorkQueue <Job> jobs(num_workers * 4);
+  mutex out_lock;
+
+  vector <thread> workers;
+  for (unsigned int i = 0; i < num_workers; i++) {
+    workers.push_back(thread(worker, &jobs, &out, &out_lock));
+  }
+
+  Job job;
+  job.line_number = 0;
+  while (getline(in, job.line)) {
+    job.line_number++;
+    if (job.line.find_first_not_of(" \t\r") == string::npos) continue;
+    jobs.push(job);
+  }
+
+  jobs.close();
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+}
+
+static void
+worker(WorkQueue <Job> *jobs, ostream *out, mutex *out_lock)
+{
+  Job job;
+  while (jobs->pop(job)) {
+    string result = run_json_job(job.line, job.line_number);
+    lock_guard <mutex> guard(*out_lock);
+    *out << result << endl;
+  }
+}
+
+void
+run_job_file(istream &in, ostream &out, unsigned int num_workers, bool regex_lines,
+    const JobRequest &defaults)
+{
+  if (num_workers == 0) num_workers = 1;
+
+  WorkQueue <Job> jobs(num_workers * 4);
+  OrderedOutput ordered(out, num_workers * 16);
+
+  vector <thread> workers;
+  for (unsigned int i = 0; i < num_workers; i++) {
+    workers.push_back(thread(ordered_worker, &jobs, &ordered, regex_lines, &defaults));
+  }
+
+  Job job;
+  job.line_number = 0;
+  job.seq = 0;
+  while (getline(in, job.line)) {
+    job.line_number++;
+    if (job.line != "" && job.line[job.line.length() - 1] == '\r') {
+      job.line.erase(job.line.length() - 1);
+    }
+    if (regex_lines ? job.line == "" : job.line.find_first_not_of(" \t") == string::npos) {
+      continue;
+    }
+    ordered.wait_for_room(job.seq);
+    jobs.push(job);
+    job.seq++;
+  }
+
+  jobs.close();
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+}
+
+static void
+ordered_worker(WorkQueue <Job> *jobs, OrderedOutput *out, bool regex_lines,
+    const JobRequest *defaults)
+{
+  Job job;
+  while (jobs->pop(job)) {
+    string result;
+    if (regex_lines) {
+      result = job_result(job.line_number, "",
+          run_job(job.line, defaults->base_substring, defaults->options));
+    }
+    else {
+      result = run_json_job(job.line, job.line_number);
+    }
+    out->write(job.seq, result);
+  }
+}
+
+void
+OrderedOutput::wait_for_room(unsigned long seq)
+{
+  unique_lock <mutex> guard(lock);
+  while (seq >= next_seq + window) written.wait(guard);
+}
+
+void
+OrderedOutput::write(unsigned long seq, const string &result)
+{
+  unique_lock <mutex> guard(lock);
+  held[seq] = result;
+
+  map <unsigned long, string>::iterator it = held.begin();
+  if (it->first != next_seq) return;
+  while (it != held.end() && it->first == next_seq) {
+    out << it->second << "\n";
+    next_seq++;
+    held.erase(it++);
+  }
+  out.flush();
+  written.notify_all();
+}
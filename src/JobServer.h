@@ -0,0 +1,83 @@
+/*  JobServer.h: runs engine jobs described by JSON lines
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A job is a JSON object on a single line:
+//
+//   {"id": 7, "regex": "\\d+", "base_substring": "evil", "traversal": "basis"}
+//
+// Only "regex" is required, "id" (any scalar) is echoed back.  "traversal" is
+// "basis" (the default) or "min_cover", and "minimize": true drops strings that
+// add no edge or input coverage.  "shard": "i/N" generates only shard i of N
+// (see EngineOptions.h).  Each result is
+// also a single line:
+//
+//   {"line": 1, "id": 7, "status": "SUCCESS", "warnings": [], "strings": [...],
+//    "stats": {...}, "time_ms": 0.42}
+//
+// where status is SUCCESS, WARNING or ERROR.  An ERROR result has an "error"
+// message in place of warnings, strings and stats.
+
+#ifndef JOB_SERVER_H
+#define JOB_SERVER_H
+
+#include <iostream>
+#include <string>
+#include "egret.h"
+using namespace std;
+
+// a parsed job
+struct JobRequest
+{
+  string id;			// JSON text of the job id ("" if none)
+  string regex;			// regex to process
+  string base_substring;	// base substring for regex strings
+  EngineOptions options;	// engine options
+};
+
+// parses a job line into job, throws EgretException if the job is malformed
+// (job.id is still filled in when the line has one)
+void parse_json_job(const string &line, JobRequest &job);
+
+// runs the engine, returns the result fields (status through time_ms)
+string run_job(const string &regex, const string &base_substring,
+    const EngineOptions &options = EngineOptions());
+
+// returns the result fields for an error
+string job_error(const string &message);
+
+// assembles a result line from its fields
+string job_result(unsigned long line_number, const string &id, const string &fields);
+
+// runs the job on line (line_number is reported in the result) and returns
+// the result line (without a trailing newline)
+string run_json_job(const string &line, unsigned long line_number);
+
+// reads jobs from in and writes results to out as they complete, using
+// num_workers threads
+void serve_json_jobs(istream &in, ostream &out, unsigned int num_workers);
+
+// reads jobs from in and writes results to out in input order, using
+// num_workers threads - each line is a JSON job, or with regex_lines a regex
+// that is run with the base substring and options in defaults
+void run_job_file(istream &in, ostream &out, unsigned int num_workers, bool regex_lines,
+    const JobRequest &defaults);
+
+#endif // JOB_SERVER_H
@@ -0,0 +1,127 @@
+/*  MemoryUsage.cpp: memory accounting and limits for engine runs
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <set>
+#include <sstream>
+#include <string>
+#include "MemoryUsage.h"
+#include "Stats.h"
+#include "error.h"
+using namespace std;
+
+static atomic <unsigned long> limit(0);
+
+struct Usage
+{
+  unsigned long total;				// bytes currently in use
+  unsigned long peak;				// peak of total
+  unsigned long current[NUM_MEMORY_TYPES];	// bytes in use per type
+  unsigned long type_peak[NUM_MEMORY_TYPES];	// peak bytes per type
+};
+
+static thread_local Usage usage;
+
+void
+setMemoryLimit(unsigned long bytes)
+{
+  limit = bytes;
+}
+
+unsigned long
+getMemoryLimit()
+{
+  return limit;
+}
+
+void
+clearMemoryUsage()
+{
+  usage.total = 0;
+  usage.peak = 0;
+  for (int i = 0; i < NUM_MEMORY_TYPES; i++) {
+    usage.current[i] = 0;
+    usage.type_peak[i] = 0;
+  }
+}
+
+void
+addMemoryUsage(MemoryType type, unsigned long bytes)
+{
+  usage.total += bytes;
+  usage.current[type] += bytes;
+  if (usage.total > usage.peak) usage.peak = usage.total;
+  if (usage.current[type] > usage.type_peak[type]) usage.type_peak[type] = usage.current[type];
+
+  unsigned long max_bytes = limit;
+  if (max_bytes != 0 && usage.total > max_bytes) {
+    stringstream s;
+    s << "ERROR: Memory limit of " << max_bytes << " bytes exceeded";
+    throw EgretException(s.str());
+  }
+}
+
+void
+releaseMemoryUsage(MemoryType type, unsigned long bytes)
+{
+  // structures kept from an earlier run (e.g. in a session) may be freed
+  // after the usage was cleared
+  if (bytes > usage.current[type]) bytes = usage.current[type];
+  usage.current[type] -= bytes;
+  usage.total -= bytes;
+}
+
+unsigned long
+getPeakMemoryUsage()
+{
+  return usage.peak;
+}
+
+unsigned long
+getStringMemory(const string &s)
+{
+  return sizeof(string) + s.capacity();
+}
+
+unsigned long
+getStringSetMemory(const set <string> &strs)
+{
+  // each set node holds a string plus the tree links and color
+  const unsigned long NODE_OVERHEAD = 4 * sizeof(void *);
+
+  unsigned long bytes = 0;
+  set <string>::const_iterator it;
+  for (it = strs.begin(); it != strs.end(); it++) {
+    bytes += NODE_OVERHEAD + getStringMemory(*it);
+  }
+  return bytes;
+}
+
+void
+addMemoryStats(Stats &stats)
+{
+  stats.add("MEMORY", "Peak memory (bytes)", usage.peak);
+  stats.add("MEMORY", "Peak scanner memory", usage.type_peak[SCANNER_MEMORY]);
+  stats.add("MEMORY", "Peak parse tree memory", usage.type_peak[PARSE_TREE_MEMORY]);
+  stats.add("MEMORY", "Peak NFA memory", usage.type_peak[NFA_MEMORY]);
+  stats.add("MEMORY", "Peak path memory", usage.type_peak[PATH_MEMORY]);
+  stats.add("MEMORY", "Peak string memory", usage.type_peak[STRING_MEMORY]);
+}
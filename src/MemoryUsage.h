@@ -0,0 +1,68 @@
+/*  MemoryUsage.h: memory accounting and limits for engine runs
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Each component reports the bytes held by its large structures (tokens,
+// parse nodes, NFA edge tables, paths and generated strings) as it allocates
+// and frees them.  Usage is tracked per thread so concurrent runs are
+// accounted separately; the limit applies to every run in the process.
+
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <set>
+#include <string>
+#include "Stats.h"
+using namespace std;
+
+typedef enum
+{
+  SCANNER_MEMORY,
+  PARSE_TREE_MEMORY,
+  NFA_MEMORY,
+  PATH_MEMORY,
+  STRING_MEMORY,
+  NUM_MEMORY_TYPES
+} MemoryType;
+
+// sets the byte limit for a run (0 for no limit)
+void setMemoryLimit(unsigned long bytes);
+unsigned long getMemoryLimit();
+
+// clears the usage for a new run
+void clearMemoryUsage();
+
+// records an allocation, throws EgretException if the run goes over the limit
+void addMemoryUsage(MemoryType type, unsigned long bytes);
+
+// records a deallocation
+void releaseMemoryUsage(MemoryType type, unsigned long bytes);
+
+// returns the peak bytes in use during the run
+unsigned long getPeakMemoryUsage();
+
+// returns the bytes used by a string (or a set of strings)
+unsigned long getStringMemory(const string &s);
+unsigned long getStringSetMemory(const set <string> &strs);
+
+// add memory stats
+void addMemoryStats(Stats &stats);
+
+#endif // MEMORY_USAGE_H
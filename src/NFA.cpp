@@ -22,39 +22,80 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <string>
 #include <vector>
 #include "Edge.h"
+#include "EngineSession.h"
+#include "MemoryUsage.h"
 #include "NFA.h"
 #include "ParseTree.h"
+#include "Trace.h"
+#include "Unicode.h"
 #include "error.h"
 using namespace std;
 
-static Edge EPSILON = Edge(EPSILON_EDGE);
+// epsilon edges carry no state, so one edge is shared by every NFA (and by
+// every thread) and is never held or released
+static Edge EPSILON(EPSILON_EDGE);
+
+static void hold_edges(const vector <Transition> &edges);
+static void release_edges(const vector <Transition> &edges);
 
 NFA::NFA(unsigned int _size, unsigned int _initial, unsigned int  _final)
 {
   size = _size;
   initial = _initial;
   final = _final;
+  num_edges = 0;
+  session = NULL;
+  table_bytes = 0;
 
   assert(initial < size);
   assert(final < size);
 
   // initialize edge table with an "empty graph"
-  vector <Edge *> empty_row(size, NULL);
-  for (unsigned int i = 0; i < size; i++) {
-    edge_table.push_back(empty_row);
-  }
+  edge_table.resize(size);
+  account_table();
 }
 
 NFA::NFA(const NFA &other)
 {
+  table_bytes = 0;
+
   size = other.size;
   initial = other.initial;
   final = other.final;
   edge_table = other.edge_table;
+  num_edges = other.num_edges;
+  session = NULL;
+  for (unsigned int i = 0; i < size; i++) hold_edges(edge_table[i]);
+  account_table();
+}
+
+// takes other's edge table (and its accounted memory) without copying it
+NFA::NFA(NFA &&other)
+{
+  table_bytes = other.table_bytes;
+  other.table_bytes = 0;
+
+  size = other.size;
+  initial = other.initial;
+  final = other.final;
+  edge_table = move(other.edge_table);
+  other.edge_table.clear();
+  num_edges = other.num_edges;
+  session = NULL;
+  other.size = 0;
+  other.num_edges = 0;
+}
+
+NFA::~NFA()
+{
+  for (unsigned int i = 0; i < edge_table.size(); i++) release_edges(edge_table[i]);
+  releaseMemoryUsage(NFA_MEMORY, table_bytes);
 }
 
 NFA &
@@ -63,29 +104,151 @@ NFA::operator=(const NFA & other)
   if (this == &other)
     return *this;
 
+  // the new edges are held before the old ones are released, as they can be
+  // the same edges
+  vector <vector <Transition> > old_table;
+  old_table.swap(edge_table);
+
   initial = other.initial;
   final = other.final;
   size = other.size;
   edge_table = other.edge_table;
+  num_edges = other.num_edges;
+  for (unsigned int i = 0; i < size; i++) hold_edges(edge_table[i]);
+  for (unsigned int i = 0; i < old_table.size(); i++) release_edges(old_table[i]);
+  account_table();
+
+  return *this;
+}
+
+NFA &
+NFA::operator=(NFA &&other)
+{
+  if (this == &other)
+    return *this;
+
+  for (unsigned int i = 0; i < edge_table.size(); i++) release_edges(edge_table[i]);
+  releaseMemoryUsage(NFA_MEMORY, table_bytes);
+  table_bytes = other.table_bytes;
+  other.table_bytes = 0;
+
+  initial = other.initial;
+  final = other.final;
+  size = other.size;
+  edge_table = move(other.edge_table);
+  other.edge_table.clear();
+  num_edges = other.num_edges;
+  other.size = 0;
+  other.num_edges = 0;
 
   return *this;
 }
 
 void
-NFA::build(ParseTree &tree)
+NFA::build(ParseTree &tree, EngineSession *_session)
 {
+  TraceSpan span("NFA::build");
   // Build NFA
+  session = _session;
   NFA nfa = build_nfa_from_tree(tree.get_root());
+  session = NULL;
 
-  // Copy NFA
-  initial = nfa.initial;
-  final = nfa.final;
-  size = nfa.size;
-  edge_table = nfa.edge_table;
+  // Take over the built NFA's states
+  *this = move(nfa);
+}
+
+void
+NFA::build(const vector <RuleItem> &trie, vector <Edge *> &rule_edges)
+{
+  TraceSpan span("NFA::build");
+  NFA nfa = build_nfa_rule_item(trie, 0, rule_edges);
+  *this = move(nfa);
+}
+
+NFA
+NFA::build_nfa_rule_item(const vector <RuleItem> &trie, unsigned int node,
+    vector <Edge *> &rule_edges)
+{
+  // fold a chain of characters that no rule ends in into a single literal edge
+  string literal = "";
+  while (trie[node].item != NULL && trie[node].item->type == CHARACTER_NODE) {
+    append_utf8(literal, trie[node].item->character);
+    if (trie[node].children.size() != 1 || !trie[node].rules.empty()) break;
+    unsigned int next = trie[node].children[0];
+    if (trie[next].item->type != CHARACTER_NODE) break;
+    node = next;
+  }
+
+  // the rules that end here and the nodes that follow are alternatives (an
+  // end is a distinct epsilon edge so the paths through it can be told apart)
+  vector <NFA> alternatives;
+  alternatives.reserve(trie[node].rules.size() + trie[node].children.size());
+  vector <unsigned int>::const_iterator it;
+  for (it = trie[node].rules.begin(); it != trie[node].rules.end(); it++) {
+    NFA end(2, 0, 1);
+    Edge *edge = new Edge(EPSILON_EDGE);
+    end.add_edge(0, 1, edge);
+    rule_edges[*it] = edge;
+    alternatives.push_back(move(end));
+  }
+  for (it = trie[node].children.begin(); it != trie[node].children.end(); it++) {
+    alternatives.push_back(build_nfa_rule_item(trie, *it, rule_edges));
+  }
+  assert(!alternatives.empty());
+
+  NFA nfa = move(alternatives.back());
+  for (int i = alternatives.size() - 2; i >= 0; i--) {
+    nfa = build_nfa_alternation(move(alternatives[i]), move(nfa));
+  }
+
+  if (literal != "") return build_nfa_concat(build_nfa_literal(literal), move(nfa));
+  if (trie[node].item != NULL)
+    return build_nfa_concat(build_nfa_from_tree(trie[node].item), move(nfa));
+  return nfa;
 }
 
 NFA
 NFA::build_nfa_from_tree(ParseNode *tree)
+{
+  if (session == NULL) return build_nfa_from_node(tree);
+
+  // reuse the fragment for an unchanged subtree, otherwise build it
+  NFA nfa;
+  bool reused = reuse_fragment(tree, nfa);
+  if (!reused) nfa = build_nfa_from_node(tree);
+  session->save_fragment(tree->subtree_id, nfa, reused);
+  return nfa;
+}
+
+bool
+NFA::reuse_fragment(ParseNode *tree, NFA &nfa)
+{
+  assert(tree->subtree_id != -1);
+
+  if (!session->find_fragment(tree->subtree_id, nfa)) return false;
+
+  // Edges carry per-run state so a fragment cannot be used twice in one run
+  // (e.g. the regex now repeats a subtree, or a reused fragment contains it).
+  vector <Transition>::iterator it;
+  for (unsigned int from = 0; from < nfa.size; from++) {
+    for (it = nfa.edge_table[from].begin(); it != nfa.edge_table[from].end(); it++) {
+      if (it->edge->getType() == EPSILON_EDGE) continue;
+      if (session->is_edge_used(it->edge)) return false;
+    }
+  }
+
+  for (unsigned int from = 0; from < nfa.size; from++) {
+    for (it = nfa.edge_table[from].begin(); it != nfa.edge_table[from].end(); it++) {
+      if (it->edge->getType() == EPSILON_EDGE) continue;
+      session->mark_edge_used(it->edge);
+      it->edge->reset();
+    }
+  }
+  return true;
+}
+
+NFA
+NFA::build_nfa_from_node(ParseNode *tree)
 {
   assert(tree);
 
@@ -96,8 +259,24 @@ NFA::build_nfa_from_tree(ParseNode *tree)
 	build_nfa_from_tree(tree->right));
 
   case CONCAT_NODE:
-    return build_nfa_concat(build_nfa_from_tree(tree->left),
-	build_nfa_from_tree(tree->right));
+  {
+    // fold a run of concatenated characters into a single literal edge
+    string literal = "";
+    ParseNode *node = tree;
+    while (node->type == CONCAT_NODE && node->left->type == CHARACTER_NODE) {
+      append_utf8(literal, node->left->character);
+      node = node->right;
+    }
+    if (literal == "")
+      return build_nfa_concat(build_nfa_from_tree(tree->left),
+	  build_nfa_from_tree(tree->right));
+    if (node->type == CHARACTER_NODE) {
+      append_utf8(literal, node->character);
+      return build_nfa_literal(literal);
+    }
+    return build_nfa_concat(build_nfa_literal(literal),
+	build_nfa_from_tree(node));
+  }
 
   case REPEAT_NODE:
     if (is_regex_string(tree->left, tree->repeat_lower, tree->repeat_upper))
@@ -132,6 +311,7 @@ NFA::build_nfa_from_tree(ParseNode *tree)
 NFA
 NFA::build_nfa_alternation(NFA nfa1, NFA nfa2)
 {
+  TraceSpan span("NFA::build_nfa_alternation", "states", nfa1.size + nfa2.size);
   // How this is done: the new nfa must contain all the states in
   // nfa1 and nfa2, plus new initial and final states.
   // First will come the new initial state, then nfa1's states, then
@@ -144,14 +324,15 @@ NFA::build_nfa_alternation(NFA nfa1, NFA nfa2)
   nfa2.shift_states(nfa1.size);
 
   // create a new nfa and initialize it with (the shifted) nfa2
-  NFA new_nfa(nfa2);
+  NFA new_nfa(move(nfa2));
+  unsigned int nfa2_final = new_nfa.final;
 
   // nfa1's states take their places in new_nfa
   new_nfa.fill_states(nfa1);
 
   // Set new initial state and the edges from it
   new_nfa.add_edge(0, nfa1.initial, &EPSILON);
-  new_nfa.add_edge(0, nfa2.initial, &EPSILON);
+  new_nfa.add_edge(0, new_nfa.initial, &EPSILON);
   new_nfa.initial = 0;
 
   // Make up space for the new final state
@@ -160,7 +341,7 @@ NFA::build_nfa_alternation(NFA nfa1, NFA nfa2)
   // Set new final state
   new_nfa.final = new_nfa.size - 1;
   new_nfa.add_edge(nfa1.final, new_nfa.final, &EPSILON);
-  new_nfa.add_edge(nfa2.final, new_nfa.final, &EPSILON);
+  new_nfa.add_edge(nfa2_final, new_nfa.final, &EPSILON);
 
   return new_nfa;
 }
@@ -168,6 +349,7 @@ NFA::build_nfa_alternation(NFA nfa1, NFA nfa2)
 NFA
 NFA::build_nfa_concat(NFA nfa1, NFA nfa2)
 {
+  TraceSpan span("NFA::build_nfa_concat", "states", nfa1.size + nfa2.size);
   // How this is done: First will come nfa1, then nfa2 (its
   // initial state replaced with nfa1's final state)
 
@@ -175,7 +357,7 @@ NFA::build_nfa_concat(NFA nfa1, NFA nfa2)
   nfa2.shift_states(nfa1.size);
 
   // create a new nfa and initialize it with (the shifted) nfa2
-  NFA new_nfa(nfa2);
+  NFA new_nfa(move(nfa2));
 
   // nfa1's states take their places in new_nfa
   new_nfa.fill_states(nfa1);
@@ -193,6 +375,7 @@ NFA::build_nfa_concat(NFA nfa1, NFA nfa2)
 NFA
 NFA::build_nfa_repeat(NFA nfa, int repeat_lower, int repeat_upper)
 {
+  TraceSpan span("NFA::build_nfa_repeat", "states", nfa.size);
   // make room for the new initial state
   nfa.shift_states(1);
 
@@ -219,7 +402,10 @@ NFA
 NFA::build_nfa_string(ParseNode *node, int repeat_lower, int repeat_upper)
 {
   NFA nfa(2, 0, 1);
-  RegexString *regex_str = new RegexString(node->char_set, repeat_lower, repeat_upper);
+  // the edge keeps its own copy of the set, as a session can keep the edge
+  // after the parse tree is gone
+  CharSet *char_set = new CharSet(*node->char_set);
+  RegexString *regex_str = new RegexString(char_set, repeat_lower, repeat_upper);
   Edge *edge = new Edge(STRING_EDGE, regex_str);
   nfa.add_edge(0, 1, edge);
 
@@ -233,7 +419,7 @@ NFA::build_nfa_group(NFA nfa)
 }
 
 NFA
-NFA::build_nfa_character(char character)
+NFA::build_nfa_character(CodePoint character)
 {
   NFA nfa(2, 0, 1);	// size = 2, initial = 0 , final = 1
   Edge *edge = new Edge(CHARACTER_EDGE, character);
@@ -241,6 +427,21 @@ NFA::build_nfa_character(char character)
   return nfa;
 }
 
+NFA
+NFA::build_nfa_literal(const string &literal)
+{
+  // a single character keeps its own character edge
+  if (utf8_length(literal) == 1) {
+    unsigned int idx = 0;
+    return build_nfa_character(decode_utf8(literal, idx));
+  }
+
+  NFA nfa(2, 0, 1);	// size = 2, initial = 0 , final = 1
+  Edge *edge = new Edge(LITERAL_EDGE, literal);
+  nfa.add_edge(0, 1, edge);
+  return nfa;
+}
+
 NFA
 NFA::build_nfa_caret()
 {
@@ -270,8 +471,9 @@ NFA::build_nfa_ignored()
 NFA
 NFA::build_nfa_char_set(CharSet *char_set)
 {
+  // the edge keeps its own copy of the set (see build_nfa_string)
   NFA nfa(2, 0, 1);
-  Edge *edge = new Edge(CHAR_SET_EDGE, char_set);
+  Edge *edge = new Edge(CHAR_SET_EDGE, new CharSet(*char_set));
   nfa.add_edge(0, 1, edge);
   return nfa;
 }
@@ -282,32 +484,44 @@ NFA::add_edge(unsigned int from, unsigned int to, Edge *edge)
   assert(from < size);
   assert(to < size);
 
-  edge_table[from][to] = edge;
+  // keep the edges out of from in order of the state they reach
+  vector <Transition> &edges = edge_table[from];
+  vector <Transition>::iterator it = edges.begin();
+  while (it != edges.end() && it->to < to) it++;
+  if (edge != &EPSILON) edge->hold();
+  if (it != edges.end() && it->to == to) {
+    if (it->edge != &EPSILON) Edge::release(it->edge);
+    it->edge = edge;
+    return;
+  }
+
+  Transition transition;
+  transition.to = to;
+  transition.edge = edge;
+  edges.insert(it, transition);
+  num_edges++;
+  account_table();
 }
 
 void
 NFA::shift_states(unsigned int shift)
 {
-  unsigned int new_size = size + shift;
-
   if (shift < 1) return;
 
-  // create a new, empty edge table (of the new size)
-  vector <Edge *> empty_row(new_size, NULL);
-  vector <vector <Edge *> > new_edge_table(new_size, empty_row);
-
-  // copy all the edges to the new table, at their new locations
+  // renumber the states the edges reach, then add the empty states in front
   for (unsigned int i = 0; i < size; i++) {
-    for (unsigned int j = 0; j < size; j++) {
-      new_edge_table[i + shift][j + shift] = edge_table[i][j];
+    vector <Transition>::iterator it;
+    for (it = edge_table[i].begin(); it != edge_table[i].end(); it++) {
+      it->to += shift;
     }
   }
+  edge_table.insert(edge_table.begin(), shift, vector <Transition>());
 
   // update the NFA members
-  size = new_size;
+  size += shift;
   initial += shift;
   final += shift;
-  edge_table = new_edge_table;
+  account_table();
 }
 
 // fills states from other's states
@@ -316,24 +530,29 @@ void
 NFA::fill_states(const NFA &other)
 {
   for (unsigned int i = 0; i < other.size; i++) {
-    for (unsigned int j = 0; j < other.size; j++) {
-      edge_table[i][j] = other.edge_table[i][j];
-    }
+    num_edges += other.edge_table[i].size() - edge_table[i].size();
+    hold_edges(other.edge_table[i]);
+    release_edges(edge_table[i]);
+    edge_table[i] = other.edge_table[i];
   }
+  account_table();
 }
 
 void
 NFA::append_empty_state()
 {
-  // append a new row (already with a larger size)
-  vector <Edge *> empty_row(size + 1, NULL);
-  edge_table.push_back(empty_row);
-
-  // append a new column
-  for (unsigned int i = 0; i < size; i++)
-    edge_table[i].push_back(NULL);
-
+  edge_table.push_back(vector <Transition>());
   size += 1;
+  account_table();
+}
+
+void
+NFA::account_table()
+{
+  unsigned long bytes = size * sizeof(vector <Transition>) + num_edges * sizeof(Transition);
+  if (bytes > table_bytes) addMemoryUsage(NFA_MEMORY, bytes - table_bytes);
+  else releaseMemoryUsage(NFA_MEMORY, table_bytes - bytes);
+  table_bytes = bytes;
 }
 
 bool
@@ -353,15 +572,18 @@ NFA::is_regex_string(ParseNode *node, int repeat_lower, int repeat_upper)
 }
 
 vector <Path>
-NFA::find_basis_paths()
+NFA::find_basis_paths(PathTrie &trie)
 {
-  Path path(initial);
   vector <Path> paths;
   bool *visited = new bool[size];
   for (unsigned int i = 0; i < size; i++)
     visited[i] = false;
 
-  traverse(initial, path, paths, visited);
+  trie.set_root(initial, &edge_table);
+  {
+    TraceSpan span("NFA::traverse");
+    traverse(trie, 0, paths, visited);
+  }
 
   delete visited;
 
@@ -369,29 +591,236 @@ NFA::find_basis_paths()
 }
 
 void
-NFA::traverse(unsigned int curr_state, Path path, vector <Path> &paths, bool *visited)
+NFA::traverse(PathTrie &trie, unsigned int node, vector <Path> &paths, bool *visited)
 {
+  unsigned int curr_state = trie.get_node(node).state;
+
   // stop if you already have been here
   bool been_here = visited[curr_state];
 
   // final state --> process the path and stop the traversal
   if (curr_state == final) {
-    path.mark_path_visited(visited);
+    trie.mark_path_visited(node, visited);
+    Path path(&trie, node, paths.size());
+    addMemoryUsage(PATH_MEMORY, path.get_memory_usage());
     paths.push_back(path);
     return;
   }
 
-  // for each adjacent state, find all paths 
-  for (unsigned int next_state = 0; next_state < size; next_state++) {
-    Edge *edge = edge_table[curr_state][next_state];
-    if (edge == NULL) continue;
-    path.append(edge, next_state);
-    traverse(next_state, path, paths, visited);
-    path.remove_last();
+  // for each adjacent state, find all paths (dropping a node that did not
+  // lead to any)
+  const vector <Transition> &edges = edge_table[curr_state];
+  vector <Transition>::const_iterator it;
+  for (it = edges.begin(); it != edges.end(); it++) {
+    unsigned int num_paths = paths.size();
+    unsigned int child = trie.add_child(node, it->to);
+    traverse(trie, child, paths, visited);
+    if (paths.size() == num_paths) trie.remove_last(child);
     if (been_here) break;
   }
 }
 
+// The cover is a minimum flow from initial to final where every edge carries
+// at least one path.  A feasible flow is built by routing one path through
+// each edge, then paths are moved off of the flow while the residual graph
+// (decrease an edge with more than one path, increase any edge) still has a
+// path from final back to initial.  The flow that is left is split into paths.
+vector <Path>
+NFA::find_min_cover_paths(PathTrie &trie)
+{
+  TraceSpan span("NFA::find_min_cover_paths");
+  vector <Path> paths;
+
+  trie.set_root(initial, &edge_table);
+  if (initial == final) {
+    paths.push_back(Path(&trie, 0, 0));
+    return paths;
+  }
+
+  unsigned long flow_bytes = get_flow_memory();
+  addMemoryUsage(PATH_MEMORY, flow_bytes);
+
+  vector <vector <unsigned int> > out;
+  vector <vector <int> > flow;
+  find_min_flow(out, flow);
+
+  // split the flow into paths (sharing the prefix a path has in common
+  // with the previous one)
+  vector <unsigned int> previous;
+  while (true) {
+    unsigned int state = initial;
+    unsigned int node = 0;
+    unsigned int depth = 0;
+    bool shared = true;
+    while (state != final) {
+      unsigned int i = 0;
+      while (i < out[state].size() && flow[state][i] == 0) i++;
+      if (i == out[state].size()) break;
+      flow[state][i]--;
+      unsigned int next = out[state][i];
+      depth++;
+      shared = shared && depth < previous.size() && trie.get_node(previous[depth]).state == next;
+      node = shared ? previous[depth] : trie.add_child(node, next);
+      state = next;
+    }
+    if (state != final) break;
+
+    Path path(&trie, node, paths.size());
+    addMemoryUsage(PATH_MEMORY, path.get_memory_usage());
+    paths.push_back(path);
+    trie.get_path_nodes(node, previous);
+  }
+
+  releaseMemoryUsage(PATH_MEMORY, flow_bytes);
+
+  return paths;
+}
+
+unsigned long
+NFA::count_min_cover_paths()
+{
+  TraceSpan span("NFA::count_min_cover_paths");
+  if (initial == final) return 1;
+
+  unsigned long flow_bytes = get_flow_memory();
+  addMemoryUsage(PATH_MEMORY, flow_bytes);
+
+  vector <vector <unsigned int> > out;
+  vector <vector <int> > flow;
+  find_min_flow(out, flow);
+
+  // every path leaves initial once
+  unsigned long count = 0;
+  for (unsigned int i = 0; i < flow[initial].size(); i++) {
+    count += flow[initial][i];
+  }
+
+  releaseMemoryUsage(PATH_MEMORY, flow_bytes);
+
+  return count;
+}
+
+void
+NFA::find_min_flow(vector <vector <unsigned int> > &out, vector <vector <int> > &flow)
+{
+  // only edges on some initial to final path can be covered
+  vector <int> to_initial;
+  vector <int> to_final;
+  find_links(initial, false, to_initial);
+  find_links(final, true, to_final);
+
+  out.assign(size, vector <unsigned int>());
+  vector <vector <pair <unsigned int, unsigned int> > > in(size);
+  for (unsigned int from = 0; from < size; from++) {
+    if (to_initial[from] == -1) continue;
+    vector <Transition>::iterator it;
+    for (it = edge_table[from].begin(); it != edge_table[from].end(); it++) {
+      if (to_final[it->to] == -1) continue;
+      in[it->to].push_back(make_pair(from, out[from].size()));
+      out[from].push_back(it->to);
+    }
+  }
+
+  // route one path through each edge (the links toward initial and final
+  // are edges on such paths, so they are in out)
+  flow.assign(size, vector <int>());
+  for (unsigned int from = 0; from < size; from++) {
+    flow[from].assign(out[from].size(), 0);
+  }
+  for (unsigned int from = 0; from < size; from++) {
+    for (unsigned int i = 0; i < out[from].size(); i++) {
+      for (unsigned int state = from; state != initial; state = to_initial[state]) {
+        unsigned int prev = to_initial[state];
+        flow[prev][find(out[prev].begin(), out[prev].end(), state) - out[prev].begin()]++;
+      }
+      flow[from][i]++;
+      for (unsigned int state = out[from][i]; state != final; state = to_final[state]) {
+        unsigned int next = to_final[state];
+        flow[state][find(out[state].begin(), out[state].end(), next) - out[state].begin()]++;
+      }
+    }
+  }
+
+  while (reduce_flow(flow, out, in));
+}
+
+void
+NFA::find_links(unsigned int start, bool reverse, vector <int> &link)
+{
+  link.assign(size, -1);
+  link[start] = start;
+
+  // the states next to each state (in increasing order)
+  vector <vector <unsigned int> > next(size);
+  for (unsigned int from = 0; from < size; from++) {
+    vector <Transition>::iterator it;
+    for (it = edge_table[from].begin(); it != edge_table[from].end(); it++) {
+      if (reverse) next[it->to].push_back(from);
+      else next[from].push_back(it->to);
+    }
+  }
+
+  vector <unsigned int> queue(1, start);
+  for (unsigned int i = 0; i < queue.size(); i++) {
+    unsigned int state = queue[i];
+    vector <unsigned int>::iterator it;
+    for (it = next[state].begin(); it != next[state].end(); it++) {
+      if (link[*it] != -1) continue;
+      link[*it] = state;
+      queue.push_back(*it);
+    }
+  }
+}
+
+bool
+NFA::reduce_flow(vector <vector <int> > &flow, const vector <vector <unsigned int> > &out,
+    const vector <vector <pair <unsigned int, unsigned int> > > &in)
+{
+  // breadth first search from final to initial - prev is the state a search
+  // step came from, decrease is set when the step goes backward over an edge,
+  // and prev_edge is the index of the edge in its state's out list
+  vector <int> prev(size, -1);
+  vector <unsigned int> prev_edge(size, 0);
+  vector <bool> decrease(size, false);
+  prev[final] = final;
+
+  vector <unsigned int> queue(1, final);
+  for (unsigned int i = 0; i < queue.size() && prev[initial] == -1; i++) {
+    unsigned int state = queue[i];
+    vector <pair <unsigned int, unsigned int> >::const_iterator it;
+    for (it = in[state].begin(); it != in[state].end(); it++) {
+      if (prev[it->first] != -1 || flow[it->first][it->second] <= 1) continue;
+      prev[it->first] = state;
+      prev_edge[it->first] = it->second;
+      decrease[it->first] = true;
+      queue.push_back(it->first);
+    }
+    for (unsigned int j = 0; j < out[state].size(); j++) {
+      unsigned int next = out[state][j];
+      if (prev[next] != -1) continue;
+      prev[next] = state;
+      prev_edge[next] = j;
+      queue.push_back(next);
+    }
+  }
+  if (prev[initial] == -1) return false;
+
+  // the edges being decreased limit how many paths can be moved
+  int amount = -1;
+  for (unsigned int state = initial; state != final; state = prev[state]) {
+    if (!decrease[state]) continue;
+    int spare = flow[state][prev_edge[state]] - 1;
+    if (amount == -1 || spare < amount) amount = spare;
+  }
+  if (amount <= 0) return false;
+
+  for (unsigned int state = initial; state != final; state = prev[state]) {
+    if (decrease[state]) flow[state][prev_edge[state]] -= amount;
+    else flow[prev[state]][prev_edge[state]] += amount;
+  }
+  return true;
+}
+
 void
 NFA::print()
 {
@@ -404,12 +833,10 @@ NFA::print()
   for (unsigned int from = 0; from < size; from++) {
     cout << "State " << from << ": ";
     cout << endl;
-    for (unsigned int to = 0; to < size; to++) {
-      Edge *edge = edge_table[from][to];
-      if (edge != NULL) {
-        cout << "  To state " << to << " on ";
-	edge->print();
-      }
+    vector <Transition>::iterator it;
+    for (it = edge_table[from].begin(); it != edge_table[from].end(); it++) {
+      cout << "  To state " << it->to << " on ";
+      it->edge->print();
     }
   }
 
@@ -421,6 +848,7 @@ NFA::add_stats(Stats &stats)
 {
   int edge_count = 0;
   int char_count = 0;
+  int literal_count = 0;
   int charset_count = 0;
   int string_count = 0;
   int begin_loop_count = 0;
@@ -430,36 +858,37 @@ NFA::add_stats(Stats &stats)
   int epsilon_count = 0;
 
   for (unsigned int from = 0; from < size; from++) {
-    for (unsigned int to = 0; to < size; to++) {
-      Edge *edge = edge_table[from][to];
-      if (edge != NULL) {
-        edge_count++;
-	switch (edge->getType()) {
-	  case CHARACTER_EDGE:
-	    char_count++;
-	    break;
-	  case CHAR_SET_EDGE:
-	    charset_count++;
-	    break;
-	  case STRING_EDGE:
-	    string_count++;
-	    break;
-	  case BEGIN_LOOP_EDGE:
-	    begin_loop_count++;
-	    break;
-	  case END_LOOP_EDGE:
-	    end_loop_count++;
-	    break;
-	  case CARET_EDGE:
-	    caret_count++;
-	    break;
-	  case DOLLAR_EDGE:
-	    dollar_count++;
-	    break;
-	  case EPSILON_EDGE:
-	    epsilon_count++;
-	    break;
-	}
+    vector <Transition>::iterator it;
+    for (it = edge_table[from].begin(); it != edge_table[from].end(); it++) {
+      edge_count++;
+      switch (it->edge->getType()) {
+	case CHARACTER_EDGE:
+	  char_count++;
+	  break;
+	case LITERAL_EDGE:
+	  literal_count++;
+	  break;
+	case CHAR_SET_EDGE:
+	  charset_count++;
+	  break;
+	case STRING_EDGE:
+	  string_count++;
+	  break;
+	case BEGIN_LOOP_EDGE:
+	  begin_loop_count++;
+	  break;
+	case END_LOOP_EDGE:
+	  end_loop_count++;
+	  break;
+	case CARET_EDGE:
+	  caret_count++;
+	  break;
+	case DOLLAR_EDGE:
+	  dollar_count++;
+	  break;
+	case EPSILON_EDGE:
+	  epsilon_count++;
+	  break;
       }
     }
   }
@@ -467,6 +896,7 @@ NFA::add_stats(Stats &stats)
   stats.add("NFA", "NFA states", size);
   stats.add("NFA", "NFA edges", edge_count);
   stats.add("NFA", "NFA character edges", char_count);
+  stats.add("NFA", "NFA literal edges", literal_count);
   stats.add("NFA", "NFA char set edges", charset_count);
   stats.add("NFA", "NFA string edges", string_count);
   stats.add("NFA", "NFA begin loop edges", begin_loop_count);
@@ -475,3 +905,21 @@ NFA::add_stats(Stats &stats)
   stats.add("NFA", "NFA dollar edges", dollar_count);
   stats.add("NFA", "NFA epsilon edges", epsilon_count);
 }
+
+static void
+hold_edges(const vector <Transition> &edges)
+{
+  vector <Transition>::const_iterator it;
+  for (it = edges.begin(); it != edges.end(); it++) {
+    if (it->edge != &EPSILON) it->edge->hold();
+  }
+}
+
+static void
+release_edges(const vector <Transition> &edges)
+{
+  vector <Transition>::const_iterator it;
+  for (it = edges.begin(); it != edges.end(); it++) {
+    if (it->edge != &EPSILON) Edge::release(it->edge);
+  }
+}
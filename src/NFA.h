@@ -25,6 +25,7 @@
 #ifndef NFA_H
 #define NFA_H
 
+#include <string>
 #include <vector>
 #include "Edge.h"
 #include "CharSet.h"
@@ -33,20 +34,63 @@
 #include "Stats.h"
 using namespace std;
 
+class EngineSession;
+
+typedef enum
+{
+  BASIS_TRAVERSAL,	// depth first traversal that stops at visited states
+  MIN_COVER_TRAVERSAL	// fewest paths that cover every edge
+} TraversalMode;
+
+// a node of a trie of rules (see RuleSet.h): the rules through a node share
+// the states of its item
+struct RuleItem
+{
+  ParseNode *item;			// item leading to the node (NULL for the root)
+  vector <unsigned int> children;	// nodes that follow it
+  vector <unsigned int> rules;		// rules that end with it
+};
+
 class NFA {
 
 public:
 
-  NFA() {}
+  NFA() { size = 0; num_edges = 0; session = NULL; table_bytes = 0; }
   NFA(unsigned int _size, unsigned int _initial, unsigned int _final);
   NFA(const NFA &other);
+  NFA(NFA &&other);
   NFA &operator= (const NFA &other);
+  NFA &operator= (NFA &&other);
+  ~NFA();
+
+  // build an NFA from the parse tree (reusing fragments from the session's
+  // previous run when a session is given)
+  void build(ParseTree &tree, EngineSession *_session = NULL);
+
+  // build an NFA for all of the rules in a trie of rules - every rule ends
+  // with its own epsilon edge into final, which is set in rule_edges
+  void build(const vector <RuleItem> &trie, vector <Edge *> &rule_edges);
+
+  unsigned int get_size() { return size; }
+  unsigned int get_initial() { return initial; }
+  unsigned int get_final() { return final; }
+  Edge *get_edge(unsigned int from, unsigned int to) {
+    return find_transition(edge_table[from], to);
+  }
+
+  // returns the edges out of state from (in order of the state they reach)
+  const vector <Transition> &get_transitions(unsigned int from) { return edge_table[from]; }
 
-  // build an NFA from the parse tree
-  void build(ParseTree &tree);
+  // create a set of basis paths (stored in trie)
+  vector <Path> find_basis_paths(PathTrie &trie);
 
-  // create a set of basis paths
-  vector <Path> find_basis_paths();
+  // create the smallest set of initial to final paths that covers every edge
+  // (stored in trie)
+  vector <Path> find_min_cover_paths(PathTrie &trie);
+
+  // returns the number of paths find_min_cover_paths would create, without
+  // creating them
+  unsigned long count_min_cover_paths();
 
   // print out the NFA
   void print();
@@ -59,11 +103,25 @@ private:
   unsigned int size;			// number of states
   unsigned int initial;			// initial state
   unsigned int final;			// final state
-  vector <vector <Edge *> > edge_table;	// edge table
+  vector <vector <Transition> > edge_table;	// edges out of each state (sorted by
+						// the state reached)
+  unsigned int num_edges;		// number of edges in edge_table
+  EngineSession *session;		// session used during build (or NULL)
+  unsigned long table_bytes;		// bytes accounted for edge_table
   
   // builds an NFA from tree
   NFA build_nfa_from_tree(ParseNode *tree);
 
+  // builds an NFA from tree without consulting the session
+  NFA build_nfa_from_node(ParseNode *tree);
+
+  // sets nfa to the session's fragment for tree if it can be reused
+  bool reuse_fragment(ParseNode *tree, NFA &nfa);
+
+  // builds the NFA for a node of a trie of rules and the nodes after it
+  NFA build_nfa_rule_item(const vector <RuleItem> &trie, unsigned int node,
+      vector <Edge *> &rule_edges);
+
   // builds an alternation of nfa1 and nfa2 (nfa1|nfa2)
   NFA build_nfa_alternation(NFA nfa1, NFA nfa2);
 
@@ -80,7 +138,10 @@ private:
   NFA build_nfa_group(NFA nfa);
 
   // builds nfa with character
-  NFA build_nfa_character(char character);
+  NFA build_nfa_character(CodePoint character);
+
+  // builds nfa with a run of characters
+  NFA build_nfa_literal(const string &literal);
 
   // builds nfa with caret
   NFA build_nfa_caret();
@@ -106,11 +167,35 @@ private:
   // appends a new empty state to the NFA
   void append_empty_state();
 
+  // accounts for the memory of the edge table
+  void account_table();
+
   // returns true if repeat quantifier represents a string
   bool is_regex_string(ParseNode *node, int repeat_lower, int repeat_upper);
 
   // utility function to find all paths through the NFA
-  void traverse(unsigned int curr_state, Path path, vector <Path> &paths, bool *visited);
+  void traverse(PathTrie &trie, unsigned int node, vector <Path> &paths, bool *visited);
+
+  // finds the minimum flow that covers every edge on an initial to final
+  // path (flow[from][i] is the number of paths on the edge to out[from][i])
+  void find_min_flow(vector <vector <unsigned int> > &out, vector <vector <int> > &flow);
+
+  // returns the bytes used while finding the minimum flow
+  unsigned long get_flow_memory() {
+    return size * 3 * sizeof(vector <int>) + num_edges * 3 * sizeof(int);
+  }
+
+  // finds a path from start to every state reachable from it (following edges
+  // backward if reverse is set) - link is the next state toward start, -1 if
+  // the state is unreachable
+  void find_links(unsigned int start, bool reverse, vector <int> &link);
+
+  // finds a path from final to initial in the residual graph of the edge flow
+  // and moves as many paths as possible off of it, returns false if none
+  // (flow[from][i] is the flow on the edge to out[from][i], and in[to] lists
+  // the state and index of each edge into to)
+  bool reduce_flow(vector <vector <int> > &flow, const vector <vector <unsigned int> > &out,
+    const vector <vector <pair <unsigned int, unsigned int> > > &in);
 };
 
 #endif // NFA_H
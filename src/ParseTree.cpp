@@ -31,9 +31,13 @@
 #include <string>
 #include <set>
 #include "CharSet.h"
+#include "EngineSession.h"
+#include "MemoryUsage.h"
 #include "ParseTree.h"
 #include "Scanner.h"
 #include "Stats.h"
+#include "Trace.h"
+#include "Unicode.h"
 #include "error.h"
 using namespace std;
 
@@ -41,17 +45,61 @@ using namespace std;
 // RD Parser
 //=============================================================
 
+ParseTree::ParseTree(ParseTree &&other)
+{
+  root = other.root;
+  scanner = NULL;
+  punct_marks = other.punct_marks;
+  group_names = other.group_names;
+  nodes.swap(other.nodes);
+  tree_bytes = other.tree_bytes;
+  other.root = NULL;
+  other.tree_bytes = 0;
+}
+
+ParseTree::~ParseTree()
+{
+  clear();
+}
+
+void
+ParseTree::clear()
+{
+  vector <ParseNode *>::iterator it;
+  for (it = nodes.begin(); it != nodes.end(); it++) {
+    delete (*it)->char_set;
+    delete *it;
+  }
+  nodes.clear();
+  root = NULL;
+  releaseMemoryUsage(PARSE_TREE_MEMORY, tree_bytes);
+  tree_bytes = 0;
+}
+
+ParseNode *
+ParseTree::add_node(ParseNode *node)
+{
+  nodes.push_back(node);
+  return node;
+}
+
 void
 ParseTree::build(Scanner &_scanner)
 {
-  scanner = _scanner;
+  TraceSpan span("ParseTree::build");
+  clear();
+  scanner = &_scanner;
   root = expr();
 
-  if (scanner.get_type() != ERR) {
+  if (scanner->get_type() != ERR) {
     stringstream s;
-    s << "ERROR: Parse error - expected end of regex but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected end of regex but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
+  scanner = NULL;
+
+  tree_bytes = get_memory_usage(root);
+  addMemoryUsage(PARSE_TREE_MEMORY, tree_bytes);
 }
 
 // expr ::= concat '|' expr
@@ -66,22 +114,22 @@ ParseTree::expr()
   ParseNode *left, *right;
 
   // check for alternation without a "left"
-  if (scanner.get_type() == ALTERNATION) {
+  if (scanner->get_type() == ALTERNATION) {
     left = NULL;
   } else {
     left = concat();
   }
 
   // check for lack of alternation
-  if (scanner.get_type() != ALTERNATION) {
+  if (scanner->get_type() != ALTERNATION) {
     return left;
   }
 
   // advance past alternation token
-  scanner.advance();
+  scanner->advance();
 
   // check for lacking right
-  if (scanner.get_type() == RIGHT_PAREN || scanner.get_type() == ERR) {
+  if (scanner->get_type() == RIGHT_PAREN || scanner->get_type() == ERR) {
     right = NULL;
   } else {
     right = expr();
@@ -92,19 +140,20 @@ ParseTree::expr()
   if (left == NULL && right == NULL) {
     throw EgretException("ERROR: pointless alternation (both clauses are empty)");
   }
-  // left empty: return right?
+  // left empty: return right?? (the empty clause is tried first)
   else if (left == NULL) {
-    ParseNode *expr_node = new ParseNode(REPEAT_NODE, right, 0, 1);
+    ParseNode *expr_node = add_node(new ParseNode(REPEAT_NODE, right, 0, 1));
+    expr_node->lazy = true;
     return expr_node;
   }
   // right empty: return left?
   else if (right == NULL) {
-    ParseNode *expr_node = new ParseNode(REPEAT_NODE, left, 0, 1);
+    ParseNode *expr_node = add_node(new ParseNode(REPEAT_NODE, left, 0, 1));
     return expr_node;
   }
   
   // otherwise return left | right
-  ParseNode *expr_node = new ParseNode(ALTERNATION_NODE, left, right);
+  ParseNode *expr_node = add_node(new ParseNode(ALTERNATION_NODE, left, right));
   return expr_node;
 }
 
@@ -118,9 +167,9 @@ ParseTree::concat()
   ParseNode *left = rep();
 
   // check for concatenation
-  if (scanner.is_concat()) {
+  if (scanner->is_concat()) {
     ParseNode *right = concat();
-    ParseNode *concat_node = new ParseNode(CONCAT_NODE, left, right);
+    ParseNode *concat_node = add_node(new ParseNode(CONCAT_NODE, left, right));
     return concat_node;
   } else {
     return left;
@@ -141,26 +190,34 @@ ParseTree::rep()
   ParseNode *atom_node = atom();
 
   // then check for repetition character
-  if (scanner.get_type() == STAR) {
-    scanner.advance();
-    ParseNode *rep_node = new ParseNode(REPEAT_NODE, atom_node, 0, -1);
+  if (scanner->get_type() == STAR) {
+    bool lazy = scanner->is_lazy();
+    scanner->advance();
+    ParseNode *rep_node = add_node(new ParseNode(REPEAT_NODE, atom_node, 0, -1));
+    rep_node->lazy = lazy;
     return rep_node;
   }
-  else if (scanner.get_type() == PLUS) {
-    scanner.advance();
-    ParseNode *rep_node = new ParseNode(REPEAT_NODE, atom_node, 1, -1);
+  else if (scanner->get_type() == PLUS) {
+    bool lazy = scanner->is_lazy();
+    scanner->advance();
+    ParseNode *rep_node = add_node(new ParseNode(REPEAT_NODE, atom_node, 1, -1));
+    rep_node->lazy = lazy;
     return rep_node;
   }
-  else if (scanner.get_type() == QUESTION) {
-    scanner.advance();
-    ParseNode *rep_node = new ParseNode(REPEAT_NODE, atom_node, 0, 1);
+  else if (scanner->get_type() == QUESTION) {
+    bool lazy = scanner->is_lazy();
+    scanner->advance();
+    ParseNode *rep_node = add_node(new ParseNode(REPEAT_NODE, atom_node, 0, 1));
+    rep_node->lazy = lazy;
     return rep_node;
   }
-  else if (scanner.get_type() == REPEAT) {
-    int lower = scanner.get_repeat_lower();
-    int upper = scanner.get_repeat_upper();
-    scanner.advance();
-    ParseNode *rep_node = new ParseNode(REPEAT_NODE, atom_node, lower, upper);
+  else if (scanner->get_type() == REPEAT) {
+    int lower = scanner->get_repeat_lower();
+    int upper = scanner->get_repeat_upper();
+    bool lazy = scanner->is_lazy();
+    scanner->advance();
+    ParseNode *rep_node = add_node(new ParseNode(REPEAT_NODE, atom_node, lower, upper));
+    rep_node->lazy = lazy;
     return rep_node;
   }
   else {
@@ -179,17 +236,17 @@ ParseTree::atom()
   ParseNode *atom_node;
 
   // check for group
-  if (scanner.get_type() == LEFT_PAREN) {
+  if (scanner->get_type() == LEFT_PAREN) {
     atom_node = group();
   }
 
   // check for character set
-  else if (scanner.get_type() == LEFT_BRACKET) {
+  else if (scanner->get_type() == LEFT_BRACKET) {
     atom_node = char_set();
   }
 
   // check for character class
-  else if (scanner.get_type() == CHAR_CLASS) {
+  else if (scanner->get_type() == CHAR_CLASS) {
     atom_node = char_class();
   }
 
@@ -214,39 +271,50 @@ ParseTree::group()
   ParseNode *left;
   bool ignored_group = false;
 
-  if (scanner.get_type() != LEFT_PAREN) {
+  if (scanner->get_type() != LEFT_PAREN) {
     stringstream s;
-    s << "ERROR: Parse error - expected '(' but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected '(' but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  scanner.advance();
- 
-  if (scanner.get_type() == NO_GROUP_EXT)
-    scanner.advance();
-  if (scanner.get_type() == NAMED_GROUP_EXT)
-    scanner.advance();
-  if (scanner.get_type() == IGNORED_EXT) {
-    scanner.advance();
+  scanner->advance();
+
+  // capturing groups are numbered in the order of their left parentheses
+  int group = -1;
+  if (scanner->get_type() == NO_GROUP_EXT) {
+    scanner->advance();
+  }
+  else if (scanner->get_type() == NAMED_GROUP_EXT) {
+    group = group_names.size();
+    group_names.push_back(scanner->get_group_name());
+    scanner->advance();
+  }
+  else if (scanner->get_type() != IGNORED_EXT) {
+    group = group_names.size();
+    group_names.push_back("");
+  }
+  if (scanner->get_type() == IGNORED_EXT) {
+    scanner->advance();
     ignored_group = true;
   }
 
-  if (!ignored_group || scanner.get_type() != RIGHT_PAREN) {
+  if (!ignored_group || scanner->get_type() != RIGHT_PAREN) {
     left = expr();
   }
 
   if (ignored_group) {
-    group_node = new ParseNode(IGNORED_NODE, NULL, NULL);
+    group_node = add_node(new ParseNode(IGNORED_NODE, NULL, NULL));
   }
   else {
-    group_node = new ParseNode(GROUP_NODE, left, NULL);
+    group_node = add_node(new ParseNode(GROUP_NODE, left, NULL));
+    group_node->group = group;
   }
 
-  if (scanner.get_type() != RIGHT_PAREN) {
+  if (scanner->get_type() != RIGHT_PAREN) {
     stringstream s;
-    s << "ERROR: Parse error - expected ')' but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected ')' but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  scanner.advance();
+  scanner->advance();
 
   return group_node;
 }
@@ -262,35 +330,35 @@ ParseTree::character()
 {
   ParseNode *character_node;
 
-  if (scanner.get_type() == CHARACTER) {
-    char c = scanner.get_character();
-    scanner.advance();
-    character_node =  new ParseNode(CHARACTER_NODE, c);
+  if (scanner->get_type() == CHARACTER) {
+    CodePoint c = scanner->get_character();
+    scanner->advance();
+    character_node =  add_node(new ParseNode(CHARACTER_NODE, c));
   }
-  else if (scanner.get_type() == CARET) {
-    scanner.advance();
-    return new ParseNode(CARET_NODE, NULL, NULL);
+  else if (scanner->get_type() == CARET) {
+    scanner->advance();
+    return add_node(new ParseNode(CARET_NODE, NULL, NULL));
   }
-  else if (scanner.get_type() == DOLLAR) {
-    scanner.advance();
-    return new ParseNode(DOLLAR_NODE, NULL, NULL);
+  else if (scanner->get_type() == DOLLAR) {
+    scanner->advance();
+    return add_node(new ParseNode(DOLLAR_NODE, NULL, NULL));
   }
-  else if (scanner.get_type() == HYPHEN) {
+  else if (scanner->get_type() == HYPHEN) {
     addWarning("received HYPHEN outside char range - could be a bad range");
-    scanner.advance();
-    character_node =  new ParseNode(CHARACTER_NODE, '-');
+    scanner->advance();
+    character_node =  add_node(new ParseNode(CHARACTER_NODE, '-'));
   }
-  else if (scanner.get_type() == WORD_BOUNDARY) {
-    scanner.advance();
-    return new ParseNode(IGNORED_NODE, NULL, NULL);
+  else if (scanner->get_type() == WORD_BOUNDARY) {
+    scanner->advance();
+    return add_node(new ParseNode(IGNORED_NODE, NULL, NULL));
   }
   else {
     stringstream s;
-    s << "ERROR: Parse error - expected character type but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected character type but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  char c = character_node->character;
-  if (ispunct(c)) {
+  CodePoint c = character_node->character;
+  if (c < 128 && ispunct(c)) {
     if (punct_marks.find(c) == punct_marks.end()) {
       punct_marks.insert(c);
     }
@@ -303,8 +371,8 @@ ParseTree::character()
 ParseNode *
 ParseTree::char_class()
 {
-  char c = scanner.get_character();
-  scanner.advance();
+  char c = scanner->get_character();
+  scanner->advance();
 
   CharSet *char_set = new CharSet();
 
@@ -313,7 +381,7 @@ ParseTree::char_class()
   char_set_item.character = c;
   char_set->add_item(char_set_item);
 
-  ParseNode *char_set_node = new ParseNode(CHAR_SET_NODE, char_set);
+  ParseNode *char_set_node = add_node(new ParseNode(CHAR_SET_NODE, char_set));
   return char_set_node;
 }
 
@@ -326,27 +394,27 @@ ParseTree::char_set()
   ParseNode *char_set_node;
   bool is_complement = false;
 
-  if (scanner.get_type() != LEFT_BRACKET) {
+  if (scanner->get_type() != LEFT_BRACKET) {
     stringstream s;
-    s << "ERROR: Parse error - expected '[' but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected '[' but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  scanner.advance();
+  scanner->advance();
 
-  if (scanner.get_type() == CARET) {
+  if (scanner->get_type() == CARET) {
     is_complement = true;
-    scanner.advance();
+    scanner->advance();
   }
 
   char_set_node = char_list();
   if (is_complement) char_set_node->char_set->set_complement(true);
 
-  if (scanner.get_type() != RIGHT_BRACKET) {
+  if (scanner->get_type() != RIGHT_BRACKET) {
     stringstream s;
-    s << "ERROR: Parse error - expected ']' but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected ']' but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  scanner.advance();
+  scanner->advance();
 
   return char_set_node;
 }
@@ -361,8 +429,8 @@ ParseTree::char_list()
   ParseNode *char_set_node;
   
   // Check for end of list
-  if (scanner.get_type() == RIGHT_BRACKET) {
-    char_set_node = new ParseNode(CHAR_SET_NODE, new CharSet());
+  if (scanner->get_type() == RIGHT_BRACKET) {
+    char_set_node = add_node(new ParseNode(CHAR_SET_NODE, new CharSet()));
   }
   else {
     char_set_node = char_list();
@@ -380,10 +448,10 @@ ParseTree::char_list()
 CharSetItem
 ParseTree::list_item()
 {
-  if (scanner.is_char_range()) {
+  if (scanner->is_char_range()) {
     return char_range_item();
   }
-  else if (scanner.get_type() == CHAR_CLASS) {
+  else if (scanner->get_type() == CHAR_CLASS) {
     return char_class_item();
   }
   else {
@@ -402,31 +470,31 @@ ParseTree::character_item()
   CharSetItem char_set_item;
   char_set_item.type = CHARACTER_ITEM;
 
-  if (scanner.get_type() == CHARACTER) {
-    char c = scanner.get_character();
-    scanner.advance();
+  if (scanner->get_type() == CHARACTER) {
+    CodePoint c = scanner->get_character();
+    scanner->advance();
     char_set_item.character = c;
   }
-  else if (scanner.get_type() == CARET) {
-    scanner.advance();
+  else if (scanner->get_type() == CARET) {
+    scanner->advance();
     char_set_item.character = '^';
   }
-  else if (scanner.get_type() == DOLLAR) {
-    scanner.advance();
+  else if (scanner->get_type() == DOLLAR) {
+    scanner->advance();
     char_set_item.character = '$';
   }
-  else if (scanner.get_type() == HYPHEN) {
+  else if (scanner->get_type() == HYPHEN) {
     addWarning("received HYPHEN outside char range - could be a bad range");
-    scanner.advance();
+    scanner->advance();
     char_set_item.character = '-';
   }
   else {
     stringstream s;
-    s << "ERROR: Parse error - expected character type but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected character type but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  char c = char_set_item.character;
-  if (ispunct(c)) {
+  CodePoint c = char_set_item.character;
+  if (c < 128 && ispunct(c)) {
     if (punct_marks.find(c) == punct_marks.end()) {
       punct_marks.insert(c);
     }
@@ -441,8 +509,8 @@ ParseTree::char_class_item()
 {
   CharSetItem char_set_item;
   char_set_item.type = CHAR_CLASS_ITEM;
-  char_set_item.character = scanner.get_character();
-  scanner.advance();
+  char_set_item.character = scanner->get_character();
+  scanner->advance();
   return char_set_item;
 }
 
@@ -454,37 +522,40 @@ ParseTree::char_range_item()
   CharSetItem char_set_item;
   char_set_item.type = CHAR_RANGE_ITEM;
 
-  if (scanner.get_type() != CHARACTER) {
+  if (scanner->get_type() != CHARACTER) {
     stringstream s;
-    s << "ERROR: Parse error - expected character type but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected character type but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  char start = scanner.get_character();
-  scanner.advance();
+  CodePoint start = scanner->get_character();
+  scanner->advance();
 
-  if (scanner.get_type() != HYPHEN) {
+  if (scanner->get_type() != HYPHEN) {
     stringstream s;
-    s << "ERROR: Parse error - expected hyphen but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected hyphen but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  scanner.advance();
+  scanner->advance();
 
-  if (scanner.get_type() != CHARACTER) {
+  if (scanner->get_type() != CHARACTER) {
     stringstream s;
-    s << "ERROR: Parse error - expected character type but received " << scanner.get_type_str();
+    s << "ERROR: Parse error - expected character type but received " << scanner->get_type_str();
     throw EgretException(s.str());
   }
-  char end = scanner.get_character();
-  scanner.advance();
+  CodePoint end = scanner->get_character();
+  scanner->advance();
 
   bool good_range = false;
   if (start >= 'a' && end <= 'z') good_range = true;
   if (start >= 'A' && end <= 'Z') good_range = true;
   if (start >= '0' && end <= '9') good_range = true;
 
+  // ranges reaching past ASCII (such as accented letters) only need to be in order
+  if (end >= 128 && start <= end) good_range = true;
+
   if (!good_range) {
     stringstream s;
-    s << "ERROR: Bad range: " << start << "-" << end;
+    s << "ERROR: Bad range: " << encode_utf8(start) << "-" << encode_utf8(end);
     throw EgretException(s.str());
   }
 
@@ -493,6 +564,42 @@ ParseTree::char_range_item()
   return char_set_item;
 }
 
+void
+ParseTree::number_subtrees(EngineSession &session)
+{
+  number_subtree(root, session);
+}
+
+int
+ParseTree::number_subtree(ParseNode *node, EngineSession &session)
+{
+  if (!node) return -1;
+
+  int left_id = number_subtree(node->left, session);
+  int right_id = number_subtree(node->right, session);
+
+  // key is the node contents plus the ids of its (already numbered) children
+  stringstream key;
+  key << node->type << ":";
+  switch (node->type) {
+  case CHARACTER_NODE:
+    key << encode_utf8(node->character);
+    break;
+  case REPEAT_NODE:
+    key << node->repeat_lower << "," << node->repeat_upper;
+    break;
+  case CHAR_SET_NODE:
+    key << node->char_set->get_key();
+    break;
+  default:
+    break;
+  }
+  key << ":" << left_id << ":" << right_id;
+
+  node->subtree_id = session.get_subtree_id(key.str());
+  return node->subtree_id;
+}
+
 void
 ParseTree::print() {
   cout << "Tree:" << endl;
@@ -528,7 +635,7 @@ ParseTree::print_tree(ParseNode *node, unsigned offset)
     cout << "<ignored>";
     break;
   case CHARACTER_NODE:
-    cout << "<character: " << node->character << ">";
+    cout << "<character: " << encode_utf8(node->character) << ">";
     break;
   case CARET_NODE:
     cout << "<caret ^>";
@@ -568,6 +675,16 @@ ParseTree::add_stats(Stats &stats)
   stats.add("PARSE_TREE", "Ignored nodes", tree_stats.ignored_nodes);
 }
 
+unsigned long
+ParseTree::get_memory_usage(ParseNode *node)
+{
+  if (!node) return 0;
+
+  unsigned long bytes = sizeof(ParseNode);
+  if (node->char_set) bytes += node->char_set->get_memory_usage();
+  return bytes + get_memory_usage(node->left) + get_memory_usage(node->right);
+}
+
 void
 ParseTree::gather_stats(ParseNode *node, ParseTreeStats &tree_stats)
 {
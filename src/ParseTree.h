@@ -89,6 +89,8 @@
 #include "Stats.h"
 using namespace std;
 
+class EngineSession;
+
 typedef enum
 {
   ALTERNATION_NODE,
@@ -109,6 +111,9 @@ struct ParseNode
     left = l;
     right = r;
     char_set = NULL;
+    subtree_id = -1;
+    lazy = false;
+    group = -1;
   }
 
   ParseNode(NodeType t, CharSet *c) {
@@ -117,15 +122,21 @@ struct ParseNode
     left = NULL;
     right = NULL;
     char_set = c;
+    subtree_id = -1;
+    lazy = false;
+    group = -1;
   }
 
-  ParseNode(NodeType t, char c) {
+  ParseNode(NodeType t, CodePoint c) {
     assert(t == CHARACTER_NODE);
     type = t;
     left = NULL;
     right = NULL;
     char_set = NULL;
     character = c;
+    subtree_id = -1;
+    lazy = false;
+    group = -1;
   }
 
   ParseNode(NodeType t, ParseNode *l, int lower, int upper) {
@@ -136,29 +147,50 @@ struct ParseNode
     char_set = NULL;
     repeat_lower = lower;
     repeat_upper = upper;
+    subtree_id = -1;
+    lazy = false;
+    group = -1;
   }
 
   NodeType type;
   ParseNode *left;
   ParseNode *right;
   CharSet *char_set;	// For CHAR_SET_NODE
-  char character;	// For CHARACTER_NODE
+  CodePoint character;	// For CHARACTER_NODE
   int repeat_lower;	// For REPEAT_NODE
   int repeat_upper;	// For REPEAT_NODE (-1 for no limit)
+  bool lazy;		// For REPEAT_NODE (true if the fewest repetitions are preferred)
+  int group;		// For GROUP_NODE (index of a capturing group, -1 if not capturing)
+  int subtree_id;	// structural id assigned by an engine session (-1 if none)
 };
 
 class ParseTree {
 
 public:
 
-  // build parse tree using regex stored in scanner
+  ParseTree() { root = NULL; scanner = NULL; tree_bytes = 0; }
+  ParseTree(ParseTree &&other);
+  ~ParseTree();
+
+  // the tree owns its nodes, so it is moved rather than copied
+  ParseTree(const ParseTree &other) = delete;
+  ParseTree &operator= (const ParseTree &other) = delete;
+
+  // build parse tree using regex stored in scanner (the tokens are read in
+  // place, leaving the scanner at the end of the regex)
   void build(Scanner &_scanner);
 
   // get root of the tree
   ParseNode *get_root() { return root; }
 
+  // assigns each node the session id of its subtree structure
+  void number_subtrees(EngineSession &session);
+
   // get set of punctuation marks
-  set<char> get_punct_marks() { return punct_marks; }
+  const set<char> &get_punct_marks() { return punct_marks; }
+
+  // get the names of the capturing groups in order ("" for an unnamed group)
+  const vector <string> &get_group_names() { return group_names; }
 
   // prints the tree
   void print();
@@ -169,8 +201,18 @@ public:
 private:
 
   ParseNode *root;		// root of parse tree
-  Scanner scanner;		// scanner
+  Scanner *scanner;		// scanner being parsed (during build)
   set<char> punct_marks;	// set of punctuation marks
+  vector <string> group_names;	// names of the capturing groups
+  vector <ParseNode *> nodes;	// every node created (with its char set), so
+				// a parse error frees the nodes built so far
+  unsigned long tree_bytes;	// bytes accounted for the tree
+
+  // frees the nodes
+  void clear();
+
+  // records a new node, returns node
+  ParseNode *add_node(ParseNode *node);
 
   // creation functions
   ParseNode *expr();
@@ -187,6 +229,9 @@ private:
   CharSetItem char_class_item();
   CharSetItem char_range_item();
 
+  // assigns ids to node and its children, returns the id for node
+  int number_subtree(ParseNode *node, EngineSession &session);
+
   // print the tree
   void print_tree(ParseNode *node, unsigned offset);
 
@@ -205,6 +250,9 @@ private:
   };
   void gather_stats(ParseNode *node, ParseTreeStats &tree_stats);
 
+  // returns the bytes used by the subtree rooted at node
+  unsigned long get_memory_usage(ParseNode *node);
+
 };
 
 #endif // PARSE_TREE_H
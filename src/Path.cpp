@@ -19,54 +19,155 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cassert>
+#include <map>
 #include <set>
 #include <sstream>
 #include <string>
 #include <vector>
 #include "Path.h"
 #include "Edge.h"
+#include "MemoryUsage.h"
+#include "Trace.h"
 using namespace std;
 
 void
-Path::append(Edge *edge, unsigned int state)
+PathTrie::set_root(unsigned int initial, const vector <vector <Transition> > *t)
 {
-  edges.push_back(edge);
-  states.push_back(state);
+  edge_table = t;
+  releaseMemoryUsage(PATH_MEMORY, nodes.size() * sizeof(PathNode));
+  nodes.clear();
+  path_strings.clear();
+  PathNode root;
+  root.parent = -1;
+  root.state = initial;
+  root.string_path = -1;
+  root.string_length = 0;
+  nodes.push_back(root);
+  addMemoryUsage(PATH_MEMORY, sizeof(PathNode));
+}
+
+unsigned int
+PathTrie::add_child(unsigned int parent, unsigned int state)
+{
+  PathNode node;
+  node.parent = parent;
+  node.state = state;
+  node.string_path = -1;
+  node.string_length = 0;
+  nodes.push_back(node);
+  addMemoryUsage(PATH_MEMORY, sizeof(PathNode));
+  return nodes.size() - 1;
+}
+
+void
+PathTrie::remove_last(unsigned int node)
+{
+  assert(node == nodes.size() - 1);
+  nodes.pop_back();
+  releaseMemoryUsage(PATH_MEMORY, sizeof(PathNode));
 }
 
 void
-Path::remove_last()
+PathTrie::get_path_nodes(unsigned int node, vector <unsigned int> &path_nodes)
 {
-  edges.pop_back();
-  states.pop_back();
+  path_nodes.clear();
+  for (int n = node; n != -1; n = nodes[n].parent) {
+    path_nodes.push_back(n);
+  }
+  reverse(path_nodes.begin(), path_nodes.end());
 }
 
 void
-Path::mark_path_visited(bool *visited)
+PathTrie::mark_path_visited(unsigned int node, bool *visited)
 {
-  vector <unsigned int>::iterator it;
-  for (it = states.begin(); it != states.end(); it++) {
-    visited[*it] = true;
+  for (int n = node; n != -1; n = nodes[n].parent) {
+    visited[nodes[n].state] = true;
   }
 }
 
+string &
+PathTrie::get_path_string(unsigned int path)
+{
+  if (path >= path_strings.size()) path_strings.resize(path + 1);
+  return path_strings[path];
+}
+
+unsigned long
+Path::get_memory_usage()
+{
+  return sizeof(Path) + (char_set_nodes.capacity() + string_nodes.capacity()
+      + loop_nodes.capacity()) * sizeof(unsigned int);
+}
+
 string
-Path::gen_initial_string(string base_substring)
+Path::gen_initial_string(const string &base_substring)
 {
-  path_string = "";
-  for (unsigned int i = 0; i < edges.size(); i++) {
-    bool process_edge = edges[i]->process_edge_in_path(path_string, base_substring);
-    if (process_edge) {
-      evil_edges.push_back(i);
+  TraceSpan span("Path::gen_initial_string", "path", index);
+  vector <unsigned int> path_nodes;
+  trie->get_path_nodes(leaf, path_nodes);
+  string &path_string = trie->get_path_string(index);
+
+  // start with the prefix generated by an earlier path
+  unsigned int i = 1;
+  while (i < path_nodes.size() && trie->get_node(path_nodes[i]).string_path != -1) i++;
+  PathNode &shared = trie->get_node(path_nodes[i - 1]);
+  if (i == 1) path_string = "";
+  else path_string = trie->get_path_string(shared.string_path).substr(0, shared.string_length);
+
+  // loops in the prefix are entered again so an iteration that ends in the
+  // rest of the path is measured from this path
+  for (unsigned int k = 1; k < i; k++) {
+    Edge *edge = trie->get_edge(path_nodes[k]);
+    if (edge->getType() == BEGIN_LOOP_EDGE) {
+      unsigned int prefix_length = trie->get_node(path_nodes[k - 1]).string_length;
+      EdgeHandler <BEGIN_LOOP_EDGE>::process_in_path(edge, path_string, prefix_length,
+          base_substring);
+    }
+  }
+
+  // generate the rest
+  for (; i < path_nodes.size(); i++) {
+    PathNode &node = trie->get_node(path_nodes[i]);
+    Edge *edge = trie->get_edge(path_nodes[i]);
+    if (edge->process_in_path(path_string, path_string.length(), base_substring)) {
+      add_evil_node(edge->getType(), path_nodes[i]);
     }
-    path_string += edges[i]->get_substring();
+    node.string_path = index;
+    node.string_length = path_string.length();
   }
   return path_string;
 }
 
+void
+Path::add_evil_node(EdgeType type, unsigned int node)
+{
+  switch (type) {
+    case CHAR_SET_EDGE: char_set_nodes.push_back(node); break;
+    case STRING_EDGE: string_nodes.push_back(node); break;
+    case END_LOOP_EDGE: loop_nodes.push_back(node); break;
+    default: break;
+  }
+}
+
+vector <Edge *>
+Path::get_edges()
+{
+  vector <unsigned int> path_nodes;
+  trie->get_path_nodes(leaf, path_nodes);
+
+  vector <Edge *> edges;
+  for (unsigned int i = 1; i < path_nodes.size(); i++) {
+    edges.push_back(trie->get_edge(path_nodes[i]));
+  }
+  return edges;
+}
+
 bool
 Path::has_leading_caret()
 {
+  vector <Edge *> edges = get_edges();
   for (unsigned int i = 0; i < edges.size(); i++) {
     if (edges[i]->getType() == CARET_EDGE) {
       return true;
@@ -81,6 +182,7 @@ Path::has_leading_caret()
 bool
 Path::has_trailing_dollar()
 {
+  vector <Edge *> edges = get_edges();
   for (unsigned int i = edges.size() - 1; i > 0; i--) {
     if (edges[i]->getType() == DOLLAR_EDGE) {
       return true;
@@ -101,6 +203,7 @@ Path::check_anchor_middle()
   bool dollar_in_middle = false;
   unsigned int caret_index;
   unsigned int dollar_index;
+  vector <Edge *> edges = get_edges();
 
   // traverse the path
   for (unsigned int i = 0; i < edges.size(); i++) {
@@ -130,16 +233,14 @@ Path::check_anchor_middle()
   // return if no violations
   if (!caret_in_middle && !dollar_in_middle) return "";
 
-  // create before and after substring
+  // create before and after substring (edge i is reached by node i + 1, and
+  // its substring ends where the node's prefix does)
+  vector <unsigned int> path_nodes;
+  trie->get_path_nodes(leaf, path_nodes);
+  const string &path_string = trie->get_path_string(index);
   unsigned int split_index = caret_in_middle ? caret_index : dollar_index;
-  string before = "";
-  for (unsigned int i = 0; i < split_index; i++) {
-    before += edges[i]->get_substring();
-  }
-  string after = "";
-  for (unsigned int i = split_index + 1; i < edges.size(); i++) {
-    after += edges[i]->get_substring();
-  }
+  string before = path_string.substr(0, trie->get_node(path_nodes[split_index]).string_length);
+  string after = path_string.substr(trie->get_node(path_nodes[split_index + 1]).string_length);
  
   // generate error message
   if (caret_in_middle) {
@@ -159,15 +260,71 @@ Path::check_anchor_middle()
 }
 
 set <string>
-Path::gen_evil_strings(const set <char> &punct_marks)
+Path::gen_evil_strings(TestCharCache &test_chars, map <string, set <string> > *coverage)
 {
   set <string> evil_strings;
+  add_evil_strings <CHAR_SET_EDGE> (char_set_nodes, test_chars, evil_strings, coverage);
+  add_evil_strings <STRING_EDGE> (string_nodes, test_chars, evil_strings, coverage);
+  add_evil_strings <END_LOOP_EDGE> (loop_nodes, test_chars, evil_strings, coverage);
+  return evil_strings;
+}
+
+vector <unsigned int>
+Path::get_evil_nodes()
+{
+  vector <unsigned int> nodes(char_set_nodes);
+  nodes.insert(nodes.end(), string_nodes.begin(), string_nodes.end());
+  nodes.insert(nodes.end(), loop_nodes.begin(), loop_nodes.end());
+  return nodes;
+}
+
+set <string>
+Path::gen_evil_strings(unsigned int node, TestCharCache &test_chars)
+{
+  const string &path_string = trie->get_path_string(index);
+  Edge *edge = trie->get_edge(node);
 
-  vector <unsigned int>::iterator it;
-  for (unsigned int i = 0; i < evil_edges.size(); i++) {
-    int index = evil_edges[i];
-    set <string> new_strings = edges[index]->gen_evil_strings(path_string, punct_marks);
-    evil_strings.insert(new_strings.begin(), new_strings.end());
+  set <string> evil_strings;
+  switch (edge->getType()) {
+    case CHAR_SET_EDGE:
+      evil_strings = EdgeHandler <CHAR_SET_EDGE>::gen_evil_strings(edge, path_string, test_chars);
+      break;
+    case STRING_EDGE:
+      evil_strings = EdgeHandler <STRING_EDGE>::gen_evil_strings(edge, path_string, test_chars);
+      break;
+    case END_LOOP_EDGE:
+      evil_strings = EdgeHandler <END_LOOP_EDGE>::gen_evil_strings(edge, path_string, test_chars);
+      break;
+    default:
+      break;
   }
+  addMemoryUsage(STRING_MEMORY, getStringSetMemory(evil_strings));
   return evil_strings;
 }
+
+template <EdgeType T>
+void
+Path::add_evil_strings(const vector <unsigned int> &nodes, TestCharCache &test_chars,
+    set <string> &evil_strings, map <string, set <string> > *coverage)
+{
+  const string &path_string = trie->get_path_string(index);
+
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    Edge *edge = trie->get_edge(nodes[i]);
+    TraceSpan span("Edge::gen_evil_strings", "edge_type", T);
+    set <string> new_strings = EdgeHandler <T>::gen_evil_strings(edge, path_string, test_chars);
+    addMemoryUsage(STRING_MEMORY, getStringSetMemory(new_strings));
+    set <string>::iterator si;
+    for (si = new_strings.begin(); si != new_strings.end(); si++) {
+      if (evil_strings.insert(*si).second) {
+        addMemoryUsage(STRING_MEMORY, getStringMemory(*si));
+      }
+      if (coverage != NULL) {
+        stringstream feature;
+        feature << "edge " << edge << " " << EdgeHandler <T>::get_partition(edge, *si, path_string);
+        (*coverage)[*si].insert(feature.str());
+      }
+    }
+    releaseMemoryUsage(STRING_MEMORY, getStringSetMemory(new_strings));
+  }
+}
@@ -22,30 +22,93 @@
 #ifndef PATH_H
 #define PATH_H
 
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
 #include "Edge.h"
 using namespace std;
 
+// Paths are stored as a trie: each node holds the state reached from its
+// parent's state (the edge between them is found in the NFA's edge table), so
+// paths that share a prefix share its nodes and a path is identified by its
+// last node.  The edges of a path are walked on demand, and a node's part of
+// the initial strings is generated once, by the first path through it, and
+// then found at an offset of that path's string.
+
+// a node of a path trie
+struct PathNode
+{
+  int parent;			// parent node (-1 for the root)
+  unsigned int state;		// state reached from the parent's state
+  int string_path;		// path whose initial string has this node's prefix
+				// (-1 until generated)
+  unsigned int string_length;	// length of that prefix through the edge
+};
+
+class PathTrie {
+
+public:
+
+  PathTrie() { edge_table = NULL; }
+
+  // removes all nodes and adds the root for state initial (node 0) of the
+  // NFA with edge table t
+  void set_root(unsigned int initial, const vector <vector <Transition> > *t);
+
+  // adds a child of parent reaching state
+  unsigned int add_child(unsigned int parent, unsigned int state);
+
+  // removes node, which must be the last node added
+  void remove_last(unsigned int node);
+
+  // returns a node
+  PathNode &get_node(unsigned int node) { return nodes[node]; }
+
+  // returns the edge into a node (other than the root)
+  Edge *get_edge(unsigned int node) {
+    return find_transition((*edge_table)[nodes[nodes[node].parent].state], nodes[node].state);
+  }
+
+  // returns the number of nodes
+  unsigned int get_num_nodes() { return nodes.size(); }
+
+  // sets path_nodes to the nodes from the root to node
+  void get_path_nodes(unsigned int node, vector <unsigned int> &path_nodes);
+
+  // marks the states from the root to node as visited
+  void mark_path_visited(unsigned int node, bool *visited);
+
+  // returns the initial string of a path (empty until generated)
+  string &get_path_string(unsigned int path);
+
+private:
+
+  const vector <vector <Transition> > *edge_table;	// edge table of the NFA
+  vector <PathNode> nodes;			// nodes (the root is node 0)
+  vector <string> path_strings;			// initial string of each path
+};
+
 class Path {
 
 public:
 
-  Path() {}
-  Path(unsigned int initial) { states.push_back(initial); }
+  Path() { trie = NULL; leaf = 0; index = 0; }
+  Path(PathTrie *t, unsigned int l, unsigned int i) { trie = t; leaf = l; index = i; }
 
-  // adds an edge and the destination state to the path 
-  void append(Edge *edge, unsigned int state);
+  // returns the bytes used by the path (the trie's nodes are counted as they
+  // are added)
+  unsigned long get_memory_usage();
 
-  // removes the last edge and state
-  void remove_last();
+  // generates the initial test string for the path (the edges of nodes
+  // shared with an earlier path are not processed again)
+  string gen_initial_string(const string &base_substring);
 
-  // marks the states in the path as visited
-  void mark_path_visited(bool *visited);
+  // returns the last node of the path
+  unsigned int get_leaf() { return leaf; }
 
-  // generates the initial test string for the path
-  string gen_initial_string(string base_substring);
+  // returns the string made by gen_initial_string
+  const string &get_path_string() { return trie->get_path_string(index); }
 
   // returns true if path has a leading caret
   bool has_leading_caret();
@@ -57,15 +120,40 @@ public:
   // middle of the path, returns an empty string otherwise
   string check_anchor_middle();
 
-  // generates evil strings for the path
-  set <string> gen_evil_strings(const set <char> &punct_marks);
+  // generates evil strings for the path (adding the edge and input partition
+  // each string exercises to coverage when it is given)
+  set <string> gen_evil_strings(TestCharCache &test_chars,
+      map <string, set <string> > *coverage = NULL);
+
+  // returns the nodes whose edges were processed by this path
+  vector <unsigned int> get_evil_nodes();
+
+  // generates the evil strings for one node from get_evil_nodes (their
+  // memory is accounted and must be released by the caller)
+  set <string> gen_evil_strings(unsigned int node, TestCharCache &test_chars);
 
 private:
 
-  vector <unsigned int> states;		// list of states
-  vector <Edge *> edges;		// list of edges
-  vector <unsigned int> evil_edges;	// list of evil edges that need processing
-  string path_string;			// test string associated with path
+  PathTrie *trie;			// trie holding the path
+  unsigned int leaf;			// last node of the path
+  unsigned int index;			// index of the path (for its string)
+
+  // nodes whose edges need processing, kept apart by edge type so each kind
+  // is handled in its own loop
+  vector <unsigned int> char_set_nodes;	// CHAR_SET_EDGE nodes
+  vector <unsigned int> string_nodes;	// STRING_EDGE nodes
+  vector <unsigned int> loop_nodes;	// END_LOOP_EDGE nodes
+
+  // adds a node whose edge (of type type) needs processing
+  void add_evil_node(EdgeType type, unsigned int node);
+
+  // returns the edges of the path in order
+  vector <Edge *> get_edges();
+
+  // adds the evil strings for the edges of nodes (all of edge type T)
+  template <EdgeType T>
+  void add_evil_strings(const vector <unsigned int> &nodes, TestCharCache &test_chars,
+      set <string> &evil_strings, map <string, set <string> > *coverage);
 };
 
 #endif // PATH_H
@@ -21,7 +21,9 @@
 
 #include <iostream>
 #include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 #include "RegexLoop.h"
 using namespace std;
 
@@ -39,57 +41,72 @@ RegexLoop::get_substring()
 }
 
 void
-RegexLoop::process_begin_loop(string prefix, bool processed)
+RegexLoop::process_begin_loop(unsigned int length, bool processed)
 {
-  curr_prefix = prefix;
-  if (!processed) path_prefix = prefix;
+  curr_prefix_length = length;
+  if (!processed) prefix_length = length;
 }
 
 void
-RegexLoop::process_end_loop(string prefix, bool processed)
+RegexLoop::process_end_loop(const string &path_string, unsigned int length, bool processed)
 {
-  curr_substring = prefix.substr(curr_prefix.length());
-  if (!processed) path_substring = curr_substring;
+  // the iteration is copied only when get_substring repeats it
+  unsigned int curr_length = length - curr_prefix_length;
+  if (repeat_lower > 1) curr_substring.assign(path_string, curr_prefix_length, curr_length);
+  if (!processed) {
+    substring_start = curr_prefix_length;
+    substring_length = curr_length;
+  }
 }
 
 set <string>
-RegexLoop::gen_evil_strings(string path_string)
+RegexLoop::gen_evil_strings(const string &path_string)
 {
   set <string> evil_strings;
-  string path_suffix = path_string.substr(path_prefix.length() + path_substring.length());
-  string one_less_string = path_prefix + path_suffix;
-  string one_more_string = path_prefix + path_substring + path_substring + path_suffix;
+  unsigned int suffix_start = prefix_length + substring_length;
+
+  // the path has one iteration at substring_start (the rest are in the suffix)
+  vector <int> iterations = get_evil_iterations();
+  vector <int>::iterator it;
+  for (it = iterations.begin(); it != iterations.end(); it++) {
+    string evil_string;
+    evil_string.reserve(path_string.length() + (*it + 1) * substring_length);
+    evil_string.append(path_string, 0, prefix_length);
+    for (int i = -1; i < *it; i++) {
+      evil_string.append(path_string, substring_start, substring_length);
+    }
+    evil_string.append(path_string, suffix_start, string::npos);
+    evil_strings.insert(evil_string);
+  }
+
+  return evil_strings;
+}
+
+vector <int>
+RegexLoop::get_evil_iterations()
+{
+  vector <int> iterations;
 
   if (repeat_upper != -1) {
 
     // For cases like {n}, add strings for one less (n-1) and one more (n+1).
     if (repeat_lower == repeat_upper) {
-      evil_strings.insert(one_less_string);
-      evil_strings.insert(one_more_string);
+      iterations.push_back(-1);
+      iterations.push_back(1);
     }
     else {
       // Handle one less on lower bound (note if lower bound is zero, the path
       // has one iteration so one less iteration will get us to zero iterations)
-      evil_strings.insert(one_less_string);
+      iterations.push_back(-1);
 
-      // Add enough path elements to get to the upper bound (note if lower bound
+      // Add enough iterations to get to the upper bound (note if lower bound
       // is zero, the path has one iteration so the starting point is bumped to one).
-      // The variable path_elements is initialized to path_substring since path_suffix
-      // has one substring less than lower bound.
       int base_iterations = repeat_lower;
       if (base_iterations == 0) base_iterations = 1;
-      string path_elements = path_substring;
-      for (int i = base_iterations; i < repeat_upper; i++) {
-        path_elements += path_substring;
-      }
-
-      // Add the upper bound string.
-      string upper_bound_string = path_prefix + path_elements + path_suffix;
-      evil_strings.insert(upper_bound_string);
+      iterations.push_back(repeat_upper - base_iterations);
 
       // Add the string with one more iteration past the upper bound.
-      string past_bound_string = path_prefix + path_elements + path_substring + path_suffix;
-      evil_strings.insert(past_bound_string);
+      iterations.push_back(repeat_upper - base_iterations + 1);
     } 
   }
 
@@ -97,16 +114,27 @@ RegexLoop::gen_evil_strings(string path_string)
     // If lower bound is 0 or 1, add one less (zero) and add one more (two).  Want
     // to have one case that has repeated (two) elements.
     if (repeat_lower == 0 || repeat_lower == 1) {
-      evil_strings.insert(one_less_string);
-      evil_strings.insert(one_more_string);
+      iterations.push_back(-1);
+      iterations.push_back(1);
     }
     // Otherwise, only add the string with one less iteration than the lower bound.
     else {
-      evil_strings.insert(one_less_string);
+      iterations.push_back(-1);
     }
   }
 
-  return evil_strings;
+  return iterations;
+}
+
+string
+RegexLoop::get_partition(const string &evil_string, const string &path_string)
+{
+  // evil strings differ from the path string by whole iterations
+  if (substring_length == 0) return "";
+  long difference = (long) evil_string.length() - (long) path_string.length();
+  stringstream s;
+  s << "iterations " << difference / (long) substring_length;
+  return s.str();
 }
 
 void
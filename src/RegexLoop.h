@@ -24,6 +24,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 using namespace std;
 
 class RegexLoop {
@@ -33,19 +34,33 @@ public:
   RegexLoop(int lower, int upper) {
     repeat_lower = lower;
     repeat_upper = upper;
+    prefix_length = 0;
+    substring_start = 0;
+    substring_length = 0;
+    curr_prefix_length = 0;
   }
 
+  int get_lower() { return repeat_lower; }
+  int get_upper() { return repeat_upper; }
+
   // get substring - additional iterations for lower bounds greater than 1
   string get_substring();
 
-  // process begin loop edge
-  void process_begin_loop(string prefix, bool processed);
+  // process begin loop edge reached after prefix_length characters of the path
+  void process_begin_loop(unsigned int prefix_length, bool processed);
 
-  // process end loop edge
-  void process_end_loop(string prefix, bool processed);
+  // process end loop edge reached after prefix_length characters of path_string
+  void process_end_loop(const string &path_string, unsigned int prefix_length,
+      bool processed);
 
   // generate evil strings
-  set <string> gen_evil_strings(string path_string);
+  set <string> gen_evil_strings(const string &path_string);
+
+  // returns the iterations each evil string adds to the path (-1 for one less)
+  vector <int> get_evil_iterations();
+
+  // returns the input partition exercised by an evil string from gen_evil_strings
+  string get_partition(const string &evil_string, const string &path_string);
 
   // print the regex loop
   void print();
@@ -54,10 +69,14 @@ private:
 
   int repeat_lower;     	// lower bound for repeat quantifiers 
   int repeat_upper;     	// upper bound for repeat quantifiers (-1 if no bound)
-  string path_prefix;           // path string up to visiting this node
-  string path_substring;        // substring corresponding to this string
-  string curr_prefix;           // current path string up to visiting this node
-  string curr_substring;        // current substring corresponding to this string
+
+  // The path is only known by offsets: the strings are cut from the path
+  // string when the evil strings are made.
+  unsigned int prefix_length;		// length of path string up to visiting this node
+  unsigned int substring_start;		// start of the iteration in the path string
+  unsigned int substring_length;	// length of the iteration in the path string
+  unsigned int curr_prefix_length;	// length of current path string up to this node
+  string curr_substring;        	// current iteration (only kept when repeated)
 };
 
 #endif // REGEX_LOOP_H
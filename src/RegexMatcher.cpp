@@ -0,0 +1,648 @@
+/*  RegexMatcher.cpp: tests strings against a regex
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "CharSet.h"
+#include "ParseTree.h"
+#include "RegexMatcher.h"
+#include "Unicode.h"
+using namespace std;
+
+const unsigned int WORD_BITS = 64;
+const unsigned long MAX_POSITIONS = 4096;	// larger regexes are not matched
+const unsigned long MAX_CAPTURE_STEPS = 1000000;	// steps before a capture search gives up
+const unsigned int MAX_CAPTURE_DEPTH = 10000;	// recursion allowed in a capture search
+
+bool
+RegexMatcher::build(ParseTree &tree)
+{
+  supported = false;
+
+  ParseNode *root = tree.get_root();
+  unsigned long count = 0;
+  if (!count_positions(root, count) || count > MAX_POSITIONS) return false;
+
+  num_positions = 0;
+  num_words = (count + WORD_BITS - 1) / WORD_BITS;
+  if (num_words == 0) num_words = 1;
+  carets.assign(num_words, 0);
+  dollars.assign(num_words, 0);
+  follow.assign(count * num_words, 0);
+  ascii_masks.assign(128 * num_words, 0);
+  position_chars.clear();
+
+  Fragment fragment = build_fragment(root);
+  nullable = fragment.nullable;
+  first = fragment.first;
+  last = fragment.last;
+
+  if (num_words == 1) build_follow_blocks();
+  build_unicode_masks();
+
+  capture_nodes.clear();
+  capture_root = add_capture_node(root);
+  group_names = tree.get_group_names();
+
+  supported = true;
+  return true;
+}
+
+bool
+RegexMatcher::can_build(ParseTree &tree)
+{
+  unsigned long count = 0;
+  return count_positions(tree.get_root(), count) && count <= MAX_POSITIONS;
+}
+
+bool
+RegexMatcher::matches(const string &s) const
+{
+  if (num_words == 1) return match_single(s);
+  return match_general(s);
+}
+
+StringClass
+RegexMatcher::classify(const string &s) const
+{
+  if (!supported) return UNCLASSIFIED_STRING;
+  return matches(s) ? MATCH_STRING : NON_MATCH_STRING;
+}
+
+bool
+RegexMatcher::find_groups(const string &s, vector <int> &spans) const
+{
+  CaptureState state;
+  state.s = &s;
+  state.marks.assign(2 * group_names.size(), -1);
+  state.steps = 0;
+  state.depth = 0;
+  state.gave_up = false;
+  if (!capture(capture_root, 0, NULL, state) || state.gave_up) return false;
+
+  // convert byte offsets to code point offsets (as Python counts them)
+  vector <int> code_points(s.length() + 1, 0);
+  for (unsigned int i = 0; i < s.length(); i++) {
+    code_points[i + 1] = code_points[i] + (((unsigned char) s[i] & 0xC0) != 0x80);
+  }
+  spans.clear();
+  vector <int>::iterator it;
+  for (it = state.marks.begin(); it != state.marks.end(); it++) {
+    spans.push_back(*it == -1 ? -1 : code_points[*it]);
+  }
+  return true;
+}
+
+bool
+RegexMatcher::count_positions(ParseNode *node, unsigned long &count)
+{
+  if (node == NULL) return true;
+
+  switch (node->type) {
+  case ALTERNATION_NODE:
+  case CONCAT_NODE:
+    return count_positions(node->left, count) && count_positions(node->right, count);
+
+  case GROUP_NODE:
+    return count_positions(node->left, count);
+
+  case REPEAT_NODE:
+  {
+    // every copy of a repeated subexpression has its own positions
+    unsigned long child = 0;
+    if (!count_positions(node->left, child)) return false;
+    unsigned long copies = node->repeat_upper;
+    if (node->repeat_upper == -1) copies = (node->repeat_lower == 0) ? 1 : node->repeat_lower;
+    if (child != 0 && copies > MAX_POSITIONS / child) {
+      count = MAX_POSITIONS + 1;
+      return true;
+    }
+    count += child * copies;
+    return true;
+  }
+
+  case CHARACTER_NODE:
+  case CHAR_SET_NODE:
+  case CARET_NODE:
+  case DOLLAR_NODE:
+    count++;
+    return true;
+
+  // \b and extensions such as lookarounds are ignored by the parser
+  default:
+    return false;
+  }
+}
+
+RegexMatcher::Fragment
+RegexMatcher::build_fragment(ParseNode *node)
+{
+  if (node == NULL) return empty_fragment();
+
+  switch (node->type) {
+  case ALTERNATION_NODE:
+  {
+    Fragment left = build_fragment(node->left);
+    Fragment right = build_fragment(node->right);
+    left.nullable = left.nullable || right.nullable;
+    for (unsigned int w = 0; w < num_words; w++) {
+      left.first[w] |= right.first[w];
+      left.last[w] |= right.last[w];
+    }
+    return left;
+  }
+
+  case CONCAT_NODE:
+  {
+    Fragment left = build_fragment(node->left);
+    Fragment right = build_fragment(node->right);
+    return concat(left, right);
+  }
+
+  case GROUP_NODE:
+    return build_fragment(node->left);
+
+  case REPEAT_NODE:
+  {
+    int lower = node->repeat_lower;
+    int upper = node->repeat_upper;
+
+    // x{m,} is m - 1 copies of x followed by x+ (or x* if m is 0)
+    Fragment result = empty_fragment();
+    for (int i = 0; i < lower; i++) {
+      Fragment copy = build_fragment(node->left);
+      if (upper == -1 && i == lower - 1) add_follow(copy.last, copy.first);
+      result = concat(result, copy);
+    }
+    if (upper == -1 && lower == 0) {
+      Fragment copy = build_fragment(node->left);
+      add_follow(copy.last, copy.first);
+      copy.nullable = true;
+      result = concat(result, copy);
+    }
+
+    // x{m,n} is m copies of x followed by (x(x(...)?)?)? with n - m copies
+    else if (upper > lower) {
+      Fragment optional = empty_fragment();
+      for (int i = lower; i < upper; i++) {
+        Fragment copy = build_fragment(node->left);
+        optional = concat(copy, optional);
+        optional.nullable = true;
+      }
+      result = concat(result, optional);
+    }
+    return result;
+  }
+
+  case CHARACTER_NODE:
+  {
+    CharInterval interval = {node->character, node->character};
+    return add_position(vector <CharInterval>(1, interval), CHARACTER_NODE);
+  }
+
+  case CHAR_SET_NODE:
+    return add_position(node->char_set->get_intervals(), CHAR_SET_NODE);
+
+  case CARET_NODE:
+  case DOLLAR_NODE:
+    return add_position(vector <CharInterval>(), node->type);
+
+  default:
+    return empty_fragment();
+  }
+}
+
+RegexMatcher::Fragment
+RegexMatcher::empty_fragment()
+{
+  Fragment fragment;
+  fragment.nullable = true;
+  fragment.first.assign(num_words, 0);
+  fragment.last.assign(num_words, 0);
+  return fragment;
+}
+
+RegexMatcher::Fragment
+RegexMatcher::add_position(const vector <CharInterval> &chars, NodeType anchor)
+{
+  unsigned int p = num_positions++;
+  unsigned int w = p / WORD_BITS;
+  Word bit = 1ULL << (p % WORD_BITS);
+
+  position_chars.push_back(chars);
+  if (anchor == CARET_NODE) carets[w] |= bit;
+  if (anchor == DOLLAR_NODE) dollars[w] |= bit;
+
+  for (CodePoint c = 0; c < 128; c++) {
+    if (in_intervals(chars, c)) ascii_masks[c * num_words + w] |= bit;
+  }
+
+  Fragment fragment = empty_fragment();
+  fragment.nullable = false;
+  fragment.first[w] = bit;
+  fragment.last[w] = bit;
+  return fragment;
+}
+
+RegexMatcher::Fragment
+RegexMatcher::concat(const Fragment &a, const Fragment &b)
+{
+  add_follow(a.last, b.first);
+
+  Fragment fragment;
+  fragment.nullable = a.nullable && b.nullable;
+  fragment.first = a.first;
+  fragment.last = b.last;
+  for (unsigned int w = 0; w < num_words; w++) {
+    if (a.nullable) fragment.first[w] |= b.first[w];
+    if (b.nullable) fragment.last[w] |= a.last[w];
+  }
+  return fragment;
+}
+
+void
+RegexMatcher::add_follow(const vector <Word> &from, const vector <Word> &to)
+{
+  for (unsigned int w = 0; w < num_words; w++) {
+    Word bits = from[w];
+    while (bits != 0) {
+      unsigned int p = w * WORD_BITS + __builtin_ctzll(bits);
+      bits &= bits - 1;
+      for (unsigned int k = 0; k < num_words; k++) {
+        follow[p * num_words + k] |= to[k];
+      }
+    }
+  }
+}
+
+void
+RegexMatcher::build_follow_blocks()
+{
+  // entry (b, v) holds the followers of the positions set in byte b of the
+  // state when that byte is v
+  unsigned int num_blocks = (num_positions + 7) / 8;
+  follow_blocks.assign(num_blocks * 256, 0);
+  for (unsigned int b = 0; b < num_blocks; b++) {
+    for (unsigned int v = 1; v < 256; v++) {
+      unsigned int low = __builtin_ctz(v);
+      follow_blocks[b * 256 + v] = follow_blocks[b * 256 + (v & (v - 1))];
+      if (b * 8 + low < num_positions) {
+        follow_blocks[b * 256 + v] |= follow[b * 8 + low];
+      }
+    }
+  }
+}
+
+void
+RegexMatcher::build_unicode_masks()
+{
+  // every interval boundary above ASCII starts a new run
+  unicode_starts.assign(1, 128);
+  vector <vector <CharInterval> >::iterator it;
+  for (it = position_chars.begin(); it != position_chars.end(); it++) {
+    vector <CharInterval>::iterator interval;
+    for (interval = it->begin(); interval != it->end(); interval++) {
+      if (interval->last < 128) continue;
+      unicode_starts.push_back(max(interval->first, (CodePoint) 128));
+      if (interval->last < MAX_CODE_POINT) unicode_starts.push_back(interval->last + 1);
+    }
+  }
+  sort(unicode_starts.begin(), unicode_starts.end());
+  unicode_starts.erase(unique(unicode_starts.begin(), unicode_starts.end()),
+      unicode_starts.end());
+
+  // a run's characters are accepted by the same positions as its start
+  unicode_masks.assign(unicode_starts.size() * num_words, 0);
+  for (unsigned int run = 0; run < unicode_starts.size(); run++) {
+    for (unsigned int p = 0; p < num_positions; p++) {
+      if (in_intervals(position_chars[p], unicode_starts[run])) {
+        unicode_masks[run * num_words + p / WORD_BITS] |= 1ULL << (p % WORD_BITS);
+      }
+    }
+  }
+}
+
+bool
+RegexMatcher::match_single(const string &s) const
+{
+  unsigned int length = s.length();
+  Word reach = first[0];
+  Word matched = 0;
+  bool has_anchors = (carets[0] | dollars[0]) != 0;
+
+  unsigned int idx = 0;
+  while (true) {
+
+    // cross the anchors that hold here (an anchor can lead to another)
+    if (has_anchors && (idx == 0 || idx + 1 >= length)) {
+      Word holding = anchor_mask(s, idx, 0);
+      Word crossed = 0;
+      Word found = reach & holding;
+      while ((found & ~crossed) != 0) {
+        Word fresh = found & ~crossed;
+        crossed |= fresh;
+        reach |= single_follow(fresh);
+        found = reach & holding;
+      }
+      matched |= crossed;
+    }
+
+    if (idx >= length) break;
+    if (reach == 0) return false;
+
+    unsigned char b = s[idx];
+    if (b < 128) {
+      matched = reach & ascii_masks[b];
+      idx++;
+    }
+    else {
+      matched = reach & unicode_mask(decode_utf8(s, idx), 0);
+    }
+    reach = single_follow(matched);
+  }
+
+  return (matched & last[0]) != 0 || (length == 0 && nullable);
+}
+
+bool
+RegexMatcher::match_general(const string &s) const
+{
+  unsigned int length = s.length();
+  vector <Word> reach = first;
+  vector <Word> matched(num_words, 0);
+  vector <Word> crossed(num_words);
+  vector <Word> fresh(num_words);
+  vector <Word> next(num_words);
+
+  unsigned int idx = 0;
+  while (true) {
+
+    // cross the anchors that hold here (an anchor can lead to another)
+    if (idx == 0 || idx + 1 >= length) {
+      crossed.assign(num_words, 0);
+      while (true) {
+        bool found = false;
+        for (unsigned int w = 0; w < num_words; w++) {
+          fresh[w] = reach[w] & anchor_mask(s, idx, w) & ~crossed[w];
+          if (fresh[w] != 0) found = true;
+          crossed[w] |= fresh[w];
+        }
+        if (!found) break;
+        general_follow(fresh, next);
+        for (unsigned int w = 0; w < num_words; w++) {
+          reach[w] |= next[w];
+        }
+      }
+      for (unsigned int w = 0; w < num_words; w++) {
+        matched[w] |= crossed[w];
+      }
+    }
+
+    if (idx >= length) break;
+
+    unsigned char b = s[idx];
+    bool alive = false;
+    if (b < 128) {
+      for (unsigned int w = 0; w < num_words; w++) {
+        matched[w] = reach[w] & ascii_masks[b * num_words + w];
+        if (matched[w] != 0) alive = true;
+      }
+      idx++;
+    }
+    else {
+      CodePoint c = decode_utf8(s, idx);
+      for (unsigned int w = 0; w < num_words; w++) {
+        matched[w] = reach[w] & unicode_mask(c, w);
+        if (matched[w] != 0) alive = true;
+      }
+    }
+    if (!alive) return false;
+    general_follow(matched, reach);
+  }
+
+  for (unsigned int w = 0; w < num_words; w++) {
+    if ((matched[w] & last[w]) != 0) return true;
+  }
+  return length == 0 && nullable;
+}
+
+RegexMatcher::Word
+RegexMatcher::single_follow(Word matched) const
+{
+  Word reach = 0;
+  const Word *block = &follow_blocks[0];
+  while (matched != 0) {
+    reach |= block[matched & 0xFF];
+    matched >>= 8;
+    block += 256;
+  }
+  return reach;
+}
+
+void
+RegexMatcher::general_follow(const vector <Word> &matched, vector <Word> &reach) const
+{
+  reach.assign(num_words, 0);
+  for (unsigned int w = 0; w < num_words; w++) {
+    Word bits = matched[w];
+    while (bits != 0) {
+      unsigned int p = w * WORD_BITS + __builtin_ctzll(bits);
+      bits &= bits - 1;
+      const Word *row = &follow[p * num_words];
+      for (unsigned int k = 0; k < num_words; k++) {
+        reach[k] |= row[k];
+      }
+    }
+  }
+}
+
+RegexMatcher::Word
+RegexMatcher::anchor_mask(const string &s, unsigned int idx, unsigned int w) const
+{
+  // ^ holds at the start, $ at the end or before a newline that ends the string
+  unsigned int length = s.length();
+  Word mask = 0;
+  if (idx == 0) mask |= carets[w];
+  if (idx == length || (idx + 1 == length && s[idx] == '\n')) mask |= dollars[w];
+  return mask;
+}
+
+int
+RegexMatcher::add_capture_node(ParseNode *node)
+{
+  if (node == NULL) return -1;
+
+  CaptureNode capture_node;
+  capture_node.type = node->type;
+  capture_node.lower = 0;
+  capture_node.upper = 0;
+  capture_node.lazy = false;
+  capture_node.group = -1;
+  if (node->type == REPEAT_NODE) {
+    capture_node.lower = node->repeat_lower;
+    capture_node.upper = node->repeat_upper;
+    capture_node.lazy = node->lazy;
+  }
+  if (node->type == GROUP_NODE) capture_node.group = node->group;
+  if (node->type == CHARACTER_NODE) {
+    CharInterval interval = {node->character, node->character};
+    capture_node.chars.push_back(interval);
+  }
+  if (node->type == CHAR_SET_NODE) capture_node.chars = node->char_set->get_intervals();
+
+  // children are added first, so add the node once their indexes are known
+  capture_node.left = add_capture_node(node->left);
+  capture_node.right = add_capture_node(node->right);
+  capture_nodes.push_back(capture_node);
+  return capture_nodes.size() - 1;
+}
+
+// The search is continuation passing: each node is matched with what remains
+// after it, so a failure anywhere later backs up into the most recent choice.
+// Choices are made in Python's order (left alternative first, then as many
+// iterations as possible unless the repeat is lazy), so the first match found
+// is the one Python reports.
+bool
+RegexMatcher::capture(int node, unsigned int pos, const Continuation *next,
+    CaptureState &state) const
+{
+  if (state.gave_up) return false;
+  if (node == -1) return resume(next, pos, state);
+  if (++state.steps > MAX_CAPTURE_STEPS || state.depth >= MAX_CAPTURE_DEPTH) {
+    state.gave_up = true;
+    return false;
+  }
+
+  const CaptureNode &capture_node = capture_nodes[node];
+  const string &s = *state.s;
+  bool found = false;
+  state.depth++;
+
+  switch (capture_node.type) {
+  case ALTERNATION_NODE:
+    found = capture(capture_node.left, pos, next, state) ||
+      capture(capture_node.right, pos, next, state);
+    break;
+
+  case CONCAT_NODE:
+  {
+    Continuation right = {NEXT_CONTINUATION, capture_node.right, 0, pos, next};
+    found = capture(capture_node.left, pos, &right, state);
+    break;
+  }
+
+  case GROUP_NODE:
+  {
+    if (capture_node.group == -1) {
+      found = capture(capture_node.left, pos, next, state);
+      break;
+    }
+    Continuation close = {GROUP_CONTINUATION, node, 0, pos, next};
+    found = capture(capture_node.left, pos, &close, state);
+    break;
+  }
+
+  case REPEAT_NODE:
+    found = iterate(node, 0, (unsigned int) -1, pos, next, state);
+    break;
+
+  case CHARACTER_NODE:
+  case CHAR_SET_NODE:
+  {
+    if (pos >= s.length()) break;
+    unsigned int end = pos;
+    CodePoint c = decode_utf8(s, end);
+    if (in_intervals(capture_node.chars, c)) found = resume(next, end, state);
+    break;
+  }
+
+  // ^ holds at the start, $ at the end or before a newline that ends the string
+  case CARET_NODE:
+    if (pos == 0) found = resume(next, pos, state);
+    break;
+
+  case DOLLAR_NODE:
+    if (pos == s.length() || (pos + 1 == s.length() && s[pos] == '\n')) {
+      found = resume(next, pos, state);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  state.depth--;
+  return found;
+}
+
+bool
+RegexMatcher::resume(const Continuation *next, unsigned int pos, CaptureState &state) const
+{
+  if (state.gave_up) return false;
+  if (next == NULL) return pos == state.s->length();
+
+  switch (next->type) {
+  case NEXT_CONTINUATION:
+    return capture(next->node, pos, next->next, state);
+
+  case ITERATION_CONTINUATION:
+    return iterate(next->node, next->count, next->start, pos, next->next, state);
+
+  case GROUP_CONTINUATION:
+  {
+    // a group keeps its span from the last time it closed on the way to the match
+    int group = capture_nodes[next->node].group;
+    int saved_start = state.marks[2 * group];
+    int saved_end = state.marks[2 * group + 1];
+    state.marks[2 * group] = next->start;
+    state.marks[2 * group + 1] = pos;
+    if (resume(next->next, pos, state)) return true;
+    state.marks[2 * group] = saved_start;
+    state.marks[2 * group + 1] = saved_end;
+    return false;
+  }
+  }
+  return false;
+}
+
+bool
+RegexMatcher::iterate(int node, int count, unsigned int start, unsigned int pos,
+    const Continuation *next, CaptureState &state) const
+{
+  const CaptureNode &repeat = capture_nodes[node];
+
+  // required iterations are always made
+  if (count < repeat.lower) {
+    Continuation iteration = {ITERATION_CONTINUATION, node, count + 1, start, next};
+    return capture(repeat.left, pos, &iteration, state);
+  }
+
+  // like Python, an optional iteration is not made where the last one began
+  Continuation iteration = {ITERATION_CONTINUATION, node, count + 1, pos, next};
+  bool can_iterate = (repeat.upper == -1 || count < repeat.upper) && pos != start;
+  if (repeat.lazy) {
+    if (resume(next, pos, state)) return true;
+    return can_iterate && capture(repeat.left, pos, &iteration, state);
+  }
+  if (can_iterate && capture(repeat.left, pos, &iteration, state)) return true;
+  return resume(next, pos, state);
+}
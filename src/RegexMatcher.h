@@ -0,0 +1,220 @@
+/*  RegexMatcher.h: tests strings against a regex
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The matcher is a Glushkov automaton: every character, character set and
+// anchor in the parse tree (with bounded repeats expanded) is a position, and
+// the state while reading a string is the set of positions that may match
+// next, kept as bits in machine words.  Reading a character ANDs the state
+// with the character's mask and maps the matched positions to the positions
+// that follow them.  A regex with at most 64 positions keeps its state in a
+// single word and finds followers with one table lookup per byte of the
+// state; larger regexes use several words and walk the matched positions.
+// Anchors are zero-width positions that are crossed only where they hold.
+// Matching follows Python's re.fullmatch without flags.
+//
+// The automaton cannot tell which of several ways a string matches, so the
+// spans of capturing groups come from a backtracking search over the parse
+// tree that tries alternatives and repetitions in the order Python's re
+// does.  It is only run on strings the automaton accepts, and gives up after
+// a fixed number of steps.
+
+#ifndef REGEX_MATCHER_H
+#define REGEX_MATCHER_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "BinaryOutput.h"
+#include "ParseTree.h"
+#include "Unicode.h"
+using namespace std;
+
+class RegexMatcher {
+
+public:
+
+  RegexMatcher() {
+    supported = false; num_positions = 0; num_words = 0; nullable = false; capture_root = -1;
+  }
+
+  // builds the matcher for the regex in tree, returns false if the regex is
+  // too large or uses a feature that is ignored when generating strings
+  bool build(ParseTree &tree);
+
+  // returns true if build would succeed for the regex in tree
+  static bool can_build(ParseTree &tree);
+
+  // returns true if the matcher was built
+  bool is_supported() { return supported; }
+
+  // returns the number of positions in the automaton
+  unsigned int get_num_positions() { return num_positions; }
+
+  // returns true if the state fits in a single machine word
+  bool is_single_word() { return supported && num_words <= 1; }
+
+  // returns true if the regex matches all of s (s must be valid UTF-8)
+  bool matches(const string &s) const;
+
+  // returns the class of s (UNCLASSIFIED_STRING if the matcher is not built)
+  StringClass classify(const string &s) const;
+
+  // returns the names of the capturing groups in order ("" for an unnamed group)
+  const vector <string> &get_group_names() { return group_names; }
+
+  // sets spans to the start and end (in code points) of each capturing group
+  // in the match of s, or -1 for a group that did not take part, returns
+  // false if the search gives up (s must match)
+  bool find_groups(const string &s, vector <int> &spans) const;
+
+private:
+
+  typedef unsigned long long Word;
+
+  // first and last positions of a subexpression
+  struct Fragment {
+    bool nullable;		// true if the subexpression matches the empty string
+    vector <Word> first;	// positions that can start a match
+    vector <Word> last;		// positions that can end a match
+  };
+
+  bool supported;			// set once the matcher is built
+  unsigned int num_positions;		// positions in the automaton
+  unsigned int num_words;		// words in a set of positions
+  bool nullable;			// true if the regex matches the empty string
+  vector <Word> first;			// positions that can start a match
+  vector <Word> last;			// positions that can end a match
+  vector <Word> carets;			// positions that are ^ anchors
+  vector <Word> dollars;		// positions that are $ anchors
+  vector <Word> follow;			// positions after each position
+  vector <Word> follow_blocks;		// followers of each byte of a one word state
+  vector <Word> ascii_masks;		// positions that accept each ASCII character
+  vector <vector <CharInterval> > position_chars;	// characters of each position
+  vector <CodePoint> unicode_starts;	// starts of runs of non-ASCII characters
+  vector <Word> unicode_masks;		// positions that accept each run
+
+  typedef enum
+  {
+    NEXT_CONTINUATION,		// match node next
+    ITERATION_CONTINUATION,	// end an iteration of the repeat node
+    GROUP_CONTINUATION		// close the group node
+  } ContinuationType;
+
+  // parse tree node used by the capture search
+  struct CaptureNode {
+    NodeType type;
+    int left;			// child indexes (-1 if none)
+    int right;
+    int lower;			// repeat bounds (upper is -1 for no limit)
+    int upper;
+    bool lazy;			// true if the fewest repetitions are preferred
+    int group;			// capturing group index (-1 if not capturing)
+    vector <CharInterval> chars;	// characters of a character or set
+  };
+
+  // what remains to be matched after a node
+  struct Continuation {
+    ContinuationType type;
+    int node;			// node to match, repeat node or group node
+    int count;			// iterations completed (ITERATION_CONTINUATION)
+    unsigned int start;		// where the group or last optional iteration began
+    const Continuation *next;	// what remains after this (NULL for the end)
+  };
+
+  // state of one capture search
+  struct CaptureState {
+    const string *s;		// string being matched
+    vector <int> marks;		// start and end byte of each group (-1 if unset)
+    unsigned long steps;	// nodes tried so far
+    unsigned int depth;		// current recursion depth
+    bool gave_up;		// set when the search exceeds its limits
+  };
+
+  vector <CaptureNode> capture_nodes;	// nodes for the capture search
+  int capture_root;			// root capture node (-1 for an empty regex)
+  vector <string> group_names;		// names of the capturing groups
+
+  // counts the positions node expands to (stopping once there are too many),
+  // returns false if node cannot be matched
+  static bool count_positions(ParseNode *node, unsigned long &count);
+
+  // builds the fragment for node, adding its positions and follow sets
+  Fragment build_fragment(ParseNode *node);
+
+  // returns a fragment that only matches the empty string
+  Fragment empty_fragment();
+
+  // adds a position for chars (or an anchor) and returns its fragment
+  Fragment add_position(const vector <CharInterval> &chars, NodeType anchor);
+
+  // returns the concatenation of a and b
+  Fragment concat(const Fragment &a, const Fragment &b);
+
+  // makes every position in from followed by the positions in to
+  void add_follow(const vector <Word> &from, const vector <Word> &to);
+
+  // builds the lookup table used by single_follow
+  void build_follow_blocks();
+
+  // splits the non-ASCII characters into runs accepted by the same positions
+  void build_unicode_masks();
+
+  // matches with the state in one word
+  bool match_single(const string &s) const;
+
+  // matches with the state in num_words words
+  bool match_general(const string &s) const;
+
+  // returns the positions that follow the positions in matched
+  Word single_follow(Word matched) const;
+
+  // sets reach to the positions that follow the positions in matched
+  void general_follow(const vector <Word> &matched, vector <Word> &reach) const;
+
+  // returns the positions in word w that are anchors holding at byte idx of s
+  Word anchor_mask(const string &s, unsigned int idx, unsigned int w) const;
+
+  // adds the capture nodes for node and returns the index of its node
+  int add_capture_node(ParseNode *node);
+
+  // matches node at byte pos followed by next, returns true if the whole
+  // string matches
+  bool capture(int node, unsigned int pos, const Continuation *next,
+      CaptureState &state) const;
+
+  // matches what remains after a node that ended at byte pos
+  bool resume(const Continuation *next, unsigned int pos, CaptureState &state) const;
+
+  // continues the repeat node at byte pos after count iterations (the last
+  // optional iteration began at start)
+  bool iterate(int node, int count, unsigned int start, unsigned int pos,
+      const Continuation *next, CaptureState &state) const;
+
+  // returns the positions in word w that accept the non-ASCII character c
+  Word unicode_mask(CodePoint c, unsigned int w) const
+  {
+    unsigned int run = upper_bound(unicode_starts.begin(), unicode_starts.end(), c) -
+      unicode_starts.begin() - 1;
+    return unicode_masks[run * num_words + w];
+  }
+};
+
+#endif // REGEX_MATCHER_H
@@ -0,0 +1,393 @@
+/*  RegexSampler.cpp: draws random strings that match a regex
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "CharSet.h"
+#include "Edge.h"
+#include "NFA.h"
+#include "RegexLoop.h"
+#include "RegexSampler.h"
+#include "RegexString.h"
+using namespace std;
+
+static vector <CharInterval> set_members(CharSet *char_set);
+static CodePoint count_members(const vector <CharInterval> &members);
+
+void
+RegexSampler::build(NFA &nfa, unsigned int _min_length, unsigned int _max_length,
+    unsigned int _loop_cap)
+{
+  min_length = _min_length;
+  max_length = _max_length;
+  loop_cap = _loop_cap;
+  initial = nfa.get_initial();
+  final = nfa.get_final();
+
+  unsigned int size = nfa.get_size();
+  out_edges.assign(size, vector <SampleEdge>());
+  loops.clear();
+  tables.assign(size, Table());
+  done.assign(size, vector <bool>());
+
+  // a loop's begin edge enters the loop body and its end edge leaves it
+  map <RegexLoop *, unsigned int> body_finals;
+  map <RegexLoop *, unsigned int> loop_ends;
+  vector <Transition>::const_iterator it;
+  for (unsigned int from = 0; from < size; from++) {
+    const vector <Transition> &edges = nfa.get_transitions(from);
+    for (it = edges.begin(); it != edges.end(); it++) {
+      if (it->edge->getType() == END_LOOP_EDGE) {
+        body_finals[it->edge->get_regex_loop()] = from;
+        loop_ends[it->edge->get_regex_loop()] = it->to;
+      }
+    }
+  }
+
+  for (unsigned int from = 0; from < size; from++) {
+    const vector <Transition> &edges = nfa.get_transitions(from);
+    for (it = edges.begin(); it != edges.end(); it++) {
+      Edge *nfa_edge = it->edge;
+      if (nfa_edge->getType() == END_LOOP_EDGE) continue;
+
+      SampleEdge edge;
+      edge.to = it->to;
+      edge.type = nfa_edge->getType();
+      edge.lower = 0;
+      edge.upper = 0;
+      edge.loop = -1;
+      edge.member_count = 0;
+      edge.weight.assign(max_length + 1, 0);
+
+      switch (edge.type) {
+      case CHARACTER_EDGE:
+        edge.text = encode_utf8(nfa_edge->get_character());
+        if (max_length >= 1) edge.weight[1] = 1;
+        break;
+
+      case LITERAL_EDGE:
+        edge.text = nfa_edge->get_literal();
+        if (utf8_length(edge.text) <= max_length) edge.weight[utf8_length(edge.text)] = 1;
+        break;
+
+      case CHAR_SET_EDGE:
+        edge.members = set_members(nfa_edge->get_char_set());
+        edge.member_count = count_members(edge.members);
+        if (max_length >= 1) edge.weight[1] = edge.member_count;
+        break;
+
+      case STRING_EDGE:
+      {
+        RegexString *regex_str = nfa_edge->get_regex_string();
+        edge.members = set_members(regex_str->get_char_set());
+        edge.member_count = count_members(edge.members);
+        edge.lower = regex_str->get_lower();
+        edge.upper = regex_str->get_upper();
+        if (edge.upper == -1) edge.upper = max(edge.lower, (int) loop_cap);
+        long double ways = 1;
+        for (int k = 0; k <= edge.upper && k <= (int) max_length; k++) {
+          if (k >= edge.lower) edge.weight[k] = ways;
+          ways *= edge.member_count;
+        }
+        break;
+      }
+
+      case BEGIN_LOOP_EDGE:
+      {
+        RegexLoop *regex_loop = nfa_edge->get_regex_loop();
+        SampleLoop loop;
+        loop.body_initial = it->to;
+        loop.body_final = body_finals[regex_loop];
+        loop.lower = regex_loop->get_lower();
+        loop.upper = regex_loop->get_upper();
+        if (loop.upper == -1) loop.upper = max(loop.lower, (int) loop_cap);
+        edge.to = loop_ends[regex_loop];
+        edge.loop = loops.size();
+        loops.push_back(loop);
+        break;
+      }
+
+      // anchors and epsilons do not add characters
+      default:
+        edge.weight[0] = 1;
+        break;
+      }
+
+      out_edges[from].push_back(edge);
+    }
+  }
+
+  // loop weights are only known once their bodies are counted
+  count(final, initial);
+  for (unsigned int from = 0; from < size; from++) {
+    vector <SampleEdge>::iterator it;
+    for (it = out_edges[from].begin(); it != out_edges[from].end(); it++) {
+      for (unsigned int j = 0; j <= max_length; j++) {
+        if (it->weight[j] != 0) it->used.push_back(j);
+      }
+    }
+  }
+
+  // count the strings of each allowed length
+  lengths.clear();
+  total = 0;
+  for (unsigned int length = min_length; length <= max_length; length++) {
+    total += tables[final][initial][length];
+    lengths.push_back(total);
+  }
+}
+
+bool
+RegexSampler::sample(mt19937_64 &rng, string &out)
+{
+  out.clear();
+  if (total <= 0) return false;
+
+  long double r = random(rng, total);
+  unsigned int i = 0;
+  while (i + 1 < lengths.size() && r >= lengths[i]) i++;
+
+  draw(rng, final, initial, min_length + i, out);
+  return true;
+}
+
+void
+RegexSampler::count(unsigned int target, unsigned int state)
+{
+  Table &table = tables[target];
+  if (table.empty()) {
+    table.assign(out_edges.size(), vector <long double>());
+    done[target].assign(out_edges.size(), false);
+  }
+  if (done[target][state]) return;
+
+  vector <long double> row(max_length + 1, 0);
+  if (state == target) {
+    row[0] = 1;
+  }
+  else {
+    vector <SampleEdge>::iterator it;
+    for (it = out_edges[state].begin(); it != out_edges[state].end(); it++) {
+      if (it->type == BEGIN_LOOP_EDGE) count_loop(*it);
+      count(target, it->to);
+
+      const vector <long double> &next = table[it->to];
+      for (unsigned int j = 0; j <= max_length; j++) {
+        if (it->weight[j] == 0) continue;
+        for (unsigned int length = j; length <= max_length; length++) {
+          row[length] += it->weight[j] * next[length - j];
+        }
+      }
+    }
+  }
+
+  table[state] = row;
+  done[target][state] = true;
+}
+
+void
+RegexSampler::count_loop(SampleEdge &edge)
+{
+  SampleLoop &loop = loops[edge.loop];
+  if (!loop.powers.empty()) return;
+
+  count(loop.body_final, loop.body_initial);
+  const vector <long double> &body = tables[loop.body_final][loop.body_initial];
+
+  // powers[k] is the k-fold convolution of the body counts
+  vector <long double> none(max_length + 1, 0);
+  loop.powers.assign(loop.upper + 1, none);
+  loop.powers[0][0] = 1;
+  for (int k = 1; k <= loop.upper; k++) {
+    for (unsigned int a = 0; a <= max_length; a++) {
+      if (body[a] == 0) continue;
+      for (unsigned int length = a; length <= max_length; length++) {
+        loop.powers[k][length] += body[a] * loop.powers[k - 1][length - a];
+      }
+    }
+  }
+
+  for (int k = loop.lower; k <= loop.upper; k++) {
+    for (unsigned int length = 0; length <= max_length; length++) {
+      edge.weight[length] += loop.powers[k][length];
+    }
+  }
+}
+
+void
+RegexSampler::draw(mt19937_64 &rng, unsigned int target, unsigned int state,
+    unsigned int length, string &out)
+{
+  const Table &table = tables[target];
+
+  while (state != target) {
+    long double r = random(rng, table[state][length]);
+
+    // pick an edge and the characters it makes in proportion to the number
+    // of ways left to finish (the last possible choice absorbs rounding)
+    const SampleEdge *chosen = NULL;
+    unsigned int chosen_length = 0;
+    vector <SampleEdge>::const_iterator it;
+    for (it = out_edges[state].begin(); it != out_edges[state].end(); it++) {
+      vector <unsigned int>::const_iterator j;
+      for (j = it->used.begin(); j != it->used.end() && *j <= length; j++) {
+        long double ways = it->weight[*j] * table[it->to][length - *j];
+        if (ways == 0) continue;
+        chosen = &(*it);
+        chosen_length = *j;
+        if (r < ways) goto found;
+        r -= ways;
+      }
+    }
+  found:
+
+    draw_edge(rng, *chosen, chosen_length, out);
+    state = chosen->to;
+    length -= chosen_length;
+  }
+}
+
+void
+RegexSampler::draw_edge(mt19937_64 &rng, const SampleEdge &edge, unsigned int length,
+    string &out)
+{
+  switch (edge.type) {
+  case CHARACTER_EDGE:
+  case LITERAL_EDGE:
+    out += edge.text;
+    break;
+
+  case CHAR_SET_EDGE:
+  case STRING_EDGE:
+    for (unsigned int i = 0; i < length; i++) {
+      draw_member(rng, edge, out);
+    }
+    break;
+
+  case BEGIN_LOOP_EDGE:
+  {
+    const SampleLoop &loop = loops[edge.loop];
+    const vector <long double> &body = tables[loop.body_final][loop.body_initial];
+
+    // pick the number of iterations, then the length of each iteration
+    long double r = random(rng, edge.weight[length]);
+    int iterations = loop.lower;
+    for (int k = loop.lower; k <= loop.upper; k++) {
+      if (loop.powers[k][length] == 0) continue;
+      iterations = k;
+      if (r < loop.powers[k][length]) break;
+      r -= loop.powers[k][length];
+    }
+
+    for (int k = iterations; k >= 1; k--) {
+      r = random(rng, loop.powers[k][length]);
+      unsigned int iteration_length = 0;
+      for (unsigned int a = 0; a <= length; a++) {
+        long double ways = body[a] * loop.powers[k - 1][length - a];
+        if (ways == 0) continue;
+        iteration_length = a;
+        if (r < ways) break;
+        r -= ways;
+      }
+      draw(rng, loop.body_final, loop.body_initial, iteration_length, out);
+      length -= iteration_length;
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+long double
+RegexSampler::random(mt19937_64 &rng, long double limit)
+{
+  return uniform_real_distribution <long double>(0, limit)(rng);
+}
+
+void
+RegexSampler::draw_member(mt19937_64 &rng, const SampleEdge &edge, string &out)
+{
+  CodePoint k = uniform_int_distribution <CodePoint>(0, edge.member_count - 1)(rng);
+  vector <CharInterval>::const_iterator it;
+  for (it = edge.members.begin(); k > it->last - it->first; it++) {
+    k -= it->last - it->first + 1;
+  }
+  append_utf8(out, it->first + k);
+}
+
+// returns the printable ASCII characters in the character set, plus the
+// non-ASCII characters it lists
+static vector <CharInterval>
+set_members(CharSet *char_set)
+{
+  vector <CharInterval> members;
+  for (CodePoint c = 32; c < 127; c++) {
+    if (!char_set->contains(c)) continue;
+    if (!members.empty() && members.back().last + 1 == c) {
+      members.back().last = c;
+    }
+    else {
+      CharInterval interval = {c, c};
+      members.push_back(interval);
+    }
+  }
+
+  if (char_set->is_complement()) return members;
+
+  vector <CharInterval> listed = char_set->get_listed_intervals();
+  vector <CharInterval>::iterator it;
+  for (it = listed.begin(); it != listed.end(); it++) {
+    if (it->last < 160) continue;
+    CharInterval interval = {max(it->first, (CodePoint) 160), it->last};
+
+    // surrogates cannot be encoded
+    if (interval.first < 0xD800 && interval.last > 0xDFFF) {
+      CharInterval before = {interval.first, 0xD7FF};
+      members.push_back(before);
+      interval.first = 0xE000;
+    }
+    else if (interval.first < 0xD800 && interval.last >= 0xD800) {
+      interval.last = 0xD7FF;
+    }
+    else if (interval.first <= 0xDFFF && interval.last > 0xDFFF) {
+      interval.first = 0xE000;
+    }
+    members.push_back(interval);
+  }
+  return members;
+}
+
+// returns the number of characters in members
+static CodePoint
+count_members(const vector <CharInterval> &members)
+{
+  CodePoint count = 0;
+  vector <CharInterval>::const_iterator it;
+  for (it = members.begin(); it != members.end(); it++) {
+    count += it->last - it->first + 1;
+  }
+  return count;
+}
@@ -0,0 +1,120 @@
+/*  RegexSampler.h: draws random strings that match a regex
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The sampler counts, for every NFA state and remaining length, the number of
+// ways to reach the final state, then walks the NFA choosing each edge (and
+// each character, loop iteration count and iteration length) in proportion
+// to the number of completions it leaves.  Every derivation within the
+// length bounds is equally likely, so strings of an unambiguous regex are
+// drawn uniformly.  Unbounded repeats are capped at loop_cap iterations, and
+// anchors are treated as empty.  Lengths count characters, and character sets
+// draw from printable ASCII plus the non-ASCII characters they list.  Once
+// built, drawing a string allocates nothing beyond growing the caller's output
+// string.
+
+#ifndef REGEX_SAMPLER_H
+#define REGEX_SAMPLER_H
+
+#include <random>
+#include <string>
+#include <vector>
+#include "Edge.h"
+#include "NFA.h"
+#include "Unicode.h"
+using namespace std;
+
+class RegexSampler {
+
+public:
+
+  RegexSampler() { min_length = 0; max_length = 0; loop_cap = 0; total = 0; }
+
+  // precomputes the counts for nfa (strings of min_length to max_length
+  // characters, unbounded repeats limited to loop_cap iterations)
+  void build(NFA &nfa, unsigned int _min_length, unsigned int _max_length,
+      unsigned int _loop_cap);
+
+  // returns the number of derivations that can be drawn
+  long double get_count() { return total; }
+
+  // draws a random string into out, returns false if no string can be drawn
+  bool sample(mt19937_64 &rng, string &out);
+
+private:
+
+  typedef vector <vector <long double> > Table;	// count by state and length
+
+  struct SampleEdge {
+    unsigned int to;		// destination (end of the loop for a loop)
+    EdgeType type;		// type of the NFA edge
+    string text;		// character or literal
+    vector <CharInterval> members;	// characters of a set or string
+    CodePoint member_count;	// number of characters in members
+    int lower;			// repeat bounds (for strings)
+    int upper;
+    int loop;			// loop index (for BEGIN_LOOP_EDGE)
+    vector <long double> weight;	// ways to cross the edge by length
+    vector <unsigned int> used;		// lengths with a nonzero weight
+  };
+
+  struct SampleLoop {
+    unsigned int body_initial;	// first state inside the loop
+    unsigned int body_final;	// last state inside the loop
+    int lower;			// iteration bounds (upper is capped)
+    int upper;
+    Table powers;		// ways to make k iterations by length
+  };
+
+  unsigned int min_length;	// shortest string drawn
+  unsigned int max_length;	// longest string drawn
+  unsigned int initial;		// initial state
+  unsigned int final;		// final state
+  vector <vector <SampleEdge> > out_edges;	// edges leaving each state
+  vector <SampleLoop> loops;	// loops by index
+  vector <Table> tables;	// counts toward each target state (empty if unused)
+  vector <vector <bool> > done;	// set once a table row has been counted
+  unsigned int loop_cap;	// iterations allowed for unbounded repeats
+  vector <long double> lengths;	// cumulative counts of each string length
+  long double total;		// number of derivations
+
+  // counts the ways from state to target by length
+  void count(unsigned int target, unsigned int state);
+
+  // counts the ways to make the loop's iterations (setting the weight of edge,
+  // the loop's begin edge)
+  void count_loop(SampleEdge &edge);
+
+  // draws the edges from state to target making exactly length characters
+  void draw(mt19937_64 &rng, unsigned int target, unsigned int state,
+      unsigned int length, string &out);
+
+  // draws the characters for crossing edge with length characters
+  void draw_edge(mt19937_64 &rng, const SampleEdge &edge, unsigned int length,
+      string &out);
+
+  // returns a uniform random number in [0, limit)
+  static long double random(mt19937_64 &rng, long double limit);
+
+  // appends a random character from the edge's members to out
+  static void draw_member(mt19937_64 &rng, const SampleEdge &edge, string &out);
+};
+
+#endif // REGEX_SAMPLER_H
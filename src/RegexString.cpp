@@ -26,7 +26,28 @@
 using namespace std;
 
 set <string>
-RegexString::gen_evil_strings(string path_string, const set <char> &punct_marks)
+RegexString::gen_evil_strings(const string &path_string, const set <char> &punct_marks)
+{
+  set <string> evil_substrings = gen_evil_substrings(substring, punct_marks);
+
+  // generate the new full strings
+  unsigned int suffix_start = prefix_length + substring.length();
+  set <string> evil_strings;
+  set <string>::iterator it;
+  for (it = evil_substrings.begin(); it != evil_substrings.end(); it++) {
+    string new_string;
+    new_string.reserve(path_string.length() + it->length());
+    new_string.append(path_string, 0, prefix_length);
+    new_string += *it;
+    new_string.append(path_string, suffix_start, string::npos);
+    evil_strings.insert(new_string);
+  }
+
+  return evil_strings;
+}
+
+set <string>
+RegexString::gen_evil_substrings(const string &s, const set <char> &punct_marks)
 {
   set <string> evil_substrings;
 
@@ -35,12 +56,12 @@ RegexString::gen_evil_strings(string path_string, const set <char> &punct_marks)
   evil_substrings.insert("_");
   evil_substrings.insert("6");
   evil_substrings.insert(" ");
-  evil_substrings.insert(substring.substr(0, 1));
+  evil_substrings.insert(s.substr(0, 1));
 
   // insert strings with added digit, space, and underscore
-  unsigned int half = substring.length() / 2;
-  string first_half = substring.substr(0, half);
-  string second_half = substring.substr(half);
+  unsigned int half = s.length() / 2;
+  string first_half = s.substr(0, half);
+  string second_half = s.substr(half);
   evil_substrings.insert(first_half + "4" + second_half);
   evil_substrings.insert(first_half + " " + second_half);
   evil_substrings.insert(first_half + "_" + second_half);
@@ -48,18 +69,18 @@ RegexString::gen_evil_strings(string path_string, const set <char> &punct_marks)
   // insert all uppercase and all lowercase
   string all_upper;
   string all_lower;
-  for (unsigned int i = 0; i < substring.length(); i++) {
-    all_upper += toupper(substring[i]);
-    all_lower += tolower(substring[i]);
+  for (unsigned int i = 0; i < s.length(); i++) {
+    all_upper += toupper(s[i]);
+    all_lower += tolower(s[i]);
   }
   evil_substrings.insert(all_upper);
   evil_substrings.insert(all_lower);
 
   // insert mixed case where first character is lowercase and second character
   // is uppercase
-  string first = string(1, tolower(substring[0]));
-  string second = string(1, toupper(substring[1]));
-  string mixed = first + second + substring.substr(2);
+  string first = string(1, tolower(s[0]));
+  string second = string(1, toupper(s[1]));
+  string mixed = first + second + s.substr(2);
   evil_substrings.insert(mixed);
 
   if (char_set->allows_punctuation()) {
@@ -69,17 +90,25 @@ RegexString::gen_evil_strings(string path_string, const set <char> &punct_marks)
     }
   }
 
-  // generate the new full strings
-  string path_suffix = path_string.substr(path_prefix.length() + substring.length());
-  set <string> evil_strings;
-  set <string>::iterator it;
-  for (it = evil_substrings.begin(); it != evil_substrings.end(); it++) {
-    string new_string;
-    new_string = path_prefix + *it + path_suffix;
-    evil_strings.insert(new_string);
-  }
+  return evil_substrings;
+}
 
-  return evil_strings;
+string
+RegexString::get_partition(const string &evil_string, const string &path_string)
+{
+  // evil strings replace the substring after the prefix
+  unsigned int fixed_length = path_string.length() - substring.length();
+  if (evil_string.length() < fixed_length) return "";
+  string evil_substring = evil_string.substr(prefix_length,
+      evil_string.length() - fixed_length);
+
+  if (evil_substring == "") return "empty";
+  if (evil_substring.length() == 1)
+    return "char " + char_set->get_char_partition((unsigned char) evil_substring[0]);
+  if (evil_substring.length() == substring.length() + 1)
+    return "insert " +
+      char_set->get_char_partition((unsigned char) evil_substring[substring.length() / 2]);
+  return "case " + evil_substring;
 }
 
 void
@@ -35,23 +35,38 @@ public:
     char_set = c;
     repeat_lower = lower;
     repeat_upper = upper;
+    prefix_length = 0;
   }
+  ~RegexString() { delete char_set; }
 
-  void set_path_prefix(string p) { path_prefix = p; }
-  void set_substring(string s) { substring = s; }
-  string get_substring() { return substring; }
+  // the character set is owned by the regex string, so it is not copied
+  RegexString(const RegexString &other) = delete;
+  RegexString &operator= (const RegexString &other) = delete;
+
+  void set_prefix_length(unsigned int l) { prefix_length = l; }
+  void set_substring(const string &s) { substring = s; }
+  const string &get_substring() { return substring; }
+  CharSet *get_char_set() { return char_set; }
+  int get_lower() { return repeat_lower; }
+  int get_upper() { return repeat_upper; }
 
   // generate evil strings
-  set <string> gen_evil_strings(string path_string, const set <char> &punct_marks);
+  set <string> gen_evil_strings(const string &path_string, const set <char> &punct_marks);
+
+  // returns the substrings that replace substring s in the evil strings
+  set <string> gen_evil_substrings(const string &s, const set <char> &punct_marks);
+
+  // returns the input partition exercised by an evil string from gen_evil_strings
+  string get_partition(const string &evil_string, const string &path_string);
 
   // print the regex string
   void print();
 
 private:
-  CharSet *char_set;		// corresponding character set
+  CharSet *char_set;		// corresponding character set (owned)
   int repeat_lower;     	// lower bound for string
   int repeat_upper;     	// upper bound for string
-  string path_prefix;           // path string up to visiting this node
+  unsigned int prefix_length;   // length of path string up to visiting this node
   string substring;             // substring corresponding to this string
 };
 
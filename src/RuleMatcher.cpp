@@ -0,0 +1,464 @@
+/*  RuleMatcher.cpp: finds the rules of a ruleset that match a string
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "CharSet.h"
+#include "NFA.h"
+#include "ParseTree.h"
+#include "RuleMatcher.h"
+#include "Unicode.h"
+using namespace std;
+
+const unsigned long MAX_DFA_BYTES = 16 << 20;	// size at which the DFA is dropped
+
+void
+RuleMatcher::build(const vector <RuleItem> &trie, const vector <bool> &included)
+{
+  positions.clear();
+  first.clear();
+  nullable_rules.clear();
+
+  // a trie node is live if an included rule ends at it or below it (a
+  // node's children come after it)
+  vector <bool> live(trie.size(), false);
+  for (unsigned int node = trie.size(); node-- > 0; ) {
+    vector <unsigned int>::const_iterator it;
+    for (it = trie[node].rules.begin(); it != trie[node].rules.end(); it++) {
+      if (included[*it]) live[node] = true;
+    }
+    for (it = trie[node].children.begin(); it != trie[node].children.end(); it++) {
+      if (live[*it]) live[node] = true;
+    }
+  }
+  if (!trie.empty() && live[0]) add_trie_node(trie, live, included, 0, empty_fragment());
+
+  vector <Position>::iterator it;
+  for (it = positions.begin(); it != positions.end(); it++) {
+    sort(it->follow.begin(), it->follow.end());
+    it->follow.erase(unique(it->follow.begin(), it->follow.end()), it->follow.end());
+  }
+
+  reach_marks.assign(positions.size(), 0);
+  generation = 0;
+  clear_dfa();
+}
+
+void
+RuleMatcher::add_trie_node(const vector <RuleItem> &trie, const vector <bool> &live,
+    const vector <bool> &included, unsigned int node, const Fragment &prefix)
+{
+  // a rule ending here matches where its items (the prefix) do
+  vector <unsigned int>::const_iterator it;
+  for (it = trie[node].rules.begin(); it != trie[node].rules.end(); it++) {
+    if (!included[*it]) continue;
+    vector <unsigned int>::const_iterator p;
+    for (p = prefix.last.begin(); p != prefix.last.end(); p++) {
+      positions[*p].rules.push_back(*it);
+    }
+    if (prefix.nullable) nullable_rules.push_back(*it);
+  }
+
+  for (it = trie[node].children.begin(); it != trie[node].children.end(); it++) {
+    if (!live[*it]) continue;
+    Fragment item = build_fragment(trie[*it].item);
+    if (prefix.nullable) first.insert(first.end(), item.first.begin(), item.first.end());
+    add_trie_node(trie, live, included, *it, concat(prefix, item));
+  }
+}
+
+// the same construction as RegexMatcher::build_fragment
+RuleMatcher::Fragment
+RuleMatcher::build_fragment(ParseNode *node)
+{
+  if (node == NULL) return empty_fragment();
+
+  switch (node->type) {
+  case ALTERNATION_NODE:
+  {
+    Fragment left = build_fragment(node->left);
+    Fragment right = build_fragment(node->right);
+    left.nullable = left.nullable || right.nullable;
+    left.first.insert(left.first.end(), right.first.begin(), right.first.end());
+    left.last.insert(left.last.end(), right.last.begin(), right.last.end());
+    return left;
+  }
+
+  case CONCAT_NODE:
+  {
+    Fragment left = build_fragment(node->left);
+    Fragment right = build_fragment(node->right);
+    return concat(left, right);
+  }
+
+  case GROUP_NODE:
+    return build_fragment(node->left);
+
+  case REPEAT_NODE:
+  {
+    int lower = node->repeat_lower;
+    int upper = node->repeat_upper;
+
+    // x{m,} is m - 1 copies of x followed by x+ (or x* if m is 0)
+    Fragment result = empty_fragment();
+    for (int i = 0; i < lower; i++) {
+      Fragment copy = build_fragment(node->left);
+      if (upper == -1 && i == lower - 1) add_follow(copy.last, copy.first);
+      result = concat(result, copy);
+    }
+    if (upper == -1 && lower == 0) {
+      Fragment copy = build_fragment(node->left);
+      add_follow(copy.last, copy.first);
+      copy.nullable = true;
+      result = concat(result, copy);
+    }
+
+    // x{m,n} is m copies of x followed by (x(x(...)?)?)? with n - m copies
+    else if (upper > lower) {
+      Fragment optional = empty_fragment();
+      for (int i = lower; i < upper; i++) {
+        Fragment copy = build_fragment(node->left);
+        optional = concat(copy, optional);
+        optional.nullable = true;
+      }
+      result = concat(result, optional);
+    }
+    return result;
+  }
+
+  case CHARACTER_NODE:
+  case CHAR_SET_NODE:
+  case CARET_NODE:
+  case DOLLAR_NODE:
+    return add_position(node);
+
+  default:
+    return empty_fragment();
+  }
+}
+
+RuleMatcher::Fragment
+RuleMatcher::empty_fragment()
+{
+  Fragment fragment;
+  fragment.nullable = true;
+  return fragment;
+}
+
+RuleMatcher::Fragment
+RuleMatcher::add_position(ParseNode *node)
+{
+  Position position;
+  position.type = node->type;
+  position.ascii[0] = 0;
+  position.ascii[1] = 0;
+  position.character = 0;
+  position.char_set = NULL;
+  if (node->type == CHARACTER_NODE) {
+    position.character = node->character;
+    if (node->character < 128) position.ascii[node->character / 64] = 1ULL << (node->character % 64);
+  }
+  if (node->type == CHAR_SET_NODE) {
+    position.char_set = node->char_set;
+    const vector <CharInterval> &chars = node->char_set->get_intervals();
+    vector <CharInterval>::const_iterator it;
+    for (it = chars.begin(); it != chars.end() && it->first < 128; it++) {
+      for (CodePoint c = it->first; c <= it->last && c < 128; c++) {
+        position.ascii[c / 64] |= 1ULL << (c % 64);
+      }
+    }
+  }
+  positions.push_back(position);
+
+  Fragment fragment;
+  fragment.nullable = false;
+  fragment.first.push_back(positions.size() - 1);
+  fragment.last.push_back(positions.size() - 1);
+  return fragment;
+}
+
+RuleMatcher::Fragment
+RuleMatcher::concat(const Fragment &a, const Fragment &b)
+{
+  add_follow(a.last, b.first);
+
+  Fragment fragment;
+  fragment.nullable = a.nullable && b.nullable;
+  fragment.first = a.first;
+  fragment.last = b.last;
+  if (a.nullable) fragment.first.insert(fragment.first.end(), b.first.begin(), b.first.end());
+  if (b.nullable) fragment.last.insert(fragment.last.end(), a.last.begin(), a.last.end());
+  return fragment;
+}
+
+void
+RuleMatcher::add_follow(const vector <unsigned int> &from, const vector <unsigned int> &to)
+{
+  vector <unsigned int>::const_iterator it;
+  for (it = from.begin(); it != from.end(); it++) {
+    vector <unsigned int> &follow = positions[*it].follow;
+    follow.insert(follow.end(), to.begin(), to.end());
+  }
+}
+
+void
+RuleMatcher::find_rules(const string &s, vector <unsigned int> &rules)
+{
+  unsigned int length = s.length();
+  if (length < 2) {
+    next_generation();
+    vector <unsigned int>::iterator it;
+    for (it = first.begin(); it != first.end(); it++) {
+      add_reach(*it);
+    }
+    finish(s, 0, rules);
+    return;
+  }
+
+  // read up to the last character with the DFA
+  if (dfa_bytes > MAX_DFA_BYTES) clear_dfa();
+  unsigned int state = get_start_state(s);
+  unsigned int idx = 0;
+  while (idx + 1 < length && !dfa_states[state].reach.empty()) {
+    unsigned char b = s[idx];
+    if (b < 128) {
+      int next = dfa_states[state].next[b];
+      if (next == -1) {
+        next = dfa_step(state, b);
+        dfa_states[state].next[b] = next;
+      }
+      state = next;
+      idx++;
+      continue;
+    }
+
+    // a character that ends the string is left for the last step
+    unsigned int end = idx;
+    CodePoint c = decode_utf8(s, end);
+    if (end >= length) break;
+    state = dfa_step(state, c);
+    idx = end;
+  }
+  if (dfa_states[state].reach.empty()) {
+    rules.clear();
+    return;
+  }
+
+  // the rules for a last ASCII character are kept with the state
+  if (idx + 1 == length && (unsigned char) s[idx] < 128) {
+    unsigned int key = state * 128 + s[idx];
+    map <unsigned int, vector <unsigned int> >::iterator it = last_rules.find(key);
+    if (it != last_rules.end()) {
+      rules = it->second;
+      return;
+    }
+    load_state(state);
+    finish(s, idx, rules);
+    last_rules[key] = rules;
+    dfa_bytes += sizeof(vector <unsigned int>) + rules.size() * sizeof(unsigned int);
+    return;
+  }
+  load_state(state);
+  finish(s, idx, rules);
+}
+
+void
+RuleMatcher::finish(const string &s, unsigned int idx, vector <unsigned int> &rules)
+{
+  rules.clear();
+  unsigned int length = s.length();
+  while (true) {
+    if (idx == 0 || idx + 1 >= length) cross_anchors(s, idx);
+    if (idx >= length) break;
+    if (reach.empty()) return;
+
+    unsigned char b = s[idx];
+    CodePoint c = b;
+    if (b < 128) idx++;
+    else c = decode_utf8(s, idx);
+    last_reach.swap(reach);
+    step(last_reach, c);
+  }
+
+  vector <unsigned int>::iterator it;
+  for (it = matched.begin(); it != matched.end(); it++) {
+    rules.insert(rules.end(), positions[*it].rules.begin(), positions[*it].rules.end());
+  }
+  if (length == 0) rules.insert(rules.end(), nullable_rules.begin(), nullable_rules.end());
+  sort(rules.begin(), rules.end());
+  rules.erase(unique(rules.begin(), rules.end()), rules.end());
+}
+
+void
+RuleMatcher::cross_anchors(const string &s, unsigned int idx)
+{
+  // the positions an anchor leads to are added to the end of reach, so an
+  // anchor can lead to another
+  for (unsigned int i = 0; i < reach.size(); i++) {
+    unsigned int p = reach[i];
+    if (!anchor_holds(p, s, idx)) continue;
+    matched.push_back(p);
+    vector <unsigned int>::iterator it;
+    for (it = positions[p].follow.begin(); it != positions[p].follow.end(); it++) {
+      add_reach(*it);
+    }
+  }
+}
+
+void
+RuleMatcher::step(const vector <unsigned int> &from, CodePoint c)
+{
+  next_generation();
+  if (from.empty()) return;
+
+  // from has no repeats, so neither has matched
+  const Position *pos = &positions[0];
+  const unsigned int *list = &from[0];
+  unsigned int count = from.size();
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int p = list[i];
+    bool accepted;
+    if (c < 128) accepted = (pos[p].ascii[c / 64] >> (c % 64)) & 1;
+    else if (pos[p].char_set != NULL) accepted = pos[p].char_set->contains(c);
+    else accepted = (pos[p].type == CHARACTER_NODE && pos[p].character == c);
+    if (accepted) matched.push_back(p);
+  }
+
+  unsigned int *marks = &reach_marks[0];
+  for (unsigned int i = 0; i < matched.size(); i++) {
+    const vector <unsigned int> &follow = pos[matched[i]].follow;
+    if (follow.empty()) continue;
+    const unsigned int *next = &follow[0];
+    unsigned int num_next = follow.size();
+    for (unsigned int j = 0; j < num_next; j++) {
+      if (marks[next[j]] == generation) continue;
+      marks[next[j]] = generation;
+      reach.push_back(next[j]);
+    }
+  }
+}
+
+void
+RuleMatcher::load_state(unsigned int state)
+{
+  next_generation();
+  const vector <unsigned int> &state_reach = dfa_states[state].reach;
+  vector <unsigned int>::const_iterator it;
+  for (it = state_reach.begin(); it != state_reach.end(); it++) {
+    add_reach(*it);
+  }
+}
+
+unsigned int
+RuleMatcher::get_start_state(const string &s)
+{
+  // only ^ anchors hold at the start of a string of two or more bytes
+  if (start_state == -1) {
+    next_generation();
+    vector <unsigned int>::iterator it;
+    for (it = first.begin(); it != first.end(); it++) {
+      add_reach(*it);
+    }
+    cross_anchors(s, 0);
+    start_state = add_dfa_state();
+  }
+  return start_state;
+}
+
+unsigned int
+RuleMatcher::dfa_step(unsigned int state, CodePoint c)
+{
+  step(dfa_states[state].reach, c);
+  return add_dfa_state();
+}
+
+unsigned int
+RuleMatcher::add_dfa_state()
+{
+  // the hash does not depend on the order of reach, so the same positions
+  // reached in another order give the same state
+  unsigned long long hash = reach.size();
+  for (unsigned int i = 0; i < reach.size(); i++) {
+    unsigned long long h = (reach[i] + 1ULL) * 0x9E3779B97F4A7C15ULL;
+    hash += h ^ (h >> 32);
+  }
+  vector <unsigned int> &same_hash = dfa_ids[hash];
+  vector <unsigned int>::iterator it;
+  for (it = same_hash.begin(); it != same_hash.end(); it++) {
+    if (has_reach(*it)) return *it;
+  }
+
+  same_hash.push_back(dfa_states.size());
+  dfa_states.push_back(DfaState());
+  DfaState &state = dfa_states.back();
+  state.reach = reach;
+  fill(state.next, state.next + 128, -1);
+  dfa_bytes += sizeof(DfaState) + reach.size() * sizeof(unsigned int);
+  return dfa_states.size() - 1;
+}
+
+bool
+RuleMatcher::has_reach(unsigned int state)
+{
+  // reach has no repeats, so it has the state's positions if it has as many
+  // and each of them is marked
+  const vector <unsigned int> &state_reach = dfa_states[state].reach;
+  if (state_reach.size() != reach.size()) return false;
+  for (unsigned int i = 0; i < state_reach.size(); i++) {
+    if (reach_marks[state_reach[i]] != generation) return false;
+  }
+  return true;
+}
+
+void
+RuleMatcher::clear_dfa()
+{
+  dfa_states.clear();
+  dfa_ids.clear();
+  start_state = -1;
+  last_rules.clear();
+  dfa_bytes = 0;
+}
+
+void
+RuleMatcher::next_generation()
+{
+  // the marks are cleared when the generation wraps around
+  if (++generation == 0) {
+    reach_marks.assign(reach_marks.size(), 0);
+    generation = 1;
+  }
+  reach.clear();
+  matched.clear();
+}
+
+bool
+RuleMatcher::anchor_holds(unsigned int p, const string &s, unsigned int idx) const
+{
+  // ^ holds at the start, $ at the end or before a newline that ends the string
+  unsigned int length = s.length();
+  if (positions[p].type == CARET_NODE) return idx == 0;
+  if (positions[p].type == DOLLAR_NODE)
+    return idx == length || (idx + 1 == length && s[idx] == '\n');
+  return false;
+}
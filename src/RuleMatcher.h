@@ -0,0 +1,179 @@
+/*  RuleMatcher.h: finds the rules of a ruleset that match a string
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The rule matcher is one Glushkov automaton for all of the rules of a
+// ruleset, built the same way as a RegexMatcher's but over the ruleset's trie
+// of rule items, so rules that begin with the same items share their
+// positions.  Each position records the rules that may end with it, and a
+// string is read once to find every rule it matches.  A ruleset has far more
+// positions than fit in a few machine words, so sets of positions are kept
+// as lists.
+//
+// Anchors only hold at the first and last characters, so after the anchors
+// at the start are crossed, the positions reached before each of the other
+// characters are a state of a DFA, and the rules matched are fixed by the
+// state before the last character and that character.  The DFA's states,
+// their moves on ASCII characters and their rules for a last ASCII character
+// are added as strings need them (the strings of a ruleset share long
+// prefixes), and the DFA is dropped when it gets large.  Other strings are
+// read with the lists.
+
+#ifndef RULE_MATCHER_H
+#define RULE_MATCHER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "CharSet.h"
+#include "NFA.h"
+#include "ParseTree.h"
+#include "Unicode.h"
+using namespace std;
+
+class RuleMatcher {
+
+public:
+
+  RuleMatcher() { generation = 0; start_state = -1; dfa_bytes = 0; }
+
+  // builds the matcher for the rules of trie that are set in included (each
+  // of those must be supported by RegexMatcher)
+  void build(const vector <RuleItem> &trie, const vector <bool> &included);
+
+  // returns the number of positions in the automaton
+  unsigned int get_num_positions() { return positions.size(); }
+
+  // sets rules to the rules that match all of s in ascending order (s must
+  // be valid UTF-8)
+  void find_rules(const string &s, vector <unsigned int> &rules);
+
+private:
+
+  // first and last positions of a subexpression
+  struct Fragment {
+    bool nullable;			// true if the subexpression matches the empty string
+    vector <unsigned int> first;	// positions that can start a match
+    vector <unsigned int> last;		// positions that can end a match
+  };
+
+  struct Position {
+    NodeType type;			// CHARACTER_NODE, CHAR_SET_NODE or an anchor
+    unsigned long long ascii[2];	// ASCII characters accepted
+    CodePoint character;		// character (CHARACTER_NODE)
+    CharSet *char_set;			// characters accepted (CHAR_SET_NODE, owned by
+					// the rule's parse tree)
+    vector <unsigned int> follow;	// positions that follow it
+    vector <unsigned int> rules;	// rules that may end with it
+  };
+
+  // a state of the DFA
+  struct DfaState {
+    vector <unsigned int> reach;	// positions that may match next
+    int next[128];			// state after each ASCII character (-1 if not built)
+  };
+
+  vector <Position> positions;			// positions of the automaton
+  vector <unsigned int> first;			// positions that can start a match
+  vector <unsigned int> nullable_rules;		// rules that match the empty string
+
+  vector <DfaState> dfa_states;			// states of the DFA built so far
+  map <unsigned long long, vector <unsigned int> > dfa_ids;	// states by the hash of their reach
+  int start_state;				// state before the first character (or -1)
+  map <unsigned int, vector <unsigned int> > last_rules;	// by state * 128 + last
+								// character, the rules matched
+  unsigned long dfa_bytes;			// memory used by the DFA
+
+  // scratch space for find_rules (a position is in reach if its mark is the
+  // current generation)
+  vector <unsigned int> reach;			// positions that may match next
+  vector <unsigned int> matched;		// positions that matched the last character
+  vector <unsigned int> last_reach;		// reach before the last character
+  vector <unsigned int> reach_marks;
+  unsigned int generation;
+
+  // adds the positions of trie node and its children, given the fragment
+  // of the items before them
+  void add_trie_node(const vector <RuleItem> &trie, const vector <bool> &live,
+      const vector <bool> &included, unsigned int node, const Fragment &prefix);
+
+  // builds the fragment for node, adding its positions and follow sets
+  Fragment build_fragment(ParseNode *node);
+
+  // returns a fragment that only matches the empty string
+  Fragment empty_fragment();
+
+  // adds a position for a character, set or anchor node and returns its
+  // fragment
+  Fragment add_position(ParseNode *node);
+
+  // returns the concatenation of a and b
+  Fragment concat(const Fragment &a, const Fragment &b);
+
+  // makes every position in from followed by the positions in to
+  void add_follow(const vector <unsigned int> &from, const vector <unsigned int> &to);
+
+  // reads s from byte idx with the lists, starting from reach, and sets
+  // rules to the rules matched
+  void finish(const string &s, unsigned int idx, vector <unsigned int> &rules);
+
+  // adds the positions that the anchors in reach holding at byte idx of s
+  // lead to, and adds the anchors to matched
+  void cross_anchors(const string &s, unsigned int idx);
+
+  // sets matched to the positions in from that accept c and reach to the
+  // positions that follow them (from is not reach)
+  void step(const vector <unsigned int> &from, CodePoint c);
+
+  // starts new reach and matched lists
+  void next_generation();
+
+  // starts new lists with reach set to the reach of a DFA state
+  void load_state(unsigned int state);
+
+  // returns the DFA state before the first character of s (s has at least
+  // two bytes)
+  unsigned int get_start_state(const string &s);
+
+  // returns the DFA state after reading c in state
+  unsigned int dfa_step(unsigned int state, CodePoint c);
+
+  // returns the DFA state for reach (adding it if needed)
+  unsigned int add_dfa_state();
+
+  // returns true if state has the positions in reach
+  bool has_reach(unsigned int state);
+
+  // drops the DFA
+  void clear_dfa();
+
+  // adds p to reach if it is not already there
+  void add_reach(unsigned int p)
+  {
+    if (reach_marks[p] == generation) return;
+    reach_marks[p] = generation;
+    reach.push_back(p);
+  }
+
+  // returns true if the anchor at position p holds at byte idx of s
+  bool anchor_holds(unsigned int p, const string &s, unsigned int idx) const;
+};
+
+#endif // RULE_MATCHER_H
@@ -0,0 +1,406 @@
+/*  RuleSet.cpp: generates strings for many regexes with one combined NFA
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "CharSet.h"
+#include "EngineSession.h"
+#include "MemoryUsage.h"
+#include "RuleSet.h"
+#include "Scanner.h"
+#include "StringMutator.h"
+#include "TestGenerator.h"
+#include "Trace.h"
+#include "error.h"
+using namespace std;
+
+void
+RuleSet::build(const vector <string> &regexes)
+{
+  TraceSpan span("RuleSet::build");
+
+  // the session only numbers the subtrees, so equal items get equal ids
+  EngineSession session;
+  trie.assign(1, RuleItem());
+  trie[0].item = NULL;
+
+  rules.resize(regexes.size());
+  for (unsigned int i = 0; i < regexes.size(); i++) {
+    Rule &rule = rules[i];
+    rule.regex = regexes[i];
+    rule.valid = false;
+    rule.matchable = false;
+
+    clearWarnings();
+    try {
+      Scanner scanner;
+      scanner.init(rule.regex);
+      rule.tree.build(scanner);
+      rule.tree.number_subtrees(session);
+      rule.matchable = RegexMatcher::can_build(rule.tree);
+
+      const set <char> &marks = rule.tree.get_punct_marks();
+      punct_marks.insert(marks.begin(), marks.end());
+      rule.valid = true;
+      add_to_trie(i);
+    }
+    catch (EgretException const &e) {
+      rule.error = e.getError();
+    }
+    rule.warnings = getWarnings();
+  }
+  if (trie[0].children.empty() && trie[0].rules.empty()) return;
+
+  vector <Edge *> rule_edges(rules.size(), NULL);
+  nfa.build(trie, rule_edges);
+
+  // each rule's edge leads to a state of its own
+  map <Edge *, unsigned int> edge_rules;
+  for (unsigned int i = 0; i < rules.size(); i++) {
+    if (rule_edges[i] != NULL) edge_rules[rule_edges[i]] = i;
+  }
+  state_rules.assign(nfa.get_size(), -1);
+  for (unsigned int from = 0; from < nfa.get_size(); from++) {
+    const vector <Transition> &edges = nfa.get_transitions(from);
+    vector <Transition>::const_iterator it;
+    for (it = edges.begin(); it != edges.end(); it++) {
+      map <Edge *, unsigned int>::iterator rule_it = edge_rules.find(it->edge);
+      if (rule_it != edge_rules.end()) state_rules[it->to] = rule_it->second;
+    }
+  }
+}
+
+void
+RuleSet::add_to_trie(unsigned int rule)
+{
+  ParseNode *node = rules[rule].tree.get_root();
+  unsigned int trie_node = 0;
+
+  while (node != NULL) {
+    ParseNode *item = node;
+    node = NULL;
+    if (item->type == CONCAT_NODE) {
+      node = item->right;
+      item = item->left;
+    }
+    num_items++;
+
+    pair <unsigned int, int> key(trie_node, item->subtree_id);
+    map <pair <unsigned int, int>, unsigned int>::iterator it = children.find(key);
+    if (it != children.end()) {
+      trie_node = it->second;
+      continue;
+    }
+
+    RuleItem child;
+    child.item = item;
+    trie.push_back(child);
+    trie[trie_node].children.push_back(trie.size() - 1);
+    children[key] = trie.size() - 1;
+    trie_node = trie.size() - 1;
+  }
+
+  trie[trie_node].rules.push_back(rule);
+}
+
+void
+RuleSet::gen_test_strings(const string &base_substring, const EngineOptions &options)
+{
+  TraceSpan span("RuleSet::gen_test_strings");
+  if (nfa.get_size() == 0) return;
+
+  if (options.traversal == MIN_COVER_TRAVERSAL)
+    paths = nfa.find_min_cover_paths(path_trie);
+  else
+    paths = nfa.find_basis_paths(path_trie);
+
+  // the initial strings of every path are made (a path's edges are only
+  // processed by the first path through them), but only this shard's
+  // strings are kept
+  vector <AnchorChecker> anchors(rules.size());
+  vector <unsigned int> path_rules;
+  vector <unsigned int> rule_nodes;
+  for (unsigned int i = 0; i < paths.size(); i++) {
+    vector <unsigned int> path_nodes;
+    path_trie.get_path_nodes(paths[i].get_leaf(), path_nodes);
+    unsigned int rule_node = find_rule_node(path_nodes);
+    unsigned int rule = state_rules[path_trie.get_node(path_nodes[rule_node]).state];
+    path_rules.push_back(rule);
+    rule_nodes.push_back(rule_node);
+
+    clearWarnings();
+    string path_string = paths[i].gen_initial_string(base_substring);
+    if (options.in_shard(i)) add_string(path_string, rule);
+
+    vector <string> warnings;
+    anchors[rule].check_path(paths[i], path_string, warnings);
+    vector <string>::iterator it;
+    for (it = warnings.begin(); it != warnings.end(); it++) {
+      addWarning(*it);
+    }
+    add_rule_warnings(rule);
+    add_rule_points(i, path_nodes, rule_node, rule);
+  }
+
+  // the test characters of a set do not depend on the rule, so the
+  // punctuation marks of all of the rules are used
+  TestCharCache test_chars(punct_marks);
+  for (unsigned int i = 0; i < paths.size(); i++) {
+    if (!options.in_shard(i)) continue;
+    clearWarnings();
+    vector <unsigned int> evil_nodes = paths[i].get_evil_nodes();
+    vector <set <string> > node_strings;
+    set <string> evil_strings;
+    for (unsigned int j = 0; j < evil_nodes.size(); j++) {
+      node_strings.push_back(paths[i].gen_evil_strings(evil_nodes[j], test_chars));
+      evil_strings.insert(node_strings[j].begin(), node_strings[j].end());
+    }
+    add_strings(evil_strings, path_rules[i]);
+    splice_initial_string(i, rule_nodes[i], path_rules[i]);
+    splice_evil_strings(i, rule_nodes[i], path_rules[i], evil_nodes, node_strings);
+    for (unsigned int j = 0; j < node_strings.size(); j++) {
+      releaseMemoryUsage(STRING_MEMORY, getStringSetMemory(node_strings[j]));
+    }
+    add_rule_warnings(path_rules[i]);
+  }
+
+  if (options.mutations != 0) {
+    mutator = StringMutator(options.mutations, base_substring);
+    for (unsigned int i = 0; i < paths.size(); i++) {
+      if (!options.in_shard(i)) continue;
+      set <string> mutated_strings;
+      mutator.mutate(paths[i].get_path_string(), mutated_strings);
+      addMemoryUsage(STRING_MEMORY, getStringSetMemory(mutated_strings));
+      add_strings(mutated_strings, path_rules[i]);
+      releaseMemoryUsage(STRING_MEMORY, getStringSetMemory(mutated_strings));
+    }
+  }
+
+  // match every string against all of the rules at once
+  TraceSpan match_span("RuleSet::match");
+  vector <bool> included(rules.size());
+  for (unsigned int rule = 0; rule < rules.size(); rule++) {
+    included[rule] = can_match(rule);
+  }
+  matcher.build(trie, included);
+  matching_rules.assign(strings.size(), vector <unsigned int>());
+  for (unsigned int i = 0; i < strings.size(); i++) {
+    matcher.find_rules(strings[i], matching_rules[i]);
+  }
+}
+
+void
+RuleSet::add_rule_points(unsigned int path, const vector <unsigned int> &path_nodes,
+    unsigned int rule_node, unsigned int rule)
+{
+  if (state_points.empty()) state_points.resize(nfa.get_size());
+
+  for (unsigned int k = 1; k < rule_node; k++) {
+    PathNode &node = path_trie.get_node(path_nodes[k]);
+    map <unsigned int, RulePoint> &points = state_points[node.state];
+    if (points.find(rule) != points.end()) continue;
+    RulePoint point;
+    point.path = path;
+    point.length = node.string_length;
+    points[rule] = point;
+  }
+}
+
+// A path's initial string generates the prefix of each node first reached by
+// the path (see Path::gen_initial_string).  Another rule that reaches the
+// node's state (before its rule edge) by a different prefix gets this prefix
+// followed by the rest of its own path from the state, as a run of its own
+// regex would have a path taking these edges.  Each node is handled once, by
+// the path that generated its prefix.
+void
+RuleSet::splice_initial_string(unsigned int path, unsigned int rule_node, unsigned int rule)
+{
+  vector <unsigned int> path_nodes;
+  path_trie.get_path_nodes(paths[path].get_leaf(), path_nodes);
+  const string &path_string = paths[path].get_path_string();
+
+  for (unsigned int k = 1; k < rule_node; k++) {
+    PathNode &node = path_trie.get_node(path_nodes[k]);
+    if (node.string_path != (int) path) continue;
+    map <unsigned int, RulePoint> &points = state_points[node.state];
+    map <unsigned int, RulePoint>::iterator it;
+    for (it = points.begin(); it != points.end(); it++) {
+      if (it->first == rule) continue;
+      const string &other_string = paths[it->second.path].get_path_string();
+      if (path_string.compare(0, node.string_length, other_string, 0, it->second.length) == 0)
+        continue;
+      string spliced;
+      spliced.reserve(node.string_length + other_string.length() - it->second.length);
+      spliced.append(path_string, 0, node.string_length);
+      spliced.append(other_string, it->second.length, string::npos);
+      if (add_string(spliced, it->first)) num_spliced++;
+    }
+  }
+}
+
+// An evil string for the edge into a node changes the path string before the
+// node's state, so from any later state it reaches the rest is the path's.  A
+// rule that reaches such a state (before its rule edge) gets the evil string
+// with that rest replaced by the rest of its own path from the state.  The
+// last such state is used, so the spliced string keeps as much of the original
+// as the rules share.
+void
+RuleSet::splice_evil_strings(unsigned int path, unsigned int rule_node, unsigned int rule,
+    const vector <unsigned int> &evil_nodes, const vector <set <string> > &node_strings)
+{
+  if (evil_nodes.empty()) return;
+
+  vector <unsigned int> path_nodes;
+  path_trie.get_path_nodes(paths[path].get_leaf(), path_nodes);
+  vector <unsigned int> evil_indexes;
+  unsigned int first = rule_node;
+  for (unsigned int j = 0; j < evil_nodes.size(); j++) {
+    unsigned int index = find(path_nodes.begin(), path_nodes.end(), evil_nodes[j]) - path_nodes.begin();
+    evil_indexes.push_back(index);
+    if (index < first) first = index;
+  }
+
+  // the last state each other rule shares with the path (only states after
+  // the first evil node matter)
+  map <unsigned int, unsigned int> last_shared;
+  for (unsigned int k = rule_node; k-- > first; ) {
+    map <unsigned int, RulePoint> &points = state_points[path_trie.get_node(path_nodes[k]).state];
+    map <unsigned int, RulePoint>::iterator it;
+    for (it = points.begin(); it != points.end(); it++) {
+      if (it->first != rule) last_shared.insert(make_pair(it->first, k));
+    }
+  }
+
+  const string &path_string = paths[path].get_path_string();
+  map <unsigned int, unsigned int>::iterator it;
+  for (it = last_shared.begin(); it != last_shared.end(); it++) {
+    unsigned int k = it->second;
+    PathNode &node = path_trie.get_node(path_nodes[k]);
+    unsigned int rest = path_string.length() - node.string_length;
+    RulePoint &point = state_points[node.state][it->first];
+    const string &other_string = paths[point.path].get_path_string();
+
+    for (unsigned int j = 0; j < evil_nodes.size(); j++) {
+      if (evil_indexes[j] > k) continue;
+      set <string>::const_iterator si;
+      for (si = node_strings[j].begin(); si != node_strings[j].end(); si++) {
+        if (si->length() < rest ||
+            si->compare(si->length() - rest, rest, path_string, node.string_length, rest) != 0)
+          continue;
+        string spliced;
+        spliced.reserve(si->length() - rest + other_string.length() - point.length);
+        spliced.append(*si, 0, si->length() - rest);
+        spliced.append(other_string, point.length, string::npos);
+        if (add_string(spliced, it->first)) num_spliced++;
+      }
+    }
+  }
+}
+
+string
+RuleSet::get_status(unsigned int rule)
+{
+  if (!rules[rule].valid) return rules[rule].error;
+  if (rules[rule].warnings == "") return "SUCCESS";
+  return rules[rule].warnings;
+}
+
+unsigned int
+RuleSet::find_rule_node(const vector <unsigned int> &path_nodes)
+{
+  for (unsigned int k = path_nodes.size(); k-- > 0; ) {
+    if (state_rules[path_trie.get_node(path_nodes[k]).state] != -1) return k;
+  }
+  throw EgretException("ERROR (internal): Path does not end a rule");
+}
+
+bool
+RuleSet::add_string(const string &s, unsigned int rule)
+{
+  unsigned int index;
+  map <string, unsigned int>::iterator it = string_indexes.find(s);
+  if (it != string_indexes.end()) {
+    index = it->second;
+  }
+  else {
+    index = strings.size();
+    string_indexes[s] = index;
+    strings.push_back(s);
+    addMemoryUsage(STRING_MEMORY, getStringMemory(s));
+  }
+
+  if (!rules[rule].string_set.insert(index).second) return false;
+  rules[rule].strings.push_back(index);
+  return true;
+}
+
+void
+RuleSet::add_strings(const set <string> &strs, unsigned int rule)
+{
+  set <string>::const_iterator it;
+  for (it = strs.begin(); it != strs.end(); it++)
+    add_string(*it, rule);
+}
+
+void
+RuleSet::add_rule_warnings(unsigned int rule)
+{
+  rules[rule].warnings += getWarnings();
+}
+
+void
+RuleSet::add_stats(Stats &stats)
+{
+  long error_count = 0;
+  long unmatched_count = 0;
+  long match_count = 0;
+  long other_match_count = 0;
+
+  for (unsigned int rule = 0; rule < rules.size(); rule++) {
+    if (!rules[rule].valid) error_count++;
+    else if (!can_match(rule)) unmatched_count++;
+  }
+  for (unsigned int i = 0; i < matching_rules.size(); i++) {
+    vector <unsigned int>::iterator it;
+    for (it = matching_rules[i].begin(); it != matching_rules[i].end(); it++) {
+      match_count++;
+      if (rules[*it].string_set.count(i) == 0) other_match_count++;
+    }
+  }
+
+  stats.add("RULESET", "Rules", rules.size());
+  stats.add("RULESET", "Rules with errors", error_count);
+  stats.add("RULESET", "Rules not matched natively", unmatched_count);
+  stats.add("RULESET", "Rule items", num_items);
+  stats.add("RULESET", "Rule items after sharing", trie.size() - 1);
+  stats.add("RULESET", "Rule matcher positions", matcher.get_num_positions());
+  stats.add("RULESET", "Rule matches", match_count);
+  stats.add("RULESET", "Matches of other rules", other_match_count);
+  stats.add("RULESET", "Strings spliced from shared items", num_spliced);
+  nfa.add_stats(stats);
+  mutator.add_stats(stats);
+  stats.add("PATHS", "Paths", paths.size());
+  stats.add("PATHS", "Path nodes", path_trie.get_num_nodes());
+  stats.add("PATHS", "Strings", strings.size());
+}
@@ -0,0 +1,164 @@
+/*  RuleSet.h: generates strings for many regexes with one combined NFA
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A ruleset holds many regexes (rules) in one NFA.  Each rule is split into
+// the items of its top level concatenation and added to a trie, where items
+// are compared by their structure (the subtree ids an engine session gives
+// them), so rules that begin with the same items share those states.  Every
+// rule ends with its own epsilon edge into the final state, so a single
+// traversal finds the paths for all of the rules and the path's rule is the
+// one whose edge it takes.  An edge shared by several rules is processed by
+// the first path through it, so the part of the initial string it generates
+// and its evil strings are also spliced onto the paths of the other rules
+// that share it (see splice_initial_string and splice_evil_strings).  A rule
+// whose first items are shared then gets the strings for those items that a
+// run of its own regex would, each finished by the rest of one of its own
+// paths.  Each string is then read once
+// by a RuleMatcher for all of the rules, which reports the other rules it
+// exercises.
+
+#ifndef RULE_SET_H
+#define RULE_SET_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "EngineOptions.h"
+#include "NFA.h"
+#include "ParseTree.h"
+#include "Path.h"
+#include "RegexMatcher.h"
+#include "RuleMatcher.h"
+#include "Stats.h"
+#include "StringMutator.h"
+using namespace std;
+
+class RuleSet {
+
+public:
+
+  RuleSet() { num_items = 0; num_spliced = 0; }
+
+  // parses the rules and builds their combined NFA (a rule that cannot be
+  // parsed keeps its error as its status and is left out of the NFA)
+  void build(const vector <string> &regexes);
+
+  // generates the strings for every rule and finds the rules each string
+  // matches
+  void gen_test_strings(const string &base_substring, const EngineOptions &options);
+
+  // returns the number of rules
+  unsigned int get_num_rules() { return rules.size(); }
+
+  // returns the regex of a rule
+  const string &get_regex(unsigned int rule) { return rules[rule].regex; }
+
+  // returns SUCCESS, the warnings or the error for a rule
+  string get_status(unsigned int rule);
+
+  // returns true if the strings are matched against the rule (false if the
+  // rule has an error or cannot be matched natively)
+  bool can_match(unsigned int rule) { return rules[rule].matchable; }
+
+  // returns every string generated (each once)
+  const vector <string> &get_strings() { return strings; }
+
+  // returns the indexes of the strings generated for a rule
+  const vector <unsigned int> &get_rule_strings(unsigned int rule) {
+    return rules[rule].strings;
+  }
+
+  // returns the rules (of those that can be matched) that match a string
+  const vector <unsigned int> &get_matching_rules(unsigned int string_index) {
+    return matching_rules[string_index];
+  }
+
+  // add ruleset stats
+  void add_stats(Stats &stats);
+
+private:
+
+  struct Rule {
+    string regex;			// regular expression
+    bool valid;				// set if the rule was parsed
+    string error;			// error (if not valid)
+    string warnings;			// warnings for the rule
+    ParseTree tree;			// parse tree (if valid)
+    bool matchable;			// set if the rule is valid and RegexMatcher supports it
+    vector <unsigned int> strings;	// strings generated for the rule (in order)
+    set <unsigned int> string_set;	// the same strings, for lookups
+  };
+
+  // the first path of a rule through a state
+  struct RulePoint {
+    unsigned int path;			// index of the path
+    unsigned int length;		// length of its string at the state
+  };
+
+  vector <Rule> rules;				// rules in the order given
+  vector <RuleItem> trie;			// trie of rule items (node 0 is the root)
+  map <pair <unsigned int, int>, unsigned int> children;	// (node, subtree id) -> child
+  unsigned long num_items;			// items in the rules before sharing
+  set <char> punct_marks;			// punctuation marks of all of the rules
+  NFA nfa;					// combined NFA
+  vector <int> state_rules;			// rule ended by the edge into each state (or -1)
+  PathTrie path_trie;				// nodes of the paths
+  vector <Path> paths;				// paths through the NFA
+  vector <string> strings;			// generated strings
+  map <string, unsigned int> string_indexes;	// index of each string
+  vector <map <unsigned int, RulePoint> > state_points;	// by state, each rule reaching
+							// it before its rule edge
+  unsigned long num_spliced;			// strings spliced onto other rules
+  RuleMatcher matcher;				// matcher for the rules that can be matched
+  vector <vector <unsigned int> > matching_rules;	// rules that match each string
+  StringMutator mutator;			// applies options.mutations to path strings
+
+  // adds the items of a parsed rule to the trie
+  void add_to_trie(unsigned int rule);
+
+  // returns the index in path_nodes of the node reached by the path's rule edge
+  unsigned int find_rule_node(const vector <unsigned int> &path_nodes);
+
+  // records the states path reaches before its rule edge (for splicing)
+  void add_rule_points(unsigned int path, const vector <unsigned int> &path_nodes,
+      unsigned int rule_node, unsigned int rule);
+
+  // adds the prefixes generated by the initial string of path, each finished
+  // by another rule's path from the prefix's last state, to the other rules
+  void splice_initial_string(unsigned int path, unsigned int rule_node, unsigned int rule);
+
+  // adds the evil strings made for the evil nodes of path (node_strings holds
+  // each node's strings) to the other rules that share the nodes' edges
+  void splice_evil_strings(unsigned int path, unsigned int rule_node, unsigned int rule,
+      const vector <unsigned int> &evil_nodes, const vector <set <string> > &node_strings);
+
+  // adds a string generated for rule, returning false if rule already had it
+  bool add_string(const string &s, unsigned int rule);
+
+  // adds a set of strings generated for rule
+  void add_strings(const set <string> &strs, unsigned int rule);
+
+  // adds the warnings since the last clearWarnings to rule
+  void add_rule_warnings(unsigned int rule);
+};
+
+#endif // RULE_SET_H
@@ -27,15 +27,18 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include "MemoryUsage.h"
 #include "Scanner.h"
 #include "Stats.h"
+#include "Trace.h"
 #include "error.h"
 
 using namespace std;
 
 void
-Scanner::init(string in)
+Scanner::init(const string &in)
 {
+  TraceSpan span("Scanner::init");
   unsigned int idx = 0;
   bool in_set = false;	// set to true when in the middle of set [] 
   while (idx < in.length()) {
@@ -122,7 +125,7 @@ Scanner::init(string in)
 	// Everything else is a character - used for \(, \$, etc. 
 	default:
 	  token.type = CHARACTER;
-	  token.character = c;
+	  token.character = get_code_point(in, idx);
       }
       break;
     }
@@ -199,10 +202,11 @@ Scanner::init(string in)
         token.character = in[idx];
       }
       // check for lazy '*?' --> Kleene star
-      // (no distinction is made for lazy version)
+      // (only matching distinguishes the lazy version)
       else if (!in_set && (idx + 1) < in.length() && in[idx + 1] == '?') {
 	idx++; // skip over the '?'
 	token.type = STAR;
+	token.lazy = true;
       }
       // otherwise --> Kleene star
       else {
@@ -217,10 +221,11 @@ Scanner::init(string in)
         token.character = in[idx];
       }
       // check for lazy '+?' --> plus
-      // (no distinction is made for lazy version)
+      // (only matching distinguishes the lazy version)
       else if (!in_set && (idx + 1) < in.length() && in[idx + 1] == '?') {
 	idx++; // skip over the '?'
 	token.type = PLUS;
+	token.lazy = true;
       }
       // otherwise --> plus (1 or more repetition)
       else {
@@ -239,10 +244,11 @@ Scanner::init(string in)
         token.character = in[idx];
       }
       // check for lazy '??' --> optional operator
-      // (no distinction is made for lazy version)
+      // (only matching distinguishes the lazy version)
       else if (!in_set && (idx + 1) < in.length() && in[idx + 1] == '?') {
 	idx++; // skip over the second '?'
 	token.type = QUESTION;
+	token.lazy = true;
       }
       // otherwise --> optional operator (matches 0 or 1)
       else {
@@ -299,6 +305,7 @@ Scanner::init(string in)
         // check for lazy repeat - skip over the '?' if present
         if (token.type != CHARACTER && (idx + 1) < in.length() && in[idx + 1] == '?') {
 	  idx++;
+	  token.lazy = true;
         }
       }
       break;
@@ -313,18 +320,19 @@ Scanner::init(string in)
 
     default:
       token.type = CHARACTER;
-      token.character = in[idx];
+      token.character = get_code_point(in, idx);
     }
 
     tokens.push_back(token);
     idx++;
   }
+  addMemoryUsage(SCANNER_MEMORY, tokens.capacity() * sizeof(Token));
   
   index = 0;
 }
 
 char
-Scanner::get_next_char(string in, unsigned int &idx)
+Scanner::get_next_char(const string &in, unsigned int &idx)
 {
   idx++;
   if (idx >= in.length()) {
@@ -333,8 +341,27 @@ Scanner::get_next_char(string in, unsigned int &idx)
   return in[idx];
 }
 
+CodePoint
+Scanner::get_code_point(const string &in, unsigned int &idx)
+{
+  CodePoint c = decode_utf8(in, idx);
+  idx--;
+  if (c >= 128) check_code_point(c, "character");
+  return c;
+}
+
+void
+Scanner::check_code_point(CodePoint value, const string &kind)
+{
+  if (!is_valid_code_point(value)) {
+    stringstream s;
+    s << "ERROR: contains unsupported " << kind << " value " << value;
+    throw EgretException(s.str());
+  }
+}
+
 Token
-Scanner::process_octal(string in, unsigned int &idx, char first_digit)
+Scanner::process_octal(const string &in, unsigned int &idx, char first_digit)
 {
   bool only_one_digit = false;
   bool has_three_digits = false;
@@ -381,12 +408,13 @@ Scanner::process_octal(string in, unsigned int &idx, char first_digit)
     idx++;
   }
 
-  // check the validity of the octal value
-  if (octal_value < 32 || octal_value > 126) {
+  // check the validity of the octal value (Python stops at \377)
+  if (octal_value > 255) {
     stringstream s;
     s << "ERROR: contains unsupported octal value " << octal_value;
     throw EgretException(s.str());
   }
+  check_code_point(octal_value, "octal");
 
   // return the octal value
   Token token;
@@ -397,60 +425,35 @@ Scanner::process_octal(string in, unsigned int &idx, char first_digit)
 }
     
 Token
-Scanner::process_hex(string in, unsigned int &idx, int num_digits)
+Scanner::process_hex(const string &in, unsigned int &idx, int num_digits)
 {
-  // if number of digits is greater than 2, the extra (left) digits must be zero
-  // as no unicode (outside ascii) are supported.
-  for (int i = 2; i < num_digits; i++) {
+  // \x takes two digits, \u four and \U eight
+  CodePoint hex_value = 0;
+  for (int i = 0; i < num_digits; i++) {
     char d = get_next_char(in, idx);
-    if (d != '0') {
+    unsigned int digit;
+    if (d >= '0' && d <= '9') {
+      digit = d - '0';
+    }
+    else if (d >= 'A' && d <= 'F') {
+      digit = d - 'A' + 10;
+    }
+    else if (d >= 'a' && d <= 'f') {
+      digit = d - 'a' + 10;
+    }
+    else {
       stringstream s;
-      s << "ERROR: Unsupported " << num_digits << "-digit hex number";
+      s << "ERROR: Invalid hex digit " << d;
       throw EgretException(s.str());
     }
-  }
 
-  // get the new two characters which must be hex digits
-  char first_digit = get_next_char(in, idx);
-  char second_digit = get_next_char(in, idx);
-
-  // compute the hex value
-  int hex_value;
-  if (first_digit >= '0' && first_digit <= '9') {
-    hex_value = (first_digit - '0') * 16;
-  }
-  else if (first_digit >= 'A' && first_digit <= 'F') {
-    hex_value = (first_digit - 'A' + 10) * 16;
-  }
-  else if (first_digit >= 'a' && first_digit <= 'f') {
-    hex_value = (first_digit - 'a' + 10) * 16;
-  }
-  else {
-    stringstream s;
-    s << "ERROR: Invalid hex digit " << first_digit;
-    throw EgretException(s.str());
-  }
-  if (second_digit >= '0' && second_digit <= '9') {
-    hex_value += (second_digit - '0');
-  }
-  else if (second_digit >= 'A' && second_digit <= 'F') {
-    hex_value += (second_digit - 'A' + 10);
-  }
-  else if (second_digit >= 'a' && second_digit <= 'f') {
-    hex_value += (second_digit - 'a' + 10);
-  }
-  else {
-    stringstream s;
-    s << "ERROR: Invalid hex digit " << second_digit;
-    throw EgretException(s.str());
+    // stop before the value overflows (it is too large either way)
+    if (hex_value > MAX_CODE_POINT) continue;
+    hex_value = hex_value * 16 + digit;
   }
 
   // check the validity of the hex value
-  if (hex_value < 32 || hex_value > 126) {
-    stringstream s;
-    s << "ERROR: contains unsupported hex value " << hex_value;
-    throw EgretException(s.str());
-  }
+  check_code_point(hex_value, "hex");
 
   // return the hex value
   Token token;
@@ -461,7 +464,7 @@ Scanner::process_hex(string in, unsigned int &idx, int num_digits)
 }
 
 Token
-Scanner::process_extension(string in, unsigned int &idx)
+Scanner::process_extension(const string &in, unsigned int &idx)
 {
   Token token;
 
@@ -482,7 +485,9 @@ Scanner::process_extension(string in, unsigned int &idx)
     if (c != '<') {
       throw EgretException("ERROR: Improperly specified named group - expected < after (?P");
     }
+    c = get_next_char(in, idx);
     while (c != '>') {
+      token.name += c;
       c = get_next_char(in, idx);
     }
     token.type = NAMED_GROUP_EXT;
@@ -530,7 +535,7 @@ Scanner::process_extension(string in, unsigned int &idx)
 }
 
 Token
-Scanner::process_repeat(string in, unsigned int &idx)
+Scanner::process_repeat(const string &in, unsigned int &idx)
 {
   // Based on execution of Python, the repeat quantifier must have one of these forms:
   // {n}  	: matches exactly n times
@@ -693,7 +698,7 @@ Scanner::get_repeat_upper()
   return tokens[index].repeat_upper;
 }
 
-char
+CodePoint
 Scanner::get_character()
 {
   TokenType type = get_type();
@@ -752,8 +757,8 @@ Scanner::is_char_range()
     if (tokens[index].character > tokens[index+2].character) {
       stringstream s;
       s << "ERROR: Improperly formed range "
-        << tokens[index].character << "-"
-	<< tokens[index+2].character << endl;
+        << encode_utf8(tokens[index].character) << "-"
+	<< encode_utf8(tokens[index+2].character) << endl;
       throw EgretException(s.str());
     }
     return true;
@@ -783,7 +788,7 @@ Scanner::print()
       cout << ":" << tokens[i].repeat_lower << "," << tokens[i].repeat_upper;
     }
     if (tokens[i].type == CHARACTER || tokens[i].type == CHAR_CLASS) {
-      cout << ":" << tokens[i].character;
+      cout << ":" << encode_utf8(tokens[i].character);
     }
     cout << endl;
   }
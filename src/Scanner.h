@@ -28,6 +28,7 @@
 #include <vector>
 #include <string>
 #include "Stats.h"
+#include "Unicode.h"
 using namespace std;
 
 // Types of tokens
@@ -56,10 +57,14 @@ typedef enum
 
 struct Token
 {
+  Token() { type = ERR; repeat_lower = 0; repeat_upper = 0; character = 0; lazy = false; }
+
   TokenType type;
   int repeat_lower;	// for REPEAT
   int repeat_upper;	// for REPEAT (-1 for no limit)
-  char character;	// for CHARACTER and CHAR_CLASS
+  CodePoint character;	// for CHARACTER and CHAR_CLASS
+  bool lazy;		// for STAR, PLUS, QUESTION and REPEAT (true for *?, +?, ?? and {}?)
+  string name;		// for NAMED_GROUP_EXT
 };
 
 // A scanner class, encapsulates the input stream as a set of tokens
@@ -68,7 +73,7 @@ class Scanner {
 
 public:
   // scans through input string and creates a vector of tokens
-  void init(string in);
+  void init(const string &in);
 
   // returns type for current token
   TokenType get_type();
@@ -83,7 +88,13 @@ public:
   int get_repeat_upper();
 
   // returns character associated with current token
-  char get_character();
+  CodePoint get_character();
+
+  // returns true if the current repetition token is lazy
+  bool is_lazy() { return tokens[index].lazy; }
+
+  // returns the group name of the current NAMED_GROUP_EXT token
+  string get_group_name() { return tokens[index].name; }
 
   // advance to the next token
   void advance();
@@ -106,19 +117,26 @@ private:
   unsigned index;		// iterator
 
   // get next character from input string
-  char get_next_char(string in, unsigned int &idx);
+  char get_next_char(const string &in, unsigned int &idx);
+
+  // get the (UTF-8 encoded) code point starting at in[idx], leaving idx on
+  // its last byte
+  CodePoint get_code_point(const string &in, unsigned int &idx);
+
+  // throws an exception if value cannot be used as a character
+  void check_code_point(CodePoint value, const string &kind);
 
   // process octal character 
-  Token process_octal(string in, unsigned int &idx, char first_digit);
+  Token process_octal(const string &in, unsigned int &idx, char first_digit);
 
   // process hexadecimal character 
-  Token process_hex(string in, unsigned int &idx, int num_digits);
+  Token process_hex(const string &in, unsigned int &idx, int num_digits);
 
   // processes Python extensions for regular expressions
-  Token process_extension(string in, unsigned int &idx);
+  Token process_extension(const string &in, unsigned int &idx);
 
   // process a repeat quantifier {}
-  Token process_repeat(string in, unsigned int &idx);
+  Token process_repeat(const string &in, unsigned int &idx);
 
   // returns string name of a token
   string token_type_to_str(TokenType type);
@@ -21,18 +21,30 @@
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <string>
 #include <vector>
 #include "Stats.h"
+#include "json.h"
 using namespace std;
 
 void
-Stats::add(string tag, string name, int value)
+Stats::add(string tag, string name, long value)
 {
   Stat stat = { tag, name, value };
   statList.push_back(stat);
 }
 
+long
+Stats::get(string name)
+{
+  vector <Stat>::iterator it;
+  for (it = statList.begin(); it != statList.end(); it++) {
+    if (it->name == name) return it->value;
+  }
+  return 0;
+}
+
 void
 Stats::print()
 {
@@ -53,3 +65,17 @@ Stats::print()
   }
 }
   
+
+string
+Stats::get_json()
+{
+  stringstream s;
+  s << "{";
+  vector <Stat>::iterator it;
+  for (it = statList.begin(); it != statList.end(); it++) {
+    if (it != statList.begin()) s << ",";
+    s << json_string(it->name) << ":" << it->value;
+  }
+  s << "}";
+  return s.str();
+}
@@ -22,6 +22,7 @@
 #ifndef STATS_H
 #define STATS_H
 
+#include <string>
 #include <vector>
 using namespace std;
 
@@ -30,17 +31,23 @@ class Stats
 
 public:
   // adds a stat to the list of stats
-  void add(string tag, string name, int value);
+  void add(string tag, string name, long value);
+
+  // returns the value of the named stat (0 if there is no such stat)
+  long get(string name);
 
   // print the stats
   void print();
 
+  // returns the stats as a JSON object
+  string get_json();
+
 private:
 
   struct Stat {
     string tag;
     string name;
-    int value;
+    long value;
   };
 
   vector <Stat> statList;
@@ -0,0 +1,179 @@
+/*  StringMutator.cpp: mutates path strings into additional test strings
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cctype>
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
+#include "Stats.h"
+#include "StringMutator.h"
+using namespace std;
+
+static void visit_double_punct(const string &s, unsigned int i, const MutationContext &context,
+    vector <StringEdit> &edits);
+static void visit_space_before_punct(const string &s, unsigned int i,
+    const MutationContext &context, vector <StringEdit> &edits);
+static void visit_space_after_punct(const string &s, unsigned int i,
+    const MutationContext &context, vector <StringEdit> &edits);
+static void visit_remove_space(const string &s, unsigned int i, const MutationContext &context,
+    vector <StringEdit> &edits);
+static void visit_replace_word(const string &s, unsigned int i, const MutationContext &context,
+    vector <StringEdit> &edits);
+static bool is_punct(char c);
+static bool is_word_char(char c);
+static StringEdit make_edit(unsigned int offset, unsigned int erase_length, const char *text,
+    unsigned int text_length);
+
+// operators in MutationType order
+static const MutationOperator OPERATORS[] = {
+  { DOUBLE_PUNCT_MUTATION, "double_punct", visit_double_punct },
+  { SPACE_BEFORE_PUNCT_MUTATION, "space_before_punct", visit_space_before_punct },
+  { SPACE_AFTER_PUNCT_MUTATION, "space_after_punct", visit_space_after_punct },
+  { REMOVE_SPACE_MUTATION, "remove_space", visit_remove_space },
+  { REPLACE_WORD_MUTATION, "replace_word", visit_replace_word }
+};
+
+static const char SPACE[] = " ";
+
+MutationType
+find_mutation(const string &name)
+{
+  for (unsigned int i = 0; i < NUM_MUTATIONS; i++) {
+    if (name == OPERATORS[i].name) return OPERATORS[i].type;
+  }
+  return NUM_MUTATIONS;
+}
+
+const char *
+get_mutation_name(MutationType type)
+{
+  return OPERATORS[type].name;
+}
+
+StringMutator::StringMutator(unsigned int mutations, string word)
+{
+  for (unsigned int i = 0; i < NUM_MUTATIONS; i++) {
+    if (mutations & (1 << i)) operators.push_back(&OPERATORS[i]);
+  }
+  context.word = word;
+  context.number = "123";
+  yields.assign(operators.size(), 0);
+  seconds.assign(operators.size(), 0);
+}
+
+void
+StringMutator::mutate(const string &s, set <string> &out)
+{
+  // each operator walks the whole string so it is timed once per string
+  for (unsigned int k = 0; k < operators.size(); k++) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < s.length(); i++) {
+      edits.clear();
+      operators[k]->visit(s, i, context, edits);
+
+      // build each edited string in the shared buffer
+      vector <StringEdit>::iterator it;
+      for (it = edits.begin(); it != edits.end(); it++) {
+        buffer.assign(s, 0, it->offset);
+        buffer.append(it->text, it->text_length);
+        buffer.append(s, it->offset + it->erase_length, string::npos);
+        if (buffer != s && out.insert(buffer).second) yields[k]++;
+      }
+    }
+
+    seconds[k] += chrono::duration <double>(chrono::steady_clock::now() - start).count();
+  }
+}
+
+void
+StringMutator::add_stats(Stats &stats)
+{
+  for (unsigned int k = 0; k < operators.size(); k++) {
+    string name = operators[k]->name;
+    stats.add("MUTATIONS", name + " strings", yields[k]);
+    stats.add("MUTATIONS", name + " time (us)", (long) (seconds[k] * 1000000));
+  }
+}
+
+static void
+visit_double_punct(const string &s, unsigned int i, const MutationContext &context,
+    vector <StringEdit> &edits)
+{
+  if (is_punct(s[i])) edits.push_back(make_edit(i, 0, &s[i], 1));
+}
+
+static void
+visit_space_before_punct(const string &s, unsigned int i, const MutationContext &context,
+    vector <StringEdit> &edits)
+{
+  if (is_punct(s[i])) edits.push_back(make_edit(i, 0, SPACE, 1));
+}
+
+static void
+visit_space_after_punct(const string &s, unsigned int i, const MutationContext &context,
+    vector <StringEdit> &edits)
+{
+  if (is_punct(s[i])) edits.push_back(make_edit(i + 1, 0, SPACE, 1));
+}
+
+static void
+visit_remove_space(const string &s, unsigned int i, const MutationContext &context,
+    vector <StringEdit> &edits)
+{
+  if (s[i] == ' ') edits.push_back(make_edit(i, 1, SPACE, 0));
+}
+
+// a run of word characters is replaced where it starts
+static void
+visit_replace_word(const string &s, unsigned int i, const MutationContext &context,
+    vector <StringEdit> &edits)
+{
+  if (!is_word_char(s[i]) || (i > 0 && is_word_char(s[i - 1]))) return;
+
+  unsigned int end = i;
+  while (end < s.length() && is_word_char(s[end])) end++;
+
+  edits.push_back(make_edit(i, end - i, context.word.data(), context.word.length()));
+  edits.push_back(make_edit(i, end - i, context.number.data(), context.number.length()));
+}
+
+// only ASCII characters are tested so the bytes of UTF-8 characters are skipped
+static bool
+is_punct(char c)
+{
+  return (unsigned char) c < 128 && ispunct(c);
+}
+
+static bool
+is_word_char(char c)
+{
+  return (unsigned char) c < 128 && (isalnum(c) || c == '_');
+}
+
+static StringEdit
+make_edit(unsigned int offset, unsigned int erase_length, const char *text,
+    unsigned int text_length)
+{
+  StringEdit edit = {offset, erase_length, text, text_length};
+  return edit;
+}
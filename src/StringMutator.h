@@ -0,0 +1,102 @@
+/*  StringMutator.h: mutates path strings into additional test strings
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A mutation operator looks at one character of a string at a time and
+// describes each mutation as an edit (bytes to erase at an offset and text to
+// insert there) instead of building a new string.  Each enabled operator
+// walks the string in turn, seeing every character, and each edited string
+// is built in one reused buffer.  To add an operator, add
+// its type below and its entry to the operator table in StringMutator.cpp.
+
+#ifndef STRING_MUTATOR_H
+#define STRING_MUTATOR_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include "Stats.h"
+using namespace std;
+
+typedef enum
+{
+  DOUBLE_PUNCT_MUTATION,	// doubles a punctuation mark
+  SPACE_BEFORE_PUNCT_MUTATION,	// adds a space before a punctuation mark
+  SPACE_AFTER_PUNCT_MUTATION,	// adds a space after a punctuation mark
+  REMOVE_SPACE_MUTATION,	// removes a space
+  REPLACE_WORD_MUTATION,	// replaces a run of word characters with a word or number
+  NUM_MUTATIONS
+} MutationType;
+
+// erase erase_length bytes at offset and insert text in their place
+struct StringEdit
+{
+  unsigned int offset;
+  unsigned int erase_length;
+  const char *text;
+  unsigned int text_length;
+};
+
+// values the operators insert
+struct MutationContext
+{
+  string word;		// replacement word (the base substring)
+  string number;	// replacement number
+};
+
+// an operator adds the edits for the character at index i of s to edits
+struct MutationOperator
+{
+  MutationType type;
+  const char *name;	// name used to enable the operator and in stats
+  void (*visit)(const string &s, unsigned int i, const MutationContext &context,
+      vector <StringEdit> &edits);
+};
+
+// returns the operator type with the given name, or NUM_MUTATIONS if none
+MutationType find_mutation(const string &name);
+
+// returns the name of the operator type
+const char *get_mutation_name(MutationType type);
+
+class StringMutator {
+
+public:
+
+  // mutations is a bit mask of the enabled MutationTypes
+  StringMutator(unsigned int mutations = 0, string word = "");
+
+  // adds the mutations of s (other than s itself) to out
+  void mutate(const string &s, set <string> &out);
+
+  // add per operator yield and timing stats
+  void add_stats(Stats &stats);
+
+private:
+
+  vector <const MutationOperator *> operators;	// enabled operators
+  MutationContext context;			// values the operators insert
+  vector <unsigned long> yields;		// strings added by each operator
+  vector <double> seconds;			// time spent in each operator
+  vector <StringEdit> edits;			// edits for the current character
+  string buffer;				// edited string being built
+};
+
+#endif // STRING_MUTATOR_H
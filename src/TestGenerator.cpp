@@ -26,108 +26,136 @@
 #include <set>
 #include <sstream>
 #include <vector>
+#include "MemoryUsage.h"
 #include "NFA.h"
 #include "TestGenerator.h"
 #include "Path.h"
+#include "RegexLoop.h"
+#include "RegexString.h"
+#include "Trace.h"
 #include "error.h"
 using namespace std;
 
 vector <string>
 TestGenerator::gen_test_strings()
 {
-  paths = nfa.find_basis_paths();
+  if (options.traversal == MIN_COVER_TRAVERSAL)
+    paths = nfa.find_min_cover_paths(trie);
+  else
+    paths = nfa.find_basis_paths(trie);
   gen_initial_strings();
   gen_evil_strings();
+  if (options.mutations != 0) gen_mutated_strings();
+  unminimized_count = test_strings.size();
+  if (options.minimize) minimize_test_strings();
   return test_strings;
 }
 
 void
 TestGenerator::gen_initial_strings()
 {
-  bool all_start_with_caret = false;
-  bool all_end_with_dollar = false;
-  bool warn_anchor_middle = false;
-  bool warn_caret_start = false;
-  bool warn_dollar_end = false;
+  TraceSpan span("TestGenerator::gen_initial_strings");
+  AnchorChecker anchors;
 
   vector <Path>::iterator path_iter;
-  string first_string = "";
   for (path_iter = paths.begin(); path_iter != paths.end(); path_iter++) {
 
-    // check for leading carets and trailing dollars
-    bool start_with_caret = path_iter->has_leading_caret();
-    bool end_with_dollar = path_iter->has_trailing_dollar();
-
     // go through each state in the path
+    // every path is processed so edges are processed by the same path as in
+    // an unsharded run, but only this shard's strings are kept
     string path_string = path_iter->gen_initial_string(base_substring);
-    add_to_test_strings(path_string);
+    if (options.in_shard(path_iter - paths.begin()))
+      add_to_test_strings(path_string);
 
-    // for first path, record whether the path starts with ^ and/or ends with $
-    if (first_string == "") {
-      all_start_with_caret = start_with_caret;
-      all_end_with_dollar = end_with_dollar;
-      first_string = path_string;
+    // the string for each path is the one expected to match, always keep it
+    if (options.minimize) {
+      stringstream feature;
+      feature << "path " << (path_iter - paths.begin());
+      coverage[path_string].insert(feature.str());
     }
 
-    // check for anchors in the middle
-    string anchor_err = path_iter->check_anchor_middle();
-	  
     // process anchor warnings
-    if (!warn_anchor_middle && anchor_err != "") {
-      addWarning(anchor_err);
-      warn_anchor_middle = true;
-    }
-    if (!warn_caret_start) {
-      if (all_start_with_caret && !start_with_caret) {
-        stringstream s;
-        s << "Some but not all strings start with a ^ anchor\n";
-        s << "...String with ^ anchor:    " << first_string << "\n";
-        s << "...String with no ^ anchor: " << path_string;
-        addWarning(s.str());
-        warn_caret_start = true;
-      }
-      if (!all_start_with_caret && start_with_caret) {
-        stringstream s;
-        s << "Some but not all strings start with a ^ anchor\n";
-        s << "...String with ^ anchor:    " << path_string << "\n";
-        s << "...String with no ^ anchor: " << first_string;
-        addWarning(s.str());
-        warn_caret_start = true;
-      }
+    vector <string> warnings;
+    anchors.check_path(*path_iter, path_string, warnings);
+    vector <string>::iterator it;
+    for (it = warnings.begin(); it != warnings.end(); it++) {
+      addWarning(*it);
     }
-    if (!warn_dollar_end) {
-      if (all_end_with_dollar && !end_with_dollar) {
-        stringstream s;
-        s << "Some but not all strings end with a $ anchor\n";
-        s << "...String with $ anchor:    " << first_string << "\n";
-        s << "...String with no $ anchor: " << path_string;
-        addWarning(s.str());
-        warn_dollar_end = true;
-      }
-      if (!all_end_with_dollar && end_with_dollar) {
-        stringstream s;
-        s << "Some but not all strings end with a $ anchor\n";
-        s << "...String with $ anchor:    " << path_string << "\n";
-        s << "...String with no $ anchor: " << first_string;
-        addWarning(s.str());
-        warn_dollar_end = true;
-      }
+  }
+}
+
+void
+AnchorChecker::check_path(Path &path, const string &path_string, vector <string> &warnings)
+{
+  // check for leading carets and trailing dollars
+  bool start_with_caret = path.has_leading_caret();
+  bool end_with_dollar = path.has_trailing_dollar();
+
+  // for first path, record whether the path starts with ^ and/or ends with $
+  if (first_string == "") {
+    all_start_with_caret = start_with_caret;
+    all_end_with_dollar = end_with_dollar;
+    first_string = path_string;
+  }
+
+  // check for anchors in the middle
+  string anchor_err = path.check_anchor_middle();
+
+  if (!warn_anchor_middle && anchor_err != "") {
+    warnings.push_back(anchor_err);
+    warn_anchor_middle = true;
+  }
+  if (!warn_caret_start) {
+    if (all_start_with_caret && !start_with_caret) {
+      stringstream s;
+      s << "Some but not all strings start with a ^ anchor\n";
+      s << "...String with ^ anchor:    " << first_string << "\n";
+      s << "...String with no ^ anchor: " << path_string;
+      warnings.push_back(s.str());
+      warn_caret_start = true;
+    }
+    if (!all_start_with_caret && start_with_caret) {
+      stringstream s;
+      s << "Some but not all strings start with a ^ anchor\n";
+      s << "...String with ^ anchor:    " << path_string << "\n";
+      s << "...String with no ^ anchor: " << first_string;
+      warnings.push_back(s.str());
+      warn_caret_start = true;
+    }
+  }
+  if (!warn_dollar_end) {
+    if (all_end_with_dollar && !end_with_dollar) {
+      stringstream s;
+      s << "Some but not all strings end with a $ anchor\n";
+      s << "...String with $ anchor:    " << first_string << "\n";
+      s << "...String with no $ anchor: " << path_string;
+      warnings.push_back(s.str());
+      warn_dollar_end = true;
+    }
+    if (!all_end_with_dollar && end_with_dollar) {
+      stringstream s;
+      s << "Some but not all strings end with a $ anchor\n";
+      s << "...String with $ anchor:    " << path_string << "\n";
+      s << "...String with no $ anchor: " << first_string;
+      warnings.push_back(s.str());
+      warn_dollar_end = true;
     }
   }
 }
 
 void
-TestGenerator::add_to_test_strings(string s)
+TestGenerator::add_to_test_strings(const string &s)
 {
   if (find(test_strings.begin(), test_strings.end(), s) == test_strings.end()) {
+    addMemoryUsage(STRING_MEMORY, getStringMemory(s));
     test_strings.push_back(s);
   }
 }
 
 void
-TestGenerator::add_to_test_strings(set <string> strs)
+TestGenerator::add_to_test_strings(const set <string> &strs)
 {
-  set <string>::iterator it;
+  set <string>::const_iterator it;
   for (it = strs.begin(); it != strs.end(); it++)
     add_to_test_strings(*it);
 }
@@ -135,10 +163,282 @@ TestGenerator::add_to_test_strings(set <string> strs)
 void
 TestGenerator::gen_evil_strings()
 {
+  TraceSpan span("TestGenerator::gen_evil_strings");
   vector <Path>::iterator path_iter;
   for (path_iter = paths.begin(); path_iter != paths.end(); path_iter++) {
-    set <string> evil_strings = path_iter->gen_evil_strings(punct_marks);
+    if (!options.in_shard(path_iter - paths.begin())) continue;
+    set <string> evil_strings =
+      path_iter->gen_evil_strings(test_chars, options.minimize ? &coverage : NULL);
     add_to_test_strings(evil_strings);
+    releaseMemoryUsage(STRING_MEMORY, getStringSetMemory(evil_strings));
+  }
+}
+
+void
+TestGenerator::gen_mutated_strings()
+{
+  TraceSpan span("TestGenerator::gen_mutated_strings");
+  vector <Path>::iterator path_iter;
+  for (path_iter = paths.begin(); path_iter != paths.end(); path_iter++) {
+    if (!options.in_shard(path_iter - paths.begin())) continue;
+    set <string> mutated_strings;
+    mutator.mutate(path_iter->get_path_string(), mutated_strings);
+    addMemoryUsage(STRING_MEMORY, getStringSetMemory(mutated_strings));
+    add_to_test_strings(mutated_strings);
+    releaseMemoryUsage(STRING_MEMORY, getStringSetMemory(mutated_strings));
+  }
+}
+
+// Greedy set cover: repeatedly keep the string that exercises the most
+// features not yet covered.  The kept strings stay in their original order.
+void
+TestGenerator::minimize_test_strings()
+{
+  TraceSpan span("TestGenerator::minimize_test_strings");
+  set <string> covered;
+  vector <bool> keep(test_strings.size(), false);
+
+  while (true) {
+    int best = -1;
+    unsigned int best_gain = 0;
+    for (unsigned int i = 0; i < test_strings.size(); i++) {
+      if (keep[i]) continue;
+
+      // a string without recorded features cannot be shown to be redundant
+      set <string> &features = coverage[test_strings[i]];
+      if (features.empty()) {
+        keep[i] = true;
+        continue;
+      }
+
+      unsigned int gain = 0;
+      set <string>::iterator it;
+      for (it = features.begin(); it != features.end(); it++) {
+        if (covered.find(*it) == covered.end()) gain++;
+      }
+      if (gain > best_gain) {
+        best = i;
+        best_gain = gain;
+      }
+    }
+    if (best == -1) break;
+
+    keep[best] = true;
+    covered.insert(coverage[test_strings[best]].begin(), coverage[test_strings[best]].end());
+  }
+
+  vector <string> kept;
+  for (unsigned int i = 0; i < test_strings.size(); i++) {
+    if (keep[i]) kept.push_back(test_strings[i]);
+    else releaseMemoryUsage(STRING_MEMORY, getStringMemory(test_strings[i]));
+  }
+  test_strings = kept;
+}
+
+// The basis traversal is a depth first search that explores a state the first
+// time it is reached and follows first edges (the edge to the lowest numbered
+// state) to final every later time.  So the path through an edge is the
+// traversal's route to the edge's state, then the edge, then first edges, and
+// there is one path for each edge that leads to final or to a state that was
+// already reached.  The paths are counted exactly; strings and bytes are
+// counted as the edges generate them, before duplicates are removed.  Loops
+// with a lower bound above one are assumed to repeat their first iteration.
+// Strings from mutations are not counted.
+TestEstimate
+TestGenerator::estimate_test_strings()
+{
+  unsigned int size = nfa.get_size();
+  unsigned int final = nfa.get_final();
+
+  estimate.paths = 0;
+  estimate.strings = 0;
+  estimate.bytes = 0;
+  path_bytes = 0;
+
+  // states that cannot reach final are never part of a path
+  first_edge.assign(size, -2);
+  body_initial.clear();
+
+  prefix_length.assign(size, -1);
+  suffix_length.assign(size, -1);
+  if (find_first_edge(nfa.get_initial())) {
+    if (nfa.get_initial() == final) {
+      estimate.paths = 1;
+      estimate.strings = 1;
+    }
+    else {
+      estimate_paths(nfa.get_initial(), 0);
+    }
+  }
+
+  // the minimum cover has fewer paths, each as long as a basis path on average
+  if (options.traversal == MIN_COVER_TRAVERSAL && estimate.paths > 0) {
+    unsigned long cover_paths = nfa.count_min_cover_paths();
+    estimate.strings -= estimate.paths - cover_paths;
+    estimate.bytes -= path_bytes - path_bytes * cover_paths / estimate.paths;
+    estimate.paths = cover_paths;
+  }
+
+  return estimate;
+}
+
+bool
+TestGenerator::find_first_edge(unsigned int state)
+{
+  if (state == nfa.get_final()) return true;
+  if (first_edge[state] != -2) return first_edge[state] != -1;
+  first_edge[state] = -1;
+
+  bool live = false;
+  const vector <Transition> &edges = nfa.get_transitions(state);
+  vector <Transition>::const_iterator it;
+  for (it = edges.begin(); it != edges.end(); it++) {
+    unsigned int next_state = it->to;
+    Edge *edge = it->edge;
+    if (!find_first_edge(next_state)) continue;
+    if (!live) first_edge[state] = next_state;
+    live = true;
+    if (edge->getType() == BEGIN_LOOP_EDGE) body_initial[edge->get_regex_loop()] = next_state;
+  }
+  return live;
+}
+
+void
+TestGenerator::estimate_paths(unsigned int state, long length)
+{
+  prefix_length[state] = length;
+
+  const vector <Transition> &edges = nfa.get_transitions(state);
+  vector <Transition>::const_iterator it;
+  for (it = edges.begin(); it != edges.end(); it++) {
+    unsigned int next_state = it->to;
+    Edge *edge = it->edge;
+    if (next_state != nfa.get_final() && first_edge[next_state] < 0) continue;
+
+    long next_length = length + get_edge_length(edge, state);
+    estimate_evil_strings(edge, state, next_length + get_suffix_length(next_state));
+
+    // a state that was already reached follows first edges to final
+    if (next_state == nfa.get_final() || prefix_length[next_state] != -1) {
+      estimate.paths++;
+      estimate.strings++;
+      estimate.bytes += next_length + get_suffix_length(next_state);
+      path_bytes += next_length + get_suffix_length(next_state);
+    }
+    else {
+      estimate_paths(next_state, next_length);
+    }
+  }
+}
+
+void
+TestGenerator::estimate_evil_strings(Edge *edge, unsigned int state, long length)
+{
+  switch (edge->getType()) {
+    case CHAR_SET_EDGE:
+    {
+      // each test character replaces the path's character
+      CharSet *char_set = edge->get_char_set();
+      const vector <string> &chars = test_chars.get_test_chars(char_set);
+      vector <string>::const_iterator it;
+      for (it = chars.begin(); it != chars.end(); it++) {
+        estimate.strings++;
+        estimate.bytes += length - char_set->get_valid_character().length() + it->length();
+      }
+      break;
+    }
+    case STRING_EDGE:
+    {
+      set <string> substrings =
+        edge->get_regex_string()->gen_evil_substrings(base_substring, punct_marks);
+      set <string>::iterator it;
+      for (it = substrings.begin(); it != substrings.end(); it++) {
+        estimate.strings++;
+        estimate.bytes += length - base_substring.length() + it->length();
+      }
+      break;
+    }
+    case END_LOOP_EDGE:
+    {
+      // strings that repeat an empty iteration are the path string itself
+      RegexLoop *regex_loop = edge->get_regex_loop();
+      long iteration = prefix_length[state] - prefix_length[body_initial[regex_loop]];
+      if (iteration == 0) break;
+      vector <int> iterations = regex_loop->get_evil_iterations();
+      vector <int>::iterator it;
+      for (it = iterations.begin(); it != iterations.end(); it++) {
+        if (*it == 0) continue;
+        estimate.strings++;
+        estimate.bytes += length + *it * iteration;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+long
+TestGenerator::get_edge_length(Edge *edge, unsigned int state)
+{
+  if (edge->getType() == END_LOOP_EDGE) {
+    RegexLoop *regex_loop = edge->get_regex_loop();
+    if (regex_loop->get_lower() <= 1) return 0;
+    long iteration = prefix_length[state] - prefix_length[body_initial[regex_loop]];
+    return (regex_loop->get_lower() - 1) * iteration;
+  }
+  return get_chain_edge_length(edge, state);
+}
+
+long
+TestGenerator::get_suffix_length(unsigned int state)
+{
+  if (suffix_length[state] != -1) return suffix_length[state];
+
+  long length = 0;
+  if (state != nfa.get_final()) {
+    unsigned int next_state = first_edge[state];
+    length = get_chain_edge_length(nfa.get_edge(state, next_state), state) +
+      get_suffix_length(next_state);
+  }
+  suffix_length[state] = length;
+  return length;
+}
+
+long
+TestGenerator::get_chain_length(unsigned int state, unsigned int end)
+{
+  long length = 0;
+  while (state != end && state != nfa.get_final()) {
+    unsigned int next_state = first_edge[state];
+    length += get_chain_edge_length(nfa.get_edge(state, next_state), state);
+    state = next_state;
+  }
+  return length;
+}
+
+long
+TestGenerator::get_chain_edge_length(Edge *edge, unsigned int state)
+{
+  switch (edge->getType()) {
+    case CHARACTER_EDGE:
+      return encode_utf8(edge->get_character()).length();
+    case CHAR_SET_EDGE:
+      return edge->get_char_set()->get_valid_character().length();
+    case LITERAL_EDGE:
+      return edge->get_literal().length();
+    case STRING_EDGE:
+      return base_substring.length();
+    case END_LOOP_EDGE:
+    {
+      // the extra iterations repeat the loop's states along first edges
+      RegexLoop *regex_loop = edge->get_regex_loop();
+      if (regex_loop->get_lower() <= 1) return 0;
+      return (regex_loop->get_lower() - 1) *
+        get_chain_length(body_initial[regex_loop], state);
+    }
+    default:
+      return 0;
   }
 }
 
@@ -146,5 +446,22 @@ void
 TestGenerator::add_stats(Stats &stats)
 {
   stats.add("PATHS", "Paths", paths.size());
+  stats.add("PATHS", "Path nodes", trie.get_num_nodes());
   stats.add("PATHS", "Strings", test_strings.size());
+  if (options.shard_count > 1) {
+    long shard_paths = 0;
+    for (unsigned int i = 0; i < paths.size(); i++) {
+      if (options.in_shard(i)) shard_paths++;
+    }
+    stats.add("PATHS", "Shard paths", shard_paths);
+  }
+  if (options.minimize) {
+    stats.add("PATHS", "Strings before minimizing", unminimized_count);
+    long ratio = 0;
+    if (unminimized_count > 0)
+      ratio = 100 - (100 * test_strings.size() + unminimized_count / 2) / unminimized_count;
+    stats.add("PATHS", "Reduction ratio (%)", ratio);
+  }
+  stats.add("PATHS", "Test char tables", test_chars.get_num_tables());
+  if (options.mutations != 0) mutator.add_stats(stats);
 }
@@ -25,44 +25,137 @@
 #ifndef TEST_GENERATOR_H
 #define TEST_GENERATOR_H
 
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
+#include "EngineOptions.h"
 #include "NFA.h"
 #include "Path.h"
+#include "StringMutator.h"
 using namespace std;
 
+class RegexLoop;
+
+// predicted output of gen_test_strings
+struct TestEstimate
+{
+  unsigned long paths;		// number of paths
+  unsigned long strings;	// number of strings (duplicates are counted)
+  unsigned long bytes;		// total length of the strings
+};
+
+// Checks the anchors of the paths of one regex: warns about an anchor in the
+// middle of a path and about paths that disagree on a leading ^ or a trailing
+// $ (each warning is given once).
+class AnchorChecker {
+
+public:
+
+  AnchorChecker() {
+    all_start_with_caret = false; all_end_with_dollar = false;
+    warn_anchor_middle = false; warn_caret_start = false; warn_dollar_end = false;
+  }
+
+  // checks a path with initial string path_string, adding new warnings to warnings
+  void check_path(Path &path, const string &path_string, vector <string> &warnings);
+
+private:
+
+  string first_string;		// string of the first path (with a non-empty string)
+  bool all_start_with_caret;	// set if the first path starts with ^
+  bool all_end_with_dollar;	// set if the first path ends with $
+  bool warn_anchor_middle;	// set once each warning is given
+  bool warn_caret_start;
+  bool warn_dollar_end;
+};
+
 class TestGenerator {
 
 public:
 
-  TestGenerator(NFA n, string b, set <char> p) { nfa = n; base_substring = b; punct_marks = p;}
+  // the generator traverses n in place, so n must outlive the generator
+  TestGenerator(NFA &n, const string &b, const set <char> &p,
+      const EngineOptions &o = EngineOptions())
+    : nfa(n), mutator(o.mutations, b), test_chars(p) {
+    base_substring = b; punct_marks = p; options = o;
+    unminimized_count = 0;
+  }
 
   // generate test strings
   vector <string> gen_test_strings();
 
+  // predicts the paths and strings gen_test_strings will produce without
+  // generating them
+  TestEstimate estimate_test_strings();
+
   // add test generation stats
   void add_stats(Stats &stats);
 
 private:
 
-  NFA nfa;				// NFA to traverse
+  NFA &nfa;				// NFA to traverse
   string base_substring;		// base string for regex strings
   set <char> punct_marks;		// set of punct marks
+  EngineOptions options;		// options for choosing paths and strings
+  map <string, set <string> > coverage;	// features exercised by each string
+  unsigned int unminimized_count;	// number of strings before minimizing
+  PathTrie trie;			// nodes of the paths
   vector <Path> paths;			// list of paths
   vector <string> test_strings;		// list of test strings
+  StringMutator mutator;		// applies options.mutations to path strings
+  TestCharCache test_chars;		// test characters for each character set
+
+  // used by estimate_test_strings
+  TestEstimate estimate;		// estimate being computed
+  unsigned long path_bytes;		// bytes of the strings for the paths
+  vector <int> first_edge;		// first state after each state on a path (-1 if
+					// none, -2 if not yet found)
+  vector <long> prefix_length;		// length when traversal first reaches a state (-1 if not yet)
+  vector <long> suffix_length;		// length from a state to final along first edges (-1 if unknown)
+  map <RegexLoop *, unsigned int> body_initial;	// first state inside each loop
   
   // generates initial set of strings
   void gen_initial_strings();
 
   // adds a string to test string vector (unless it is already there)
-  void add_to_test_strings(string s);
+  void add_to_test_strings(const string &s);
 
   // adds a set of strings to test string vector
-  void add_to_test_strings(set <string> strs);
+  void add_to_test_strings(const set <string> &strs);
 
   // generates additional evil strings
   void gen_evil_strings();
+
+  // generates strings by mutating the path strings
+  void gen_mutated_strings();
+
+  // keeps a smallest subset of the strings that exercises every feature
+  void minimize_test_strings();
+
+  // finds the first edge of state and the states after it, returns false if
+  // state cannot reach final
+  bool find_first_edge(unsigned int state);
+
+  // estimates the paths starting from state, reached with a string of length
+  void estimate_paths(unsigned int state, long length);
+
+  // estimates the evil strings generated for edge from state by a path of length
+  void estimate_evil_strings(Edge *edge, unsigned int state, long length);
+
+  // returns the length of the string for edge from state on the first path
+  // that reaches state
+  long get_edge_length(Edge *edge, unsigned int state);
+
+  // returns the length of the string from state to final along first edges
+  long get_suffix_length(unsigned int state);
+
+  // returns the length of the string from state to end along first edges
+  long get_chain_length(unsigned int state, unsigned int end);
+
+  // returns the length of the string for edge from state when following
+  // first edges
+  long get_chain_edge_length(Edge *edge, unsigned int state);
 };
 
 #endif // TEST_GENERATOR_H
@@ -0,0 +1,125 @@
+/*  Trace.cpp: trace spans for engine runs
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Trace.h"
+#include "json.h"
+using namespace std;
+
+// spans kept per thread (the oldest are overwritten past this)
+static const unsigned int TRACE_CAPACITY = 1 << 16;
+
+struct TraceEvent
+{
+  const char *name;		// name of the span
+  const char *arg_name;		// name of the argument (NULL for none)
+  long arg_value;		// value of the argument
+  unsigned long start;		// start time in nanoseconds
+  unsigned long duration;	// duration in nanoseconds
+};
+
+struct TraceBuffer
+{
+  vector <TraceEvent> events;	// ring of TRACE_CAPACITY events
+  unsigned long count;		// events recorded (count % TRACE_CAPACITY is next)
+  unsigned long origin;		// time the trace started
+  unsigned int tid;		// thread id shown in the trace
+};
+
+static atomic <unsigned int> next_tid(1);
+
+thread_local bool trace_enabled = false;
+static thread_local TraceBuffer buffer = { vector <TraceEvent>(), 0, 0, 0 };
+
+void
+startTrace()
+{
+  if (buffer.tid == 0) buffer.tid = next_tid++;
+  buffer.events.resize(TRACE_CAPACITY);
+  buffer.count = 0;
+  buffer.origin = getTraceClock();
+  trace_enabled = true;
+}
+
+void
+stopTrace()
+{
+  trace_enabled = false;
+}
+
+unsigned long
+getTraceClock()
+{
+  return chrono::duration_cast <chrono::nanoseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+addTraceSpan(const char *name, const char *arg_name, long arg_value, unsigned long start)
+{
+  if (buffer.events.empty()) return;
+
+  TraceEvent &event = buffer.events[buffer.count % TRACE_CAPACITY];
+  event.name = name;
+  event.arg_name = arg_name;
+  event.arg_value = arg_value;
+  event.start = start;
+  event.duration = getTraceClock() - start;
+  buffer.count++;
+}
+
+// times are written in microseconds with nanosecond precision
+static string
+format_micros(unsigned long nanos)
+{
+  char text[32];
+  snprintf(text, sizeof(text), "%lu.%03lu", nanos / 1000, nanos % 1000);
+  return text;
+}
+
+string
+getTraceJson()
+{
+  stringstream s;
+  s << "{\"traceEvents\":[";
+
+  unsigned long first = 0;
+  if (buffer.count > TRACE_CAPACITY) first = buffer.count - TRACE_CAPACITY;
+  for (unsigned long i = first; i < buffer.count; i++) {
+    const TraceEvent &event = buffer.events[i % TRACE_CAPACITY];
+    unsigned long start = event.start > buffer.origin ? event.start - buffer.origin : 0;
+    if (i != first) s << ",";
+    s << "\n{\"name\":" << json_string(event.name) << ",\"cat\":\"egret\",\"ph\":\"X\""
+      << ",\"ts\":" << format_micros(start) << ",\"dur\":" << format_micros(event.duration)
+      << ",\"pid\":1,\"tid\":" << buffer.tid;
+    if (event.arg_name != NULL)
+      s << ",\"args\":{" << json_string(event.arg_name) << ":" << event.arg_value << "}";
+    s << "}";
+  }
+
+  s << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_spans\":" << first << "}}\n";
+  return s.str();
+}
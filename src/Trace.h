@@ -0,0 +1,78 @@
+/*  Trace.h: trace spans for engine runs
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A trace span records the time a part of a run takes.  Each thread records
+// its spans into its own fixed-size ring buffer, so recording takes no locks
+// (once the buffer is full the oldest spans are overwritten), and the spans
+// are exported as Chrome trace event JSON for chrome://tracing or Perfetto.
+// When tracing is off a span only tests a thread local flag.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+using namespace std;
+
+// true while spans are recorded on this thread
+extern thread_local bool trace_enabled;
+
+// starts recording spans on this thread (dropping any recorded before)
+void startTrace();
+
+// stops recording spans on this thread
+void stopTrace();
+
+// returns the spans recorded on this thread as Chrome trace event JSON
+string getTraceJson();
+
+// returns the time in nanoseconds used to time spans
+unsigned long getTraceClock();
+
+// records a span that started at start (and ends now)
+void addTraceSpan(const char *name, const char *arg_name, long arg_value,
+    unsigned long start);
+
+// records the time from its creation to its destruction as a span named
+// name (with an optional integer argument shown in the span's details)
+class TraceSpan {
+
+public:
+
+  TraceSpan(const char *n, const char *a = NULL, long v = 0) {
+    name = NULL;
+    if (trace_enabled) {
+      name = n; arg_name = a; arg_value = v; start = getTraceClock();
+    }
+  }
+
+  ~TraceSpan() {
+    if (name != NULL) addTraceSpan(name, arg_name, arg_value, start);
+  }
+
+private:
+
+  const char *name;		// name of the span (NULL if not recorded)
+  const char *arg_name;		// name of the argument (NULL for none)
+  long arg_value;		// value of the argument
+  unsigned long start;		// start time in nanoseconds
+};
+
+#endif // TRACE_H
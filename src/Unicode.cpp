@@ -0,0 +1,264 @@
+/*  Unicode.cpp: Code points, UTF-8 and the Unicode character classes
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "Unicode.h"
+#include "error.h"
+using namespace std;
+
+// tables in UnicodeTables.cpp
+extern const CharInterval WORD_INTERVALS[];
+extern const unsigned int WORD_INTERVALS_COUNT;
+extern const CharInterval DIGIT_INTERVALS[];
+extern const unsigned int DIGIT_INTERVALS_COUNT;
+extern const CharInterval SPACE_INTERVALS[];
+extern const unsigned int SPACE_INTERVALS_COUNT;
+
+static bool interval_less(const CharInterval &a, const CharInterval &b);
+static bool starts_after(CodePoint c, const CharInterval &interval);
+
+void
+append_utf8(string &s, CodePoint c)
+{
+  if (c < 0x80) {
+    s += (char) c;
+  }
+  else if (c < 0x800) {
+    s += (char) (0xC0 | (c >> 6));
+    s += (char) (0x80 | (c & 0x3F));
+  }
+  else if (c < 0x10000) {
+    s += (char) (0xE0 | (c >> 12));
+    s += (char) (0x80 | ((c >> 6) & 0x3F));
+    s += (char) (0x80 | (c & 0x3F));
+  }
+  else {
+    s += (char) (0xF0 | (c >> 18));
+    s += (char) (0x80 | ((c >> 12) & 0x3F));
+    s += (char) (0x80 | ((c >> 6) & 0x3F));
+    s += (char) (0x80 | (c & 0x3F));
+  }
+}
+
+string
+encode_utf8(CodePoint c)
+{
+  string s;
+  append_utf8(s, c);
+  return s;
+}
+
+CodePoint
+decode_utf8(const string &s, unsigned int &idx)
+{
+  unsigned char first = s[idx];
+  if (first < 0x80) {
+    idx++;
+    return first;
+  }
+
+  // the first byte gives the number of continuation bytes
+  unsigned int extra;
+  CodePoint c;
+  CodePoint min_value;
+  if ((first & 0xE0) == 0xC0) {
+    extra = 1; c = first & 0x1F; min_value = 0x80;
+  }
+  else if ((first & 0xF0) == 0xE0) {
+    extra = 2; c = first & 0x0F; min_value = 0x800;
+  }
+  else if ((first & 0xF8) == 0xF0) {
+    extra = 3; c = first & 0x07; min_value = 0x10000;
+  }
+  else {
+    throw EgretException("ERROR: Invalid UTF-8 in regex");
+  }
+
+  if (idx + extra >= s.length()) {
+    throw EgretException("ERROR: Invalid UTF-8 in regex");
+  }
+  for (unsigned int i = 1; i <= extra; i++) {
+    unsigned char next = s[idx + i];
+    if ((next & 0xC0) != 0x80) {
+      throw EgretException("ERROR: Invalid UTF-8 in regex");
+    }
+    c = (c << 6) | (next & 0x3F);
+  }
+
+  // reject overlong encodings, surrogates, and values past the last code point
+  if (c < min_value || (c >= 0xD800 && c <= 0xDFFF) || c > MAX_CODE_POINT) {
+    throw EgretException("ERROR: Invalid UTF-8 in regex");
+  }
+
+  idx += extra + 1;
+  return c;
+}
+
+unsigned int
+utf8_length(const string &s)
+{
+  unsigned int length = 0;
+  for (unsigned int i = 0; i < s.length(); i++) {
+    if ((s[i] & 0xC0) != 0x80) length++;
+  }
+  return length;
+}
+
+bool
+is_valid_code_point(CodePoint c)
+{
+  if (c < 32) return false;
+  if (c >= 127 && c < 160) return false;
+  if (c >= 0xD800 && c <= 0xDFFF) return false;
+  return c <= MAX_CODE_POINT;
+}
+
+const vector <CharInterval> &
+get_class_intervals(char class_char)
+{
+  static const vector <CharInterval> word(WORD_INTERVALS,
+      WORD_INTERVALS + WORD_INTERVALS_COUNT);
+  static const vector <CharInterval> digit(DIGIT_INTERVALS,
+      DIGIT_INTERVALS + DIGIT_INTERVALS_COUNT);
+  static const vector <CharInterval> space(SPACE_INTERVALS,
+      SPACE_INTERVALS + SPACE_INTERVALS_COUNT);
+
+  switch (class_char) {
+    case 'w':	return word;
+    case 'd':	return digit;
+    case 's':	return space;
+    default:
+    {
+      string s = "ERROR (internal): No intervals for character class ";
+      throw EgretException(s + class_char);
+    }
+  }
+}
+
+void
+normalize_intervals(vector <CharInterval> &intervals)
+{
+  if (intervals.empty()) return;
+  sort(intervals.begin(), intervals.end(), interval_less);
+
+  unsigned int last = 0;
+  for (unsigned int i = 1; i < intervals.size(); i++) {
+    if (intervals[i].first <= intervals[last].last + 1) {
+      if (intervals[i].last > intervals[last].last)
+        intervals[last].last = intervals[i].last;
+    }
+    else {
+      intervals[++last] = intervals[i];
+    }
+  }
+  intervals.resize(last + 1);
+}
+
+vector <CharInterval>
+complement_intervals(const vector <CharInterval> &intervals)
+{
+  vector <CharInterval> result;
+  CodePoint next = 0;
+  vector <CharInterval>::const_iterator it;
+  for (it = intervals.begin(); it != intervals.end(); it++) {
+    if (it->first > next) {
+      CharInterval gap = {next, it->first - 1};
+      result.push_back(gap);
+    }
+    next = it->last + 1;
+  }
+  if (next <= MAX_CODE_POINT) {
+    CharInterval gap = {next, MAX_CODE_POINT};
+    result.push_back(gap);
+  }
+  return result;
+}
+
+bool
+in_intervals(const vector <CharInterval> &intervals, CodePoint c)
+{
+  // only the last interval starting at or before c can hold it
+  vector <CharInterval>::const_iterator it =
+    upper_bound(intervals.begin(), intervals.end(), c, starts_after);
+  if (it == intervals.begin()) return false;
+  return (it - 1)->last >= c;
+}
+
+void
+CodePointTable::build(const vector <CharInterval> &intervals)
+{
+  index.clear();
+  blocks.clear();
+
+  // everything from the start of a final interval that runs to the end is the
+  // tail, so only blocks up to the last change of membership are indexed
+  CodePoint end = 0;
+  tail = false;
+  if (!intervals.empty()) {
+    const CharInterval &last = intervals.back();
+    tail = (last.last == MAX_CODE_POINT);
+    end = tail ? last.first : last.last + 1;
+  }
+  unsigned int num_blocks = (end + 255) >> 8;
+
+  vector <unsigned long long> bits(num_blocks * 4, 0);
+  vector <CharInterval>::const_iterator it;
+  for (it = intervals.begin(); it != intervals.end() && it->first < end; it++) {
+    CodePoint last = min(it->last, end - 1);
+    for (CodePoint c = it->first; c <= last; ) {
+      if ((c & 63) == 0 && last - c >= 63) {
+        bits[c >> 6] = ~0ULL;
+        c += 64;
+      }
+      else {
+        bits[c >> 6] |= 1ULL << (c & 63);
+        c++;
+      }
+    }
+  }
+
+  map <vector <unsigned long long>, unsigned short> block_ids;
+  index.resize(num_blocks);
+  for (unsigned int b = 0; b < num_blocks; b++) {
+    vector <unsigned long long> block(bits.begin() + b * 4, bits.begin() + b * 4 + 4);
+    map <vector <unsigned long long>, unsigned short>::iterator found = block_ids.find(block);
+    if (found == block_ids.end()) {
+      found = block_ids.insert(make_pair(block, blocks.size() / 4)).first;
+      blocks.insert(blocks.end(), block.begin(), block.end());
+    }
+    index[b] = found->second;
+  }
+}
+
+static bool
+interval_less(const CharInterval &a, const CharInterval &b)
+{
+  return a.first < b.first;
+}
+
+static bool
+starts_after(CodePoint c, const CharInterval &interval)
+{
+  return c < interval.first;
+}
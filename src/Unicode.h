@@ -0,0 +1,105 @@
+/*  Unicode.h: Code points, UTF-8 and the Unicode character classes
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Regexes and generated strings are UTF-8.  Characters inside the engine are
+// code points, and sets of them are kept as sorted, disjoint intervals.
+
+#ifndef UNICODE_H
+#define UNICODE_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+typedef unsigned int CodePoint;
+
+const CodePoint MAX_CODE_POINT = 0x10FFFF;
+
+// inclusive range of code points
+struct CharInterval
+{
+  CodePoint first;
+  CodePoint last;
+};
+
+// appends the UTF-8 encoding of c to s
+void append_utf8(string &s, CodePoint c);
+
+// returns the UTF-8 encoding of c
+string encode_utf8(CodePoint c);
+
+// decodes the code point starting at s[idx] and moves idx past it (throws an
+// exception if s is not valid UTF-8 there)
+CodePoint decode_utf8(const string &s, unsigned int &idx);
+
+// returns the number of code points in s
+unsigned int utf8_length(const string &s);
+
+// returns true if c can appear in a regex or generated string (not a control
+// character or surrogate)
+bool is_valid_code_point(CodePoint c);
+
+// returns the intervals matched by the class \w, \d or \s
+const vector <CharInterval> &get_class_intervals(char class_char);
+
+// sorts intervals and merges the ones that overlap or touch
+void normalize_intervals(vector <CharInterval> &intervals);
+
+// returns the code points not in the (normalized) intervals
+vector <CharInterval> complement_intervals(const vector <CharInterval> &intervals);
+
+// returns true if c is in the (normalized) intervals
+bool in_intervals(const vector <CharInterval> &intervals, CodePoint c);
+
+// Membership of a set of intervals as a two-level bitmap: the code point's
+// top bits index a 256 bit block, and blocks with the same bits are stored
+// once.  Code points past the last indexed block all share one membership.
+// Lookups take the same time however many intervals the set has.
+class CodePointTable {
+
+public:
+
+  CodePointTable() { tail = false; }
+
+  // builds the table from (normalized) intervals
+  void build(const vector <CharInterval> &intervals);
+
+  // returns true if c is in the intervals the table was built from
+  bool contains(CodePoint c) const {
+    CodePoint block = c >> 8;
+    if (block >= index.size()) return tail;
+    return (blocks[index[block] * 4 + ((c >> 6) & 3)] >> (c & 63)) & 1;
+  }
+
+  // returns the bytes used by the table
+  unsigned long get_memory_usage() const {
+    return index.capacity() * sizeof(unsigned short)
+      + blocks.capacity() * sizeof(unsigned long long);
+  }
+
+private:
+
+  vector <unsigned short> index;		// block of each 256 code points
+  vector <unsigned long long> blocks;	// 4 words per distinct block
+  bool tail;				// membership past the indexed blocks
+};
+
+#endif // UNICODE_H
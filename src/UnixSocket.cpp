@@ -0,0 +1,135 @@
+/*  UnixSocket.cpp: line-oriented Unix domain socket connections
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "UnixSocket.h"
+#include "error.h"
+using namespace std;
+
+static struct sockaddr_un make_address(const string &path);
+
+int
+listen_unix(const string &path, int backlog)
+{
+  struct sockaddr_un addr = make_address(path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    throw EgretException("ERROR: Unable to create socket: " + string(strerror(errno)));
+  }
+
+  unlink(path.c_str());
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, backlog) < 0) {
+    string err = strerror(errno);
+    close(fd);
+    throw EgretException("ERROR: Unable to listen on " + path + ": " + err);
+  }
+
+  return fd;
+}
+
+int
+connect_unix(const string &path)
+{
+  struct sockaddr_un addr = make_address(path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    throw EgretException("ERROR: Unable to create socket: " + string(strerror(errno)));
+  }
+
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    string err = strerror(errno);
+    close(fd);
+    throw EgretException("ERROR: Unable to connect to " + path + ": " + err);
+  }
+
+  return fd;
+}
+
+SocketLines::~SocketLines()
+{
+  close(fd);
+}
+
+bool
+SocketLines::read_line(string &line)
+{
+  too_long = false;
+  size_t searched = 0;
+  while (true) {
+    size_t newline = buffer.find('\n', searched);
+    if (newline != string::npos) {
+      if (max_length != 0 && newline > max_length) too_long = true;
+      if (too_long) line = "";
+      else line = buffer.substr(0, newline);
+      buffer.erase(0, newline + 1);
+      return true;
+    }
+
+    // the rest of an over-long line is dropped as it arrives so a client
+    // cannot make the buffer grow without limit
+    if (max_length != 0 && buffer.length() > max_length) {
+      too_long = true;
+      buffer.clear();
+    }
+    searched = buffer.length();
+
+    char chunk[4096];
+    ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    buffer.append(chunk, count);
+  }
+}
+
+bool
+SocketLines::write_line(const string &line)
+{
+  string data = line + "\n";
+  size_t sent = 0;
+  while (sent < data.length()) {
+    ssize_t count = send(fd, data.data() + sent, data.length() - sent, MSG_NOSIGNAL);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    sent += count;
+  }
+  return true;
+}
+
+static struct sockaddr_un
+make_address(const string &path)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (path.length() >= sizeof(addr.sun_path)) {
+    throw EgretException("ERROR: Socket path is too long: " + path);
+  }
+  strcpy(addr.sun_path, path.c_str());
+  return addr;
+}
@@ -0,0 +1,69 @@
+/*  UnixSocket.h: line-oriented Unix domain socket connections
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UNIX_SOCKET_H
+#define UNIX_SOCKET_H
+
+#include <string>
+using namespace std;
+
+// creates a listening socket at path (replacing a stale one), throws
+// EgretException on failure
+int listen_unix(const string &path, int backlog);
+
+// connects to the socket at path, throws EgretException on failure
+int connect_unix(const string &path);
+
+// A connected socket that exchanges newline-terminated lines.
+class SocketLines {
+
+public:
+
+  SocketLines(int _fd, size_t _max_length = 0) {
+    fd = _fd;
+    max_length = _max_length;
+    too_long = false;
+  }
+  ~SocketLines();
+
+  // reads the next line (without the newline), returns false at end of input
+  // - a line longer than the maximum length is skipped and returned empty,
+  // with line_too_long set
+  bool read_line(string &line);
+
+  // returns true if the line last read was over the maximum length
+  bool line_too_long() { return too_long; }
+
+  // writes line followed by a newline, returns false if the peer went away
+  bool write_line(const string &line);
+
+private:
+
+  int fd;		// socket file descriptor (closed by the destructor)
+  string buffer;	// received data not yet returned as a line
+  size_t max_length;	// longest line kept in the buffer (0 for no limit)
+  bool too_long;	// set if the line last read was over max_length
+
+  SocketLines(const SocketLines &other);
+  SocketLines &operator= (const SocketLines &other);
+};
+
+#endif // UNIX_SOCKET_H
@@ -0,0 +1,111 @@
+/*  WorkQueue.h: bounded blocking queue shared by worker threads
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+using namespace std;
+
+// A queue with a fixed capacity.  Producers block while the queue is full,
+// which gives backpressure to whatever is feeding the queue.
+template <class T>
+class WorkQueue {
+
+public:
+
+  WorkQueue(unsigned int _capacity) { capacity = _capacity; closed = false; }
+
+  // adds an item, blocking while the queue is full (returns false if closed)
+  bool push(const T &item);
+
+  // adds an item unless the queue is full (returns false if full or closed)
+  bool try_push(const T &item);
+
+  // removes an item, blocking while the queue is empty (returns false once
+  // the queue is closed and drained)
+  bool pop(T &item);
+
+  // closes the queue - waiting consumers drain the remaining items
+  void close();
+
+private:
+
+  unsigned int capacity;	// maximum number of queued items
+  bool closed;			// set once no more items will be added
+  deque <T> items;		// queued items
+  mutex lock;			// protects all members
+  condition_variable not_full;	// signaled when an item is removed
+  condition_variable not_empty;	// signaled when an item is added
+};
+
+template <class T>
+bool
+WorkQueue<T>::push(const T &item)
+{
+  unique_lock <mutex> guard(lock);
+  while (!closed && items.size() >= capacity) not_full.wait(guard);
+  if (closed) return false;
+
+  items.push_back(item);
+  not_empty.notify_one();
+  return true;
+}
+
+template <class T>
+bool
+WorkQueue<T>::try_push(const T &item)
+{
+  unique_lock <mutex> guard(lock);
+  if (closed || items.size() >= capacity) return false;
+
+  items.push_back(item);
+  not_empty.notify_one();
+  return true;
+}
+
+template <class T>
+bool
+WorkQueue<T>::pop(T &item)
+{
+  unique_lock <mutex> guard(lock);
+  while (!closed && items.empty()) not_empty.wait(guard);
+  if (items.empty()) return false;
+
+  item = items.front();
+  items.pop_front();
+  not_full.notify_one();
+  return true;
+}
+
+template <class T>
+void
+WorkQueue<T>::close()
+{
+  unique_lock <mutex> guard(lock);
+  closed = true;
+  not_full.notify_all();
+  not_empty.notify_all();
+}
+
+#endif // WORK_QUEUE_H
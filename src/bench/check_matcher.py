@@ -0,0 +1,231 @@
+# check_matcher.py: checks the native matcher against Python's re module
+#
+# Copyright (C) 2016  Eric Larson and Anna Kirk
+# elarson@seattleu.edu
+#
+# This file is part of EGRET.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# RegexMatcher (egret_ext.classify and egret_ext.match) must agree with
+# re.fullmatch, including the group spans, which follow the backtracking order
+# of Python's sre.  This script builds random regexes from small fragments,
+# runs them on random strings plus the strings the engine generates for them,
+# and reports every string where the native result differs from re.  The
+# regexes of the benchmark corpus are checked the same way.  Run it with
+# 'make check-matcher' after changing the Scanner, ParseTree or RegexMatcher.
+
+import itertools
+import json
+import os
+import random
+import re
+import sys
+from optparse import OptionParser
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", ".."))
+import egret_ext
+
+# fragments of the regexes used to check accept/reject
+CLASSIFY_FRAGMENTS = ["a", "b", "c", "|", "(", ")", "*", "+", "?", "{2}", "{1,3}", "{2,}",
+    "[a-c]", "[^ab]", "\\d", "\\w", "\\s", ".", "^", "$", "(a|b)", "(?:", ")*", "-", "é",
+    "[à-ï]", "\\n", "\\W"]
+CLASSIFY_ALPHABET = "abc01 -\néàx_"
+
+# fragments of the regexes used to check group spans (lazy repeats and
+# optional groups are where the backtracking order matters)
+SPAN_FRAGMENTS = ["a", "b", "|", "(", ")", "(", ")", "*", "+", "?", "*?", "+?", "??", "{1,2}",
+    "{2,}?", "[ab]", "\\d", ".", "^", "$", "(a|b)", "(?:", "(?P<n%d>", "(a*)", "(b?)", "é", "x"]
+SPAN_ALPHABET = "aabbx1é\n"
+
+# regexes checked along with the corpus (anchors, newlines, UTF-8 and repeats
+# that are large enough to need more than one word of state)
+EDGE_CASES = [r"^a$", r"a$\n", r"(^a|b)+", r"$", r"^", r"^$", r"a|^", r"(a$)?\n?", r"x{0}",
+    r"(ab){2,4}c?", r"[^a-c]+\d*", r"(?:a|b)*abb", r"\w+@\w+\.com", r"é+[À-ÿ]?", r"(a|b|)c",
+    r".*", r".{3,}x", r"a{70}", r"(a|b){40,80}", r"[\s\S]{3}", r"\W\D\S", r"(^|x)y($|z)"]
+
+# characters used to edit the strings of corpus regexes
+EDIT_ALPHABET = "abcxyz019_-.@ \n\t$^()[]é中AZ"
+
+class Checker:
+
+    def __init__(self, verbose):
+        self.verbose = verbose
+        self.regexes = 0
+        self.unsupported = 0
+        self.checked = 0
+        self.mismatches = 0
+
+    def report(self, message):
+        self.mismatches += 1
+        if self.mismatches <= self.verbose:
+            print(message)
+
+    # compares egret_ext.classify with re.fullmatch on strs
+    def check_classify(self, regexStr, regex, strs):
+        try:
+            results = egret_ext.classify(regexStr, strs)
+        except egret_ext.error:
+            results = None
+        if results == None:
+            self.unsupported += 1
+            return
+        self.regexes += 1
+        for testStr, accepted in zip(strs, results):
+            self.checked += 1
+            if accepted != (regex.fullmatch(testStr) != None):
+                self.report("MISMATCH %r %r native %s" % (regexStr, testStr, accepted))
+
+    # compares egret_ext.match (group names and spans) with re.fullmatch on strs
+    def check_spans(self, regexStr, regex, strs):
+        try:
+            native = egret_ext.match(regexStr, strs)
+        except egret_ext.error:
+            native = None
+        if native == None:
+            self.unsupported += 1
+            return
+        self.regexes += 1
+        (names, results) = native
+        expectedNames = [ None ] * regex.groups
+        for name, index in regex.groupindex.items():
+            expectedNames[index - 1] = name
+        if [ name or None for name in names ] != expectedNames:
+            self.report("NAMES %r native %s expected %s" % (regexStr, names, expectedNames))
+            return
+        for testStr, spans in zip(strs, results):
+            self.checked += 1
+            match = regex.fullmatch(testStr)
+            if match == None:
+                expected = None
+            else:
+                expected = tuple(None if match.span(i) == (-1, -1) else match.span(i)
+                    for i in range(1, regex.groups + 1))
+            if spans != expected:
+                self.report("MISMATCH %r %r native %s expected %s" %
+                    (regexStr, testStr, spans, expected))
+
+# returns the strings the engine generates for regexStr (empty on error)
+def engine_strings(regexStr):
+    try:
+        output = egret_ext.run(regexStr, "evil", False, False)
+    except Exception:
+        return []
+    if output[0].startswith("ERROR"):
+        return []
+    return output[1:]
+
+# returns a random regex made of fragments (None if re cannot compile it)
+def random_regex(rng, fragments):
+    parts = []
+    for i in range(rng.randint(1, 9)):
+        fragment = rng.choice(fragments)
+        if "%d" in fragment:
+            fragment = fragment % i
+        parts.append(fragment)
+    regexStr = "".join(parts)
+    try:
+        return (regexStr, re.compile(regexStr))
+    except Exception:
+        return (regexStr, None)
+
+def random_strings(rng, alphabet, count):
+    return [ "".join(rng.choice(alphabet) for i in range(rng.randint(0, 6)))
+        for j in range(count) ]
+
+# returns strs with randomly edited copies and samples of the regex added
+def edited_strings(rng, regexStr, strs):
+    result = set(strs)
+    for testStr in strs[:50]:
+        for i in range(3):
+            chars = list(testStr)
+            for j in range(rng.randint(1, 3)):
+                pos = rng.randint(0, len(chars))
+                op = rng.randint(0, 2)
+                if op == 0:
+                    chars.insert(pos, rng.choice(EDIT_ALPHABET))
+                elif chars and op == 1:
+                    del chars[min(pos, len(chars) - 1)]
+                elif chars:
+                    chars[min(pos, len(chars) - 1)] = rng.choice(EDIT_ALPHABET)
+            result.add("".join(chars))
+    try:
+        result.update(itertools.islice(egret_ext.sampler(regexStr, seed = 1), 50))
+    except Exception:
+        pass
+    result.add("")
+    return sorted(result)
+
+def read_corpus(fileName):
+    regexes = []
+    for line in open(fileName, encoding = "utf-8"):
+        if line.strip() != "":
+            regexes.append(json.loads(line)["regex"])
+    return regexes
+
+parser = OptionParser()
+parser.add_option("-n", "--count", dest = "count", type = "int", default = 6000,
+    help = "number of random regexes for each check")
+parser.add_option("-S", "--seed", dest = "seed", type = "int", default = 1,
+    help = "random seed")
+parser.add_option("-c", "--corpus", dest = "corpus",
+    default = os.path.join(os.path.dirname(os.path.abspath(__file__)), "slow_jobs.jsonl"),
+    help = "benchmark corpus whose regexes are also checked")
+parser.add_option("-v", "--verbose", dest = "verbose", type = "int", default = 20,
+    help = "number of mismatches to print")
+opts, args = parser.parse_args()
+
+rng = random.Random(opts.seed)
+fmt = "{0:30}| {1}"
+failed = False
+
+# accept/reject of the corpus regexes
+checker = Checker(opts.verbose)
+for regexStr in read_corpus(opts.corpus) + EDGE_CASES:
+    try:
+        regex = re.compile(regexStr)
+    except Exception:
+        continue
+    checker.check_classify(regexStr, regex, edited_strings(rng, regexStr, engine_strings(regexStr)))
+
+# accept/reject of random regexes
+for i in range(opts.count):
+    (regexStr, regex) = random_regex(rng, CLASSIFY_FRAGMENTS)
+    if regex == None:
+        continue
+    strs = random_strings(rng, CLASSIFY_ALPHABET, 60) + engine_strings(regexStr)
+    checker.check_classify(regexStr, regex, strs)
+
+print(fmt.format("Classify regexes", checker.regexes))
+print(fmt.format("Classify unsupported", checker.unsupported))
+print(fmt.format("Classify strings", checker.checked))
+print(fmt.format("Classify mismatches", checker.mismatches))
+failed = failed or checker.mismatches != 0
+
+# group spans of random regexes
+checker = Checker(opts.verbose)
+for i in range(opts.count):
+    (regexStr, regex) = random_regex(rng, SPAN_FRAGMENTS)
+    if regex == None:
+        continue
+    strs = random_strings(rng, SPAN_ALPHABET, 40) + engine_strings(regexStr)
+    checker.check_spans(regexStr, regex, strs)
+
+print(fmt.format("Span regexes", checker.regexes))
+print(fmt.format("Span unsupported", checker.unsupported))
+print(fmt.format("Span strings", checker.checked))
+print(fmt.format("Span mismatches", checker.mismatches))
+failed = failed or checker.mismatches != 0
+
+sys.exit(1 if failed else 0)
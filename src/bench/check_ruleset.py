@@ -0,0 +1,101 @@
+# check_ruleset.py: checks that a ruleset's rules get the strings of standalone runs
+#
+# Copyright (C) 2016  Eric Larson and Anna Kirk
+# elarson@seattleu.edu
+#
+# This file is part of EGRET.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# degret -R puts rules that begin with the same items on shared states, and
+# the strings made for a path through a shared edge are spliced onto the
+# other rules' paths.  This script runs random rulesets whose rules share
+# their first items with degret -R and each rule on its own with degret -r,
+# and reports every string of a standalone run that the rule did not get in
+# the ruleset.  Run it with 'make check-ruleset' after changing RuleSet.
+
+import os
+import random
+import subprocess
+import sys
+from optparse import OptionParser
+
+# items the rules of a ruleset begin with (the first is the shared
+# alternation from the HTTP example) and items that end them
+PREFIXES = ["(GET|POST|PUT) /", "(a|bc|d)", "[a-c]+", "x?y", "(ab)*", "(a|b)c",
+    "\\d{2}", "[a-z]+@", "(?:foo|bar)-"]
+SUFFIXES = ["[a-z]+x", "[a-z]+y", "y", "\\d+", "(q|r)", "z*", "w{2,3}", "[^ab]",
+    "(s|t)+u", "."]
+
+# returns the output lines of degret run with args
+def run_degret(args, input = None):
+    result = subprocess.run([opts.degret] + args, input = input, capture_output = True,
+        text = True)
+    return result.stdout.splitlines()
+
+# returns the strings of each rule in the output of degret -R
+def ruleset_strings(lines):
+    strings = {}
+    rule = None
+    for line in lines[1:]:
+        if line.startswith("Rule "):
+            rule = int(line[5:line.index(":")])
+            strings[rule] = set()
+        elif rule is not None and "\t" in line:
+            strings[rule].add(line.split("\t")[0])
+    return strings
+
+def random_ruleset(rng):
+    prefix = "".join(rng.choice(PREFIXES) for i in range(rng.randint(1, 2)))
+    rules = []
+    for i in range(rng.randint(2, 4)):
+        rule = prefix + rng.choice(SUFFIXES)
+        if rng.random() < 0.5:
+            rule += rng.choice(SUFFIXES)
+        if rule not in rules:
+            rules.append(rule)
+    return rules
+
+parser = OptionParser()
+parser.add_option("-n", "--count", dest = "count", type = "int", default = 200,
+    help = "number of random rulesets")
+parser.add_option("-S", "--seed", dest = "seed", type = "int", default = 1,
+    help = "random seed")
+parser.add_option("-d", "--degret", dest = "degret",
+    default = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "degret"),
+    help = "degret executable")
+opts, args = parser.parse_args()
+
+rng = random.Random(opts.seed)
+fmt = "{0:30}| {1}"
+rulesets = [ ["(GET|POST|PUT) /[a-z]+x", "(GET|POST|PUT) /[a-z]+y"] ]
+rulesets += [ random_ruleset(rng) for i in range(opts.count) ]
+
+checked = 0
+failed = 0
+for rules in rulesets:
+    strings = ruleset_strings(run_degret(["-R", "-"], "\n".join(rules) + "\n"))
+    for i in range(len(rules)):
+        lines = run_degret(["-r", rules[i]])
+        if not lines or lines[0] != "SUCCESS":
+            continue
+        checked += 1
+        missing = set(lines[1:]) - strings.get(i, set())
+        if missing:
+            failed += 1
+            print("Rule %d of %s is missing %s" % (i, rules, sorted(missing)))
+
+print(fmt.format("Rules checked", checked))
+print(fmt.format("Rules missing strings", failed))
+sys.exit(1 if failed > 0 else 0)
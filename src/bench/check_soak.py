@@ -0,0 +1,106 @@
+# check_soak.py: checks that a long job stream does not grow the server's memory
+#
+# Copyright (C) 2016  Eric Larson and Anna Kirk
+# elarson@seattleu.edu
+#
+# This file is part of EGRET.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# degret --serve-stdin and egretd run one job after another for as long as
+# they are up, so everything a job allocates must be freed when it ends.  This
+# script streams random jobs (including ones that fail to parse) to
+# degret --serve-stdin and reads the server's resident set size after a
+# warm-up and again at the end.  It fails if the RSS grew by more than the
+# allowed amount.  Run it with 'make check-soak' after changing what the
+# engine allocates.
+
+import json
+import os
+import random
+import subprocess
+import sys
+import threading
+from optparse import OptionParser
+
+# fragments of the job regexes (classes and sets have payloads of their own,
+# and unbalanced parentheses make some jobs fail part way)
+FRAGMENTS = ["a", "b", "xyz", "|", "(", ")", "*", "+", "?", "{2}", "{1,3}", "{2,}",
+    "[a-c]", "[^ab]", "\\d", "\\w", "\\s", "\\W", ".", "^", "$", "(a|b)", "(?:", ")*",
+    "[à-ï]+", "é", "\\w+@\\w+", "(ab|cd){2,4}", "\\d{3}-\\d{4}"]
+
+# returns the resident set size of process pid in kB
+def rss_kb(pid):
+    for line in open("/proc/%d/status" % pid):
+        if line.startswith("VmRSS:"):
+            return int(line.split()[1])
+    return 0
+
+def random_job(rng, index):
+    regex = "".join(rng.choice(FRAGMENTS) for i in range(rng.randint(1, 8)))
+    return json.dumps({"id": index, "regex": regex, "traversal": rng.choice(["basis", "min_cover"])})
+
+# sends count jobs and waits for their results (the jobs are written on
+# another thread so a full output pipe cannot block the server)
+def run_jobs(server, rng, start, count):
+    jobs = [ (random_job(rng, i) + "\n").encode("utf-8") for i in range(start, start + count) ]
+    def write_jobs():
+        server.stdin.writelines(jobs)
+        server.stdin.flush()
+    writer = threading.Thread(target = write_jobs)
+    writer.start()
+    for i in range(count):
+        if server.stdout.readline() == b"":
+            sys.exit("Server exited after %d jobs" % (start + i))
+    writer.join()
+
+parser = OptionParser()
+parser.add_option("-n", "--count", dest = "count", type = "int", default = 20000,
+    help = "number of jobs after the warm-up")
+parser.add_option("-w", "--warmup", dest = "warmup", type = "int", default = 2000,
+    help = "number of jobs before the first measurement")
+parser.add_option("-g", "--growth", dest = "growth", type = "int", default = 2048,
+    help = "allowed RSS growth in kB")
+parser.add_option("-j", "--workers", dest = "workers", type = "int", default = 2,
+    help = "number of server worker threads")
+parser.add_option("-S", "--seed", dest = "seed", type = "int", default = 1,
+    help = "random seed")
+parser.add_option("-d", "--degret", dest = "degret",
+    default = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "degret"),
+    help = "degret executable")
+opts, args = parser.parse_args()
+
+rng = random.Random(opts.seed)
+fmt = "{0:30}| {1}"
+server = subprocess.Popen([opts.degret, "--serve-stdin", "-j", str(opts.workers)],
+    stdin = subprocess.PIPE, stdout = subprocess.PIPE)
+
+# measured in batches so a trend shows up in the output
+run_jobs(server, rng, 0, opts.warmup)
+start_rss = rss_kb(server.pid)
+print(fmt.format("RSS after %d jobs (kB)" % opts.warmup, start_rss))
+done = 0
+while done < opts.count:
+    batch = min(opts.count - done, max(opts.count // 4, 1))
+    run_jobs(server, rng, opts.warmup + done, batch)
+    done += batch
+    print(fmt.format("RSS after %d jobs (kB)" % (opts.warmup + done), rss_kb(server.pid)))
+end_rss = rss_kb(server.pid)
+
+server.stdin.close()
+server.wait()
+
+growth = end_rss - start_rss
+print(fmt.format("RSS growth (kB)", growth))
+sys.exit(1 if growth > opts.growth else 0)
@@ -22,39 +22,196 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include "EngineSession.h"
+#include "MemoryUsage.h"
 #include "NFA.h"
 #include "ParseTree.h"
+#include "RegexMatcher.h"
+#include "RegexSampler.h"
+#include "RuleSet.h"
 #include "Scanner.h"
 #include "Stats.h"
 #include "TestGenerator.h"
+#include "Trace.h"
+#include "egret.h"
 #include "error.h"
 using namespace std;
 
-static bool debug_mode = false;
-static bool stat_mode = false;
+static vector <string> run_pipeline(string regex, string base_substring,
+    EngineSession *session, bool debug, Stats *stats, const EngineOptions &options);
+static bool is_error(const vector <string> &result);
+static void check_base_substring(string base_substring);
 
 vector <string>
-run_engine(string regex, string base_substring, bool debug = false, bool stat = false)
+run_engine(string regex, string base_substring, bool debug, bool stat,
+    const EngineOptions &options)
+{
+  Stats stats;
+  vector <string> result = run_pipeline(regex, base_substring, NULL, debug,
+      stat ? &stats : NULL, options);
+  if (stat && !is_error(result)) stats.print();
+
+  return result;
+}
+
+vector <string>
+run_engine(string regex, string base_substring, EngineSession &session,
+    bool debug, bool stat, const EngineOptions &options)
+{
+  Stats stats;
+  vector <string> result = run_pipeline(regex, base_substring, &session, debug,
+      stat ? &stats : NULL, options);
+  if (stat && !is_error(result)) stats.print();
+
+  // keep the fragments for the next run unless an error occurred
+  session.end_run(!is_error(result));
+
+  return result;
+}
+
+vector <string>
+run_engine(string regex, string base_substring, Stats &stats,
+    const EngineOptions &options)
+{
+  return run_pipeline(regex, base_substring, NULL, false, &stats, options);
+}
+
+string
+run_ruleset(const vector <string> &regexes, string base_substring, RuleSet &ruleset,
+    bool stat, const EngineOptions &options)
+{
+  TraceSpan span("run_ruleset");
+  clearWarnings();
+  clearMemoryUsage();
+
+  try {
+    check_base_substring(base_substring);
+
+    // the strings kept by minimizing depend on a single regex
+    if (options.minimize) {
+      throw EgretException("ERROR: Minimizing cannot be combined with a ruleset");
+    }
+
+    ruleset.build(regexes);
+    ruleset.gen_test_strings(base_substring, options);
+
+    if (stat) {
+      Stats stats;
+      ruleset.add_stats(stats);
+      addMemoryStats(stats);
+      stats.print();
+    }
+  }
+  catch (EgretException const &e) {
+    return e.getError();
+  }
+
+  return "SUCCESS";
+}
+
+string
+build_sampler(string regex, RegexSampler &sampler, unsigned int min_length,
+    unsigned int max_length, unsigned int loop_cap)
+{
+  clearWarnings();
+  clearMemoryUsage();
+
+  try {
+    Scanner scanner;
+    scanner.init(regex);
+
+    ParseTree tree;
+    tree.build(scanner);
+
+    NFA nfa;
+    nfa.build(tree);
+
+    sampler.build(nfa, min_length, max_length, loop_cap);
+    if (sampler.get_count() == 0) addWarning("No strings within the length bounds");
+  }
+  catch (EgretException const &e) {
+    return e.getError();
+  }
+
+  string warnings = getWarnings();
+  if (warnings == "") warnings = "SUCCESS";
+  return warnings;
+}
+
+string
+build_matcher(string regex, RegexMatcher &matcher)
+{
+  clearWarnings();
+  clearMemoryUsage();
+
+  try {
+    Scanner scanner;
+    scanner.init(regex);
+
+    ParseTree tree;
+    tree.build(scanner);
+
+    matcher.build(tree);
+  }
+  catch (EgretException const &e) {
+    return e.getError();
+  }
+
+  string warnings = getWarnings();
+  if (warnings == "") warnings = "SUCCESS";
+  return warnings;
+}
+
+string
+estimate_engine(string regex, TestEstimate &estimate, string base_substring,
+    const EngineOptions &options)
+{
+  clearWarnings();
+  clearMemoryUsage();
+
+  try {
+    check_base_substring(base_substring);
+
+    Scanner scanner;
+    scanner.init(regex);
+
+    ParseTree tree;
+    tree.build(scanner);
+
+    NFA nfa;
+    nfa.build(tree);
+
+    TestGenerator gen(nfa, base_substring, tree.get_punct_marks(), options);
+    estimate = gen.estimate_test_strings();
+  }
+  catch (EgretException const &e) {
+    return e.getError();
+  }
+
+  string warnings = getWarnings();
+  if (warnings == "") warnings = "SUCCESS";
+  return warnings;
+}
+
+static vector <string>
+run_pipeline(string regex, string base_substring, EngineSession *session, bool debug,
+    Stats *stats, const EngineOptions &options)
 {
   vector <string> test_strings;
+  TraceSpan span("run_engine");
 
-  // process arguments
-  debug_mode = debug;
-  stat_mode = stat;
-  
-  // clear warnings
+  // clear warnings and memory usage
   clearWarnings();
+  clearMemoryUsage();
 
   try {
 
     // check base_substring
-    if (base_substring.length() < 2) {
-      throw EgretException("ERROR: Base substring must have at least two letters");
-    }
-    for (unsigned int i = 0; i < base_substring.length(); i++) {
-      if (!isalpha(base_substring[i])) {
-        throw EgretException("ERROR: Base substring can only contain letters");
-      }
+    check_base_substring(base_substring);
+
+    // the strings kept by minimizing depend on the strings from every path
+    if (options.minimize && options.shard_count > 1) {
+      throw EgretException("ERROR: Minimizing cannot be combined with sharding");
     }
 
     // initialize scanner with regex
@@ -67,28 +224,29 @@ run_engine(string regex, string base_substring, bool debug = false, bool stat =
 
     // build NFA
     NFA nfa;
-    nfa.build(tree);
+    if (session != NULL) tree.number_subtrees(*session);
+    nfa.build(tree, session);
 
     // generate tests
-    TestGenerator gen(nfa, base_substring, tree.get_punct_marks());
+    TestGenerator gen(nfa, base_substring, tree.get_punct_marks(), options);
     test_strings = gen.gen_test_strings();
 
     // print debug info
-    if (debug_mode) {
+    if (debug) {
       cout << "RegEx: " << regex << endl;
       scanner.print();
       tree.print();
       nfa.print();
     }
 
-    // print stats
-    Stats stats;
-    if (stat_mode) {
-      scanner.add_stats(stats);
-      tree.add_stats(stats);
-      nfa.add_stats(stats);
-      gen.add_stats(stats);
-      stats.print();
+    // gather stats
+    if (stats != NULL) {
+      scanner.add_stats(*stats);
+      tree.add_stats(*stats);
+      nfa.add_stats(*stats);
+      gen.add_stats(*stats);
+      addMemoryStats(*stats);
+      if (session != NULL) session->add_stats(*stats);
     }
   }
   catch (EgretException const &e) {
@@ -105,3 +263,22 @@ run_engine(string regex, string base_substring, bool debug = false, bool stat =
 
   return test_strings;
 }
+
+static bool
+is_error(const vector <string> &result)
+{
+  return result[0].substr(0, 5) == "ERROR";
+}
+
+static void
+check_base_substring(string base_substring)
+{
+  if (base_substring.length() < 2) {
+    throw EgretException("ERROR: Base substring must have at least two letters");
+  }
+  for (unsigned int i = 0; i < base_substring.length(); i++) {
+    if (!isalpha(base_substring[i])) {
+      throw EgretException("ERROR: Base substring can only contain letters");
+    }
+  }
+}
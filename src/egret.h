@@ -24,10 +24,56 @@
 
 #include <string>
 #include <vector>
+#include "EngineOptions.h"
+#include "EngineSession.h"
+#include "RegexMatcher.h"
+#include "RegexSampler.h"
+#include "RuleSet.h"
+#include "Stats.h"
+#include "TestGenerator.h"
 using namespace std;
 
 // run_engine: entry point into EGRET engine
 vector <string>
-run_engine(string regex, string base_substring, bool debug = false, bool stat = false);
+run_engine(string regex, string base_substring, bool debug = false, bool stat = false,
+    const EngineOptions &options = EngineOptions());
+
+// run_engine: entry point that reuses NFA fragments for the subtrees the regex
+// shares with the last successful run in the session
+vector <string>
+run_engine(string regex, string base_substring, EngineSession &session,
+    bool debug = false, bool stat = false, const EngineOptions &options = EngineOptions());
+
+// run_engine: entry point that gathers stats into stats instead of printing
+// them (safe to call from several threads at once)
+vector <string>
+run_engine(string regex, string base_substring, Stats &stats,
+    const EngineOptions &options = EngineOptions());
+
+// run_ruleset: generates strings for every rule in regexes with one combined
+// NFA and finds the rules each string matches, returns SUCCESS or the error
+// message (the status of each rule is kept by ruleset)
+string
+run_ruleset(const vector <string> &regexes, string base_substring, RuleSet &ruleset,
+    bool stat = false, const EngineOptions &options = EngineOptions());
+
+// build_sampler: prepares sampler to draw random strings that match regex,
+// returns SUCCESS or the error message
+string
+build_sampler(string regex, RegexSampler &sampler, unsigned int min_length,
+    unsigned int max_length, unsigned int loop_cap);
+
+// build_matcher: prepares matcher to test strings against regex, returns
+// SUCCESS or the error message (the matcher is left unsupported for regexes
+// it cannot match)
+string
+build_matcher(string regex, RegexMatcher &matcher);
+
+// estimate_engine: predicts the paths, strings and bytes run_engine would
+// produce for regex without generating them, returns SUCCESS (or warnings)
+// or the error message
+string
+estimate_engine(string regex, TestEstimate &estimate, string base_substring = "evil",
+    const EngineOptions &options = EngineOptions());
 
 #endif // EGRET_H
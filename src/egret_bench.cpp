@@ -0,0 +1,387 @@
+/*  egret_bench.cpp: times engine components
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Each benchmark runs a component in a tight loop and reports its rate so
+// that changes to hot paths can be compared before and after.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "CharSet.h"
+#include "NFA.h"
+#include "ParseTree.h"
+#include "Path.h"
+#include "RegexMatcher.h"
+#include "RegexSampler.h"
+#include "Scanner.h"
+#include "Unicode.h"
+#include "egret.h"
+using namespace std;
+
+struct Benchmark
+{
+  const char *name;			// name given to -b
+  const char *description;		// description printed by -h
+  void (*run)(unsigned long iterations);	// runs the benchmark
+};
+
+static void bench_charset(unsigned long iterations);
+static void bench_match(unsigned long iterations);
+static void bench_paths(unsigned long iterations);
+static void bench_pipeline(unsigned long iterations);
+
+static const Benchmark BENCHMARKS[] = {
+  { "charset", "character set membership for ASCII and Unicode sets", bench_charset },
+  { "match", "full matches of short generated strings", bench_match },
+  { "paths", "path processing that builds the initial strings", bench_paths },
+  { "pipeline", "allocations and time for whole engine runs", bench_pipeline }
+};
+static const unsigned int NUM_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+static char *get_arg(int &idx, int argc, char **argv);
+static void usage();
+static double seconds_since(chrono::steady_clock::time_point start);
+static void report(const string &name, unsigned long count, const char *unit, double seconds);
+static CharSet *make_class_set(CodePoint c, bool complement);
+static CharSet *make_range_set(const CodePoint ranges[][2], unsigned int num_ranges);
+
+// heap allocations made by the process (counted by operator new below)
+static unsigned long allocations = 0;
+
+void *
+operator new(size_t size)
+{
+  allocations++;
+  void *p = malloc(size == 0 ? 1 : size);
+  if (p == NULL) throw bad_alloc();
+  return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int idx = 1;
+  const char *name = NULL;
+  unsigned long iterations = 10000000;
+
+  // Process arguments
+  while (idx < argc) {
+
+    char *arg = get_arg(idx, argc, argv);
+
+    // -b: benchmark to run (all of them if not given)
+    if (strcmp(arg, "-b") == 0) {
+      name = get_arg(idx, argc, argv);
+    }
+
+    // -n: number of iterations for each measurement
+    else if (strcmp(arg, "-n") == 0) {
+      iterations = strtoul(get_arg(idx, argc, argv), NULL, 10);
+    }
+
+    // -h: list the benchmarks
+    else if (strcmp(arg, "-h") == 0) {
+      usage();
+      return 0;
+    }
+
+    // everything else is invalid
+    else {
+      cerr << "USAGE: Invalid command line option: " << arg << endl;
+      return -1;
+    }
+  }
+
+  bool found = false;
+  for (unsigned int i = 0; i < NUM_BENCHMARKS; i++) {
+    if (name != NULL && strcmp(name, BENCHMARKS[i].name) != 0) continue;
+    BENCHMARKS[i].run(iterations);
+    found = true;
+  }
+
+  if (!found) {
+    cerr << "USAGE: Unknown benchmark " << name << endl;
+    return -1;
+  }
+
+  return 0;
+}
+
+// times contains() on ASCII characters (the bitmap) and on random code points
+// (the interval search) for sets ranging from one range to the \w table
+static void
+bench_charset(unsigned long iterations)
+{
+  static const CodePoint LOWER[][2] = { {'a', 'z'} };
+  static const CodePoint SCRIPTS[][2] = { {0xC0, 0xFF}, {0x370, 0x3FF}, {0x4E00, 0x9FFF} };
+
+  vector <pair <string, CharSet *> > sets;
+  sets.push_back(make_pair(string("[a-z]"), make_range_set(LOWER, 1)));
+  sets.push_back(make_pair(string("[À-ÿͰ-Ͽ一-鿿]"), make_range_set(SCRIPTS, 3)));
+  sets.push_back(make_pair(string("\\d"), make_class_set('d', false)));
+  sets.push_back(make_pair(string("\\w"), make_class_set('w', false)));
+  sets.push_back(make_pair(string("[^\\s]"), make_class_set('s', true)));
+
+  // characters are drawn up front so the loop only times the lookup
+  mt19937 rng(1);
+  vector <CodePoint> ascii(4096);
+  vector <CodePoint> unicode(4096);
+  for (unsigned int i = 0; i < ascii.size(); i++) {
+    ascii[i] = uniform_int_distribution <CodePoint>(0, 127)(rng);
+    unicode[i] = uniform_int_distribution <CodePoint>(0, 0x2FFFF)(rng);
+  }
+
+  vector <pair <string, CharSet *> >::iterator it;
+  for (it = sets.begin(); it != sets.end(); it++) {
+    CharSet *char_set = it->second;
+    cout << it->first << " (" << char_set->get_intervals().size() << " intervals)" << endl;
+
+    const vector <CodePoint> *inputs[] = { &ascii, &unicode };
+    const char *input_names[] = { "ascii", "unicode" };
+    for (unsigned int k = 0; k < 2; k++) {
+      const vector <CodePoint> &chars = *inputs[k];
+      unsigned long hits = 0;
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      for (unsigned long i = 0; i < iterations; i++) {
+        if (char_set->contains(chars[i & 4095])) hits++;
+      }
+      double seconds = seconds_since(start);
+
+      // printing hits keeps the loop from being optimized away
+      report(string("  ") + input_names[k] + " (" + to_string(hits) + " hits)",
+          iterations, "lookups", seconds);
+    }
+    delete char_set;
+  }
+}
+
+// times the matcher on the strings generated for each regex plus random
+// matching strings (iterations is the number of strings matched per regex)
+static void
+bench_match(unsigned long iterations)
+{
+  static const char *REGEXES[] = {
+    "\\d{3}-\\d{4}", "(a|b)*abb", "[a-z]+@[a-z]+\\.(com|org)", "^\\w+(\\.\\w+)*$",
+    "[A-Za-zÀ-ÿ ]{2,20}", "(ab|cd){20,40}"
+  };
+  static const unsigned int NUM_REGEXES = sizeof(REGEXES) / sizeof(REGEXES[0]);
+
+  for (unsigned int r = 0; r < NUM_REGEXES; r++) {
+    RegexMatcher matcher;
+    string status = build_matcher(REGEXES[r], matcher);
+    if (status.substr(0, 5) == "ERROR" || !matcher.is_supported()) {
+      cout << REGEXES[r] << ": not supported" << endl;
+      continue;
+    }
+
+    vector <string> strings = run_engine(REGEXES[r], "evil");
+    strings.erase(strings.begin());
+    RegexSampler sampler;
+    build_sampler(REGEXES[r], sampler, 0, 80, 8);
+    mt19937_64 rng(1);
+    string sample;
+    for (unsigned int i = 0; i < 1000 && sampler.sample(rng, sample); i++) {
+      strings.push_back(sample);
+    }
+
+    unsigned long bytes = 0;
+    unsigned long hits = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++) {
+      const string &str = strings[i % strings.size()];
+      if (matcher.matches(str)) hits++;
+      bytes += str.length();
+    }
+    double seconds = seconds_since(start);
+
+    cout << REGEXES[r] << " (" << matcher.get_num_positions() << " positions, "
+         << (matcher.is_single_word() ? "one word" : "multiword") << ", "
+         << hits * 100 / iterations << "% match)" << endl;
+    report("  strings", iterations, "strings", seconds);
+    report("  bytes", bytes, "bytes", seconds);
+  }
+}
+
+// times building the initial strings of the basis paths, which processes
+// every edge of every path (iterations / 10000 NFAs per regex, built with their
+// paths in batches before the timing starts so their edges are unprocessed)
+static void
+bench_paths(unsigned long iterations)
+{
+  static const char *REGEXES[] = {
+    "(GET|POST|PUT|DELETE|HEAD) /(api|v1|v2|static|img)/[a-z]+(/[a-z0-9_]+)*"
+      "\\.(php|html?|aspx?|jsp|cgi)(\\?[a-z]+=[^&]*(&[a-z]+=[^&]*)*)?",
+    "((a|b|c)(d|e)?[0-9]{2,4}|x+y*|\\w\\d\\s|(foo|bar|baz)+){1,6}",
+    "(Mon|Tue|Wed|Thu|Fri|Sat|Sun), [0-9]{2} (Jan|Feb|Mar|Apr|May|Jun|Jul|Aug|Sep|Oct|Nov|Dec) "
+      "[0-9]{4} ([01][0-9]|2[0-3]):[0-5][0-9]:[0-5][0-9] (GMT|UTC|[+-][0-9]{4})",
+    "([A-Za-z0-9._%+-]+|\"[^\"]*\")@([A-Za-z0-9-]+\\.)+(com|org|net|edu|gov|[a-z]{2})"
+  };
+  static const unsigned int NUM_REGEXES = sizeof(REGEXES) / sizeof(REGEXES[0]);
+  static const unsigned int BATCH = 100;
+
+  unsigned long runs = iterations / 10000;
+  if (runs == 0) runs = 1;
+
+  for (unsigned int r = 0; r < NUM_REGEXES; r++) {
+    unsigned long paths = 0;
+    unsigned long bytes = 0;
+    double seconds = 0;
+    for (unsigned long i = 0; i < runs; i += BATCH) {
+      unsigned int batch_size = (runs - i < BATCH) ? runs - i : BATCH;
+      vector <NFA *> nfas;
+      vector <PathTrie *> tries;
+      vector <vector <Path> > basis(batch_size);
+      for (unsigned int j = 0; j < batch_size; j++) {
+        Scanner scanner;
+        scanner.init(REGEXES[r]);
+        ParseTree tree;
+        tree.build(scanner);
+        nfas.push_back(new NFA());
+        nfas[j]->build(tree);
+        tries.push_back(new PathTrie());
+        basis[j] = nfas[j]->find_basis_paths(*tries[j]);
+      }
+
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      for (unsigned int j = 0; j < batch_size; j++) {
+        for (unsigned int k = 0; k < basis[j].size(); k++) {
+          bytes += basis[j][k].gen_initial_string("evil").length();
+        }
+        paths += basis[j].size();
+      }
+      seconds += seconds_since(start);
+
+      for (unsigned int j = 0; j < batch_size; j++) {
+        delete tries[j];
+        delete nfas[j];
+      }
+    }
+
+    cout << REGEXES[r] << " (" << paths / runs << " paths)" << endl;
+    report("  paths", paths, "paths", seconds);
+    report("  bytes", bytes, "bytes", seconds);
+  }
+}
+
+// times whole engine runs and counts the heap allocations of each run
+// (iterations / 10000 runs per regex)
+static void
+bench_pipeline(unsigned long iterations)
+{
+  static const char *REGEXES[] = {
+    "\\d{3}-\\d{4}", "(a|b)*abb", "[a-z]+@[a-z]+\\.(com|org)", "^\\w+(\\.\\w+)*$",
+    "([A-Z][a-z]+ ){1,3}[A-Z][a-z]+", "(ab|cd|ef|gh){2,5}x?[0-9a-f]{8}"
+  };
+  static const unsigned int NUM_REGEXES = sizeof(REGEXES) / sizeof(REGEXES[0]);
+
+  unsigned long runs = iterations / 10000;
+  if (runs == 0) runs = 1;
+
+  for (unsigned int r = 0; r < NUM_REGEXES; r++) {
+    unsigned long strings = 0;
+    unsigned long start_allocations = allocations;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned long i = 0; i < runs; i++) {
+      strings += run_engine(REGEXES[r], "evil").size() - 1;
+    }
+    double seconds = seconds_since(start);
+
+    cout << REGEXES[r] << " (" << strings / runs << " strings, "
+         << (allocations - start_allocations) / runs << " allocations per run)" << endl;
+    report("  runs", runs, "runs", seconds);
+  }
+}
+
+static char *
+get_arg(int &idx, int argc, char **argv)
+{
+  char *arg;
+
+  if (idx >= argc) {
+    cerr << "USAGE: Invalid command line" << endl << endl;
+    exit(-1);
+  }
+
+  arg = argv[idx];
+  idx++;
+
+  return arg;
+}
+
+static void
+usage()
+{
+  cout << "egret_bench [-b benchmark] [-n iterations]" << endl;
+  for (unsigned int i = 0; i < NUM_BENCHMARKS; i++) {
+    cout << "  " << left << setw(12) << BENCHMARKS[i].name << BENCHMARKS[i].description << endl;
+  }
+}
+
+static double
+seconds_since(chrono::steady_clock::time_point start)
+{
+  return chrono::duration <double>(chrono::steady_clock::now() - start).count();
+}
+
+static void
+report(const string &name, unsigned long count, const char *unit, double seconds)
+{
+  cout << left << setw(36) << name << right << setw(14) << fixed << setprecision(0)
+       << (seconds > 0 ? count / seconds : 0) << " " << unit << "/s" << endl;
+}
+
+static CharSet *
+make_class_set(CodePoint c, bool complement)
+{
+  CharSet *char_set = new CharSet();
+  CharSetItem item;
+  item.type = CHAR_CLASS_ITEM;
+  item.character = c;
+  char_set->add_item(item);
+  char_set->set_complement(complement);
+  return char_set;
+}
+
+static CharSet *
+make_range_set(const CodePoint ranges[][2], unsigned int num_ranges)
+{
+  CharSet *char_set = new CharSet();
+  for (unsigned int i = 0; i < num_ranges; i++) {
+    CharSetItem item;
+    item.type = CHAR_RANGE_ITEM;
+    item.range_start = ranges[i][0];
+    item.range_end = ranges[i][1];
+    char_set->add_item(item);
+  }
+  return char_set;
+}
@@ -20,25 +20,112 @@
 */
 
 #include <Python.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
 #include <string>
 #include <vector>
+#include "MemoryUsage.h"
+#include "RegexMatcher.h"
+#include "RegexSampler.h"
+#include "Trace.h"
 #include "egret.h"
+#include "error.h"
 using namespace std;
 
 static PyObject *EgretExtError;
 
+static const char *SESSION_NAME = "egret_ext.session";
+
+static void
+egret_free_session(PyObject *capsule)
+{
+  delete (EngineSession *) PyCapsule_GetPointer(capsule, SESSION_NAME);
+}
+
 static PyObject *
-egret_run(PyObject *self, PyObject *args)
+egret_new_session(PyObject *self, PyObject *args)
+{
+  return PyCapsule_New(new EngineSession(), SESSION_NAME, egret_free_session);
+}
+
+static PyObject *
+egret_set_memory_limit(PyObject *self, PyObject *args)
+{
+  unsigned long bytes;
+
+  if (!PyArg_ParseTuple(args, "k", &bytes))
+    return NULL;
+
+  setMemoryLimit(bytes);
+  Py_RETURN_NONE;
+}
+
+// parses the run arguments and runs the engine, returns false on a Python error
+static bool
+run_from_args(PyObject *args, vector <string> &tests)
 {
   const char *regex;
   const char *base_substring;
   int debug_mode;
   int stat_mode;
+  PyObject *session = Py_None;
+  int min_cover = 0;
+  int minimize = 0;
+  const char *mutations = "";
+  const char *trace_file = "";
 
-  if (!PyArg_ParseTuple(args, "sspp", &regex, &base_substring, &debug_mode, &stat_mode))
-    return NULL;
+  if (!PyArg_ParseTuple(args, "sspp|Oppss", &regex, &base_substring, &debug_mode, &stat_mode,
+        &session, &min_cover, &minimize, &mutations, &trace_file))
+    return false;
 
-  vector <string> tests = run_engine(regex, base_substring, debug_mode, stat_mode);
+  EngineOptions options;
+  if (min_cover) options.traversal = MIN_COVER_TRAVERSAL;
+  options.minimize = minimize;
+  if (!options.set_mutations(mutations)) {
+    PyErr_SetString(EgretExtError, (string("Unknown mutations ") + mutations).c_str());
+    return false;
+  }
+
+  // a trace file gets the Chrome trace of the run
+  if (trace_file[0] != '\0') startTrace();
+
+  if (session == Py_None) {
+    tests = run_engine(regex, base_substring, debug_mode, stat_mode, options);
+  }
+  else {
+    EngineSession *engine_session =
+      (EngineSession *) PyCapsule_GetPointer(session, SESSION_NAME);
+    if (engine_session == NULL) {
+      stopTrace();
+      return false;
+    }
+    tests = run_engine(regex, base_substring, *engine_session, debug_mode, stat_mode,
+        options);
+  }
+
+  if (trace_file[0] != '\0') {
+    stopTrace();
+    FILE *file = fopen(trace_file, "w");
+    if (file == NULL) {
+      PyErr_SetFromErrnoWithFilename(PyExc_OSError, trace_file);
+      return false;
+    }
+    string json = getTraceJson();
+    fwrite(json.data(), 1, json.length(), file);
+    fclose(file);
+  }
+
+  return true;
+}
+
+static PyObject *
+egret_run(PyObject *self, PyObject *args)
+{
+  vector <string> tests;
+  if (!run_from_args(args, tests))
+    return NULL;
 
   PyObject *list = PyList_New(0);
   vector <string>::iterator it;
@@ -49,8 +136,362 @@ egret_run(PyObject *self, PyObject *args)
   return list;
 }
 
+// Returns a dict with the strings packed into one bytes object:
+//   status	- "SUCCESS", "WARNING" or "ERROR"
+//   error	- error message (None unless status is "ERROR")
+//   warnings	- list of warning messages
+//   data	- bytes holding every string back to back
+//   offsets	- memoryview of unsigned 64-bit offsets, string i is
+//		  data[offsets[i]:offsets[i + 1]] (len(offsets) is count + 1)
+// No per-string Python objects are created.
+static PyObject *
+egret_run_buffer(PyObject *self, PyObject *args)
+{
+  vector <string> tests;
+  if (!run_from_args(args, tests))
+    return NULL;
+
+  // split status into error or warnings
+  string status = tests[0];
+  const char *status_str = "SUCCESS";
+  PyObject *error = Py_None;
+  Py_INCREF(Py_None);
+  PyObject *warnings = PyList_New(0);
+  if (status.substr(0, 5) == "ERROR") {
+    status_str = "ERROR";
+    Py_DECREF(error);
+    error = PyUnicode_FromString(status.c_str());
+  }
+  else if (status != "SUCCESS") {
+    status_str = "WARNING";
+    size_t start = 0;
+    size_t end;
+    while ((end = status.find('\n', start)) != string::npos) {
+      if (end > start) {
+        PyObject *warning = PyUnicode_FromStringAndSize(status.data() + start, end - start);
+        PyList_Append(warnings, warning);
+        Py_DECREF(warning);
+      }
+      start = end + 1;
+    }
+  }
+
+  // pack the strings into a single buffer
+  size_t count = tests.size() - 1;
+  size_t total = 0;
+  for (size_t i = 1; i < tests.size(); i++) total += tests[i].length();
+
+  PyObject *data = PyBytes_FromStringAndSize(NULL, total);
+  PyObject *offset_bytes = PyBytes_FromStringAndSize(NULL, (count + 1) * sizeof(uint64_t));
+  char *data_ptr = PyBytes_AS_STRING(data);
+  uint64_t *offset_ptr = (uint64_t *) PyBytes_AS_STRING(offset_bytes);
+  uint64_t offset = 0;
+  for (size_t i = 0; i < count; i++) {
+    const string &str = tests[i + 1];
+    offset_ptr[i] = offset;
+    memcpy(data_ptr + offset, str.data(), str.length());
+    offset += str.length();
+  }
+  offset_ptr[count] = offset;
+
+  PyObject *view = PyMemoryView_FromObject(offset_bytes);
+  PyObject *offsets = PyObject_CallMethod(view, "cast", "s", "Q");
+  Py_DECREF(view);
+  Py_DECREF(offset_bytes);
+  if (offsets == NULL) {
+    Py_DECREF(data);
+    Py_DECREF(error);
+    Py_DECREF(warnings);
+    return NULL;
+  }
+
+  return Py_BuildValue("{s:s,s:N,s:N,s:N,s:N}", "status", status_str, "error", error,
+      "warnings", warnings, "data", data, "offsets", offsets);
+}
+
+// Returns a dict with the predicted output of run:
+//   paths	- number of paths
+//   strings	- number of strings (duplicates are counted)
+//   bytes	- total length of the strings
+//   warnings	- list of warning messages
+static PyObject *
+egret_estimate(PyObject *self, PyObject *args)
+{
+  const char *regex;
+  const char *base_substring = "evil";
+  int min_cover = 0;
+
+  if (!PyArg_ParseTuple(args, "s|sp", &regex, &base_substring, &min_cover))
+    return NULL;
+
+  EngineOptions options;
+  if (min_cover) options.traversal = MIN_COVER_TRAVERSAL;
+
+  TestEstimate estimate;
+  string status = estimate_engine(regex, estimate, base_substring, options);
+  if (status.substr(0, 5) == "ERROR") {
+    PyErr_SetString(EgretExtError, status.c_str());
+    return NULL;
+  }
+
+  PyObject *warnings = PyList_New(0);
+  if (status != "SUCCESS") {
+    size_t start = 0;
+    size_t end;
+    while ((end = status.find('\n', start)) != string::npos) {
+      if (end > start) {
+        PyObject *warning = PyUnicode_FromStringAndSize(status.data() + start, end - start);
+        PyList_Append(warnings, warning);
+        Py_DECREF(warning);
+      }
+      start = end + 1;
+    }
+  }
+
+  return Py_BuildValue("{s:k,s:k,s:k,s:N}", "paths", estimate.paths, "strings",
+      estimate.strings, "bytes", estimate.bytes, "warnings", warnings);
+}
+
+static PyObject *
+egret_classify(PyObject *self, PyObject *args)
+{
+  const char *regex;
+  PyObject *strings;
+
+  if (!PyArg_ParseTuple(args, "sO", &regex, &strings))
+    return NULL;
+
+  PyObject *seq = PySequence_Fast(strings, "strings must be a sequence");
+  if (seq == NULL)
+    return NULL;
+
+  // None tells the caller to fall back to the re module
+  RegexMatcher matcher;
+  string status = build_matcher(regex, matcher);
+  if (status.substr(0, 5) == "ERROR") {
+    Py_DECREF(seq);
+    PyErr_SetString(EgretExtError, status.c_str());
+    return NULL;
+  }
+  if (!matcher.is_supported()) {
+    Py_DECREF(seq);
+    Py_RETURN_NONE;
+  }
+
+  Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+  PyObject *result = PyList_New(count);
+  string str;
+  try {
+    for (Py_ssize_t i = 0; i < count; i++) {
+      Py_ssize_t length;
+      const char *data = PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(seq, i), &length);
+      if (data == NULL) {
+        Py_DECREF(result);
+        Py_DECREF(seq);
+        return NULL;
+      }
+      str.assign(data, length);
+      PyObject *match = matcher.matches(str) ? Py_True : Py_False;
+      Py_INCREF(match);
+      PyList_SET_ITEM(result, i, match);
+    }
+  }
+  catch (EgretException const &e) {
+    Py_DECREF(result);
+    Py_DECREF(seq);
+    PyErr_SetString(EgretExtError, e.getError().c_str());
+    return NULL;
+  }
+
+  Py_DECREF(seq);
+  return result;
+}
+
+// Returns (names, results) where names has the name of each capturing group
+// (None if unnamed) and results has, for each string, None if the regex does
+// not fully match it or a tuple with the (start, end) span of each group (None
+// for a group that did not take part).  Returns None if the re module must
+// decide instead.
+static PyObject *
+egret_match(PyObject *self, PyObject *args)
+{
+  const char *regex;
+  PyObject *strings;
+
+  if (!PyArg_ParseTuple(args, "sO", &regex, &strings))
+    return NULL;
+
+  PyObject *seq = PySequence_Fast(strings, "strings must be a sequence");
+  if (seq == NULL)
+    return NULL;
+
+  RegexMatcher matcher;
+  string status = build_matcher(regex, matcher);
+  if (status.substr(0, 5) == "ERROR") {
+    Py_DECREF(seq);
+    PyErr_SetString(EgretExtError, status.c_str());
+    return NULL;
+  }
+  if (!matcher.is_supported()) {
+    Py_DECREF(seq);
+    Py_RETURN_NONE;
+  }
+
+  const vector <string> &group_names = matcher.get_group_names();
+  PyObject *names = PyList_New(group_names.size());
+  for (unsigned int g = 0; g < group_names.size(); g++) {
+    PyObject *name = Py_None;
+    if (group_names[g] != "") {
+      name = PyUnicode_FromStringAndSize(group_names[g].data(), group_names[g].length());
+    }
+    else {
+      Py_INCREF(name);
+    }
+    PyList_SET_ITEM(names, g, name);
+  }
+
+  Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+  PyObject *results = PyList_New(count);
+  bool gave_up = false;
+  string str;
+  vector <int> spans;
+  try {
+    for (Py_ssize_t i = 0; i < count && !gave_up; i++) {
+      Py_ssize_t length;
+      const char *data = PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(seq, i), &length);
+      if (data == NULL) {
+        Py_DECREF(results);
+        Py_DECREF(names);
+        Py_DECREF(seq);
+        return NULL;
+      }
+      str.assign(data, length);
+
+      if (!matcher.matches(str)) {
+        Py_INCREF(Py_None);
+        PyList_SET_ITEM(results, i, Py_None);
+        continue;
+      }
+      if (!matcher.find_groups(str, spans)) {
+        gave_up = true;
+        Py_INCREF(Py_None);
+        PyList_SET_ITEM(results, i, Py_None);
+        continue;
+      }
+
+      PyObject *groups = PyTuple_New(group_names.size());
+      for (unsigned int g = 0; g < group_names.size(); g++) {
+        PyObject *span = Py_None;
+        if (spans[2 * g] != -1) span = Py_BuildValue("(ii)", spans[2 * g], spans[2 * g + 1]);
+        else Py_INCREF(span);
+        PyTuple_SET_ITEM(groups, g, span);
+      }
+      PyList_SET_ITEM(results, i, groups);
+    }
+  }
+  catch (EgretException const &e) {
+    Py_DECREF(results);
+    Py_DECREF(names);
+    Py_DECREF(seq);
+    PyErr_SetString(EgretExtError, e.getError().c_str());
+    return NULL;
+  }
+  Py_DECREF(seq);
+
+  // a string whose groups could not be found leaves it all to re
+  if (gave_up) {
+    Py_DECREF(results);
+    Py_DECREF(names);
+    Py_RETURN_NONE;
+  }
+  return Py_BuildValue("(NN)", names, results);
+}
+
+// iterator that yields random strings matching a regex forever
+typedef struct {
+  PyObject_HEAD
+  RegexSampler *sampler;	// precomputed counts
+  mt19937_64 *rng;		// random number generator
+  string *buffer;		// reused for each string
+} SamplerObject;
+
+static void
+sampler_dealloc(SamplerObject *self)
+{
+  delete self->sampler;
+  delete self->rng;
+  delete self->buffer;
+  Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+sampler_next(SamplerObject *self)
+{
+  if (!self->sampler->sample(*self->rng, *self->buffer))
+    return NULL;
+  return PyUnicode_FromStringAndSize(self->buffer->data(), self->buffer->length());
+}
+
+static PyTypeObject SamplerType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "egret_ext.Sampler",		/* tp_name */
+  sizeof(SamplerObject),	/* tp_basicsize */
+};
+
+static PyObject *
+egret_sampler(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+  static const char *keywords[] = {"regex", "seed", "min_length", "max_length",
+    "loop_cap", NULL};
+  const char *regex;
+  unsigned long long seed = 0;
+  unsigned int min_length = 0;
+  unsigned int max_length = 32;
+  unsigned int loop_cap = 8;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|KIII", (char **) keywords, &regex,
+        &seed, &min_length, &max_length, &loop_cap))
+    return NULL;
+
+  RegexSampler *sampler = new RegexSampler();
+  string status = build_sampler(regex, *sampler, min_length, max_length, loop_cap);
+  if (status.substr(0, 5) == "ERROR") {
+    delete sampler;
+    PyErr_SetString(EgretExtError, status.c_str());
+    return NULL;
+  }
+  if (sampler->get_count() == 0) {
+    delete sampler;
+    PyErr_SetString(EgretExtError, "ERROR: No strings within the length bounds");
+    return NULL;
+  }
+
+  SamplerObject *obj = PyObject_New(SamplerObject, &SamplerType);
+  if (obj == NULL) {
+    delete sampler;
+    return NULL;
+  }
+  obj->sampler = sampler;
+  obj->rng = new mt19937_64(seed);
+  obj->buffer = new string();
+  return (PyObject *) obj;
+}
+
 static PyMethodDef EgretExtMethods[] = {
   {"run", egret_run, METH_VARARGS, "Run EGRET."},
+  {"run_buffer", egret_run_buffer, METH_VARARGS,
+    "Run EGRET, returning the strings in one buffer plus an offsets array."},
+  {"new_session", egret_new_session, METH_NOARGS, "Create a session for incremental runs."},
+  {"set_memory_limit", egret_set_memory_limit, METH_VARARGS,
+    "Set the memory limit in bytes for each run (0 for no limit)."},
+  {"estimate", egret_estimate, METH_VARARGS,
+    "Predict the paths, strings and bytes run would produce without running it."},
+  {"classify", egret_classify, METH_VARARGS,
+    "Return whether the regex fully matches each string (None if the re module must decide)."},
+  {"match", egret_match, METH_VARARGS,
+    "Return the group names and, for each string, its group spans if the regex fully matches it."},
+  {"sampler", (PyCFunction) egret_sampler, METH_VARARGS | METH_KEYWORDS,
+    "Return an endless iterator of uniformly drawn strings matching a regex."},
   {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
@@ -70,6 +511,14 @@ extern "C" {
   {
     PyObject *m;
 
+    SamplerType.tp_dealloc = (destructor) sampler_dealloc;
+    SamplerType.tp_flags = Py_TPFLAGS_DEFAULT;
+    SamplerType.tp_doc = "Iterator of random strings matching a regex";
+    SamplerType.tp_iter = PyObject_SelfIter;
+    SamplerType.tp_iternext = (iternextfunc) sampler_next;
+    if (PyType_Ready(&SamplerType) < 0)
+      return NULL;
+
     m = PyModule_Create(&egret_extmodule);
     if (m == NULL)
       return NULL;
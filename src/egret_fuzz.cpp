@@ -0,0 +1,429 @@
+/*  egret_fuzz.cpp: searches for regexes that make the engine itself slow
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Unlike a crash fuzzer, the objective here is cost: each candidate regex is
+// scored by how much work the engine does per byte of regex (run time, NFA
+// states, paths or output bytes).  Starting from the benchmark corpus, the
+// fuzzer mutates the best scoring regexes it has seen, then minimizes the
+// worst ones found and writes them as JSON jobs to an output file (not the
+// corpus, which is only changed by appending reviewed results to it) so that
+// they can be replayed with degret --serve-stdin or egret_load -f.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "JobServer.h"
+#include "MemoryUsage.h"
+#include "Stats.h"
+#include "egret.h"
+#include "error.h"
+#include "json.h"
+using namespace std;
+
+typedef enum
+{
+  TIME_OBJECTIVE,
+  STATES_OBJECTIVE,
+  PATHS_OBJECTIVE,
+  BYTES_OBJECTIVE
+} Objective;
+
+struct Candidate
+{
+  string regex;		// regex being scored
+  double cost;		// engine cost for the objective
+  double score;		// cost per byte of regex
+};
+
+// pieces of regex syntax used by the mutations
+static const char *FRAGMENTS[] = {
+  "a", "b", "x", "|", "(", ")", "*", "+", "?", "{2,5}", "{9}", "{3,}",
+  "[a-z]", "[^ab]", "\\d", "\\w", "\\s", ".", "^", "$", "(a|b)", "(?:", ")*",
+  "-", "@", "\\."
+};
+static const unsigned int NUM_FRAGMENTS = sizeof(FRAGMENTS) / sizeof(FRAGMENTS[0]);
+
+// regexes used when the corpus is empty
+static const char *SEEDS[] = {
+  "(a|b)*c", "\\d+\\.\\d+", "[a-z]+@[a-z]+\\.com", "(ab|cd){2,4}", "^x?y*z+$"
+};
+static const unsigned int NUM_SEEDS = sizeof(SEEDS) / sizeof(SEEDS[0]);
+
+static const unsigned int POOL_SIZE = 32;	// candidates kept for mutation
+static const unsigned int TIMING_RUNS = 3;	// runs timed when confirming a cost
+static const unsigned int MIN_SCORE_LENGTH = 8;	// shorter regexes score as this long
+
+static Objective objective = TIME_OBJECTIVE;
+static string base_substring = "evil";
+static unsigned int max_length = 64;
+static mt19937 rng;
+
+static char *get_arg(int &idx, int argc, char **argv);
+static bool read_corpus(const char *file_name, vector <string> &regexes);
+static bool measure(const string &regex, unsigned int runs, double &cost);
+static bool score(const string &regex, unsigned int runs, Candidate &candidate);
+static string mutate(const vector <Candidate> &pool);
+static void add_to_pool(vector <Candidate> &pool, const Candidate &candidate);
+static Candidate minimize(const Candidate &candidate);
+static string objective_name();
+static unsigned int random_index(unsigned int limit);
+
+int
+main(int argc, char *argv[])
+{
+  int idx = 1;
+  const char *corpus_file = "bench/slow_jobs.jsonl";
+  const char *output_file = "fuzz_found.jsonl";
+  unsigned long iterations = 2000;
+  unsigned int num_saved = 3;
+  unsigned long seed = 1;
+
+  // keep a single run from taking down the fuzzer
+  setMemoryLimit(256UL * 1024 * 1024);
+
+  // Process arguments
+  while (idx < argc) {
+
+    char *arg = get_arg(idx, argc, argv);
+
+    // -c: benchmark corpus to read seeds from
+    if (strcmp(arg, "-c") == 0) {
+      corpus_file = get_arg(idx, argc, argv);
+    }
+
+    // -O: file the regexes found are written to (replacing its contents)
+    else if (strcmp(arg, "-O") == 0) {
+      output_file = get_arg(idx, argc, argv);
+    }
+
+    // -n: number of mutated regexes to try
+    else if (strcmp(arg, "-n") == 0) {
+      iterations = atol(get_arg(idx, argc, argv));
+    }
+
+    // -o: objective (time, states, paths or bytes)
+    else if (strcmp(arg, "-o") == 0) {
+      string name = get_arg(idx, argc, argv);
+      if (name == "time") objective = TIME_OBJECTIVE;
+      else if (name == "states") objective = STATES_OBJECTIVE;
+      else if (name == "paths") objective = PATHS_OBJECTIVE;
+      else if (name == "bytes") objective = BYTES_OBJECTIVE;
+      else {
+        cerr << "USAGE: Unknown objective " << name << endl;
+        return -1;
+      }
+    }
+
+    // -l: maximum regex length
+    else if (strcmp(arg, "-l") == 0) {
+      max_length = atoi(get_arg(idx, argc, argv));
+    }
+
+    // -k: number of minimized regexes to save
+    else if (strcmp(arg, "-k") == 0) {
+      num_saved = atoi(get_arg(idx, argc, argv));
+    }
+
+    // -m: memory limit in bytes for each run
+    else if (strcmp(arg, "-m") == 0) {
+      setMemoryLimit(strtoul(get_arg(idx, argc, argv), NULL, 10));
+    }
+
+    // -S: random seed
+    else if (strcmp(arg, "-S") == 0) {
+      seed = strtoul(get_arg(idx, argc, argv), NULL, 10);
+    }
+
+    // everything else is invalid
+    else {
+      cerr << "USAGE: Invalid command line option: " << arg << endl;
+      return -1;
+    }
+  }
+  rng.seed(seed);
+
+  // score the corpus
+  vector <string> corpus;
+  if (!read_corpus(corpus_file, corpus)) {
+    cerr << "USAGE: Unable to read corpus " << corpus_file << endl;
+    return -1;
+  }
+  set <string> known(corpus.begin(), corpus.end());
+  if (corpus.empty()) corpus.assign(SEEDS, SEEDS + NUM_SEEDS);
+
+  vector <Candidate> pool;
+  vector <string>::iterator it;
+  for (it = corpus.begin(); it != corpus.end(); it++) {
+    Candidate candidate;
+    if (score(*it, TIMING_RUNS, candidate)) add_to_pool(pool, candidate);
+  }
+  if (pool.empty()) {
+    cerr << "No corpus regex could be run" << endl;
+    return -1;
+  }
+  double corpus_best = pool[0].score;
+
+  // mutate the best candidates
+  for (unsigned long i = 0; i < iterations; i++) {
+    Candidate candidate;
+    if (!score(mutate(pool), 1, candidate)) continue;
+
+    // confirm noisy timings before letting a candidate into the pool
+    if (objective == TIME_OBJECTIVE && pool.size() == POOL_SIZE &&
+        candidate.score > pool.back().score) {
+      if (!score(candidate.regex, TIMING_RUNS, candidate)) continue;
+    }
+    add_to_pool(pool, candidate);
+  }
+
+  // minimize and save the worst new regexes
+  ofstream outputFile(output_file);
+  if (!outputFile.is_open()) {
+    cerr << "USAGE: Unable to write " << output_file << endl;
+    return -1;
+  }
+
+  const int WIDTH = 30;
+  cout << left << fixed << setprecision(3);
+  cout << setw(WIDTH) << "Objective" << "| " << objective_name() << " per byte" << endl;
+  cout << setw(WIDTH) << "Best corpus score" << "| " << corpus_best << endl;
+
+  unsigned int saved = 0;
+  for (unsigned int i = 0; i < pool.size() && saved < num_saved; i++) {
+    if (pool[i].score <= corpus_best) break;
+
+    Candidate worst = minimize(pool[i]);
+    if (known.find(worst.regex) != known.end()) continue;
+    known.insert(worst.regex);
+
+    outputFile << "{\"regex\":" << json_string(worst.regex)
+      << ",\"base_substring\":" << json_string(base_substring)
+      << ",\"objective\":" << json_string(objective_name())
+      << ",\"cost\":" << worst.cost << "}" << endl;
+    cout << setw(WIDTH) << "Saved (score " + to_string(worst.score) + ")"
+      << "| " << worst.regex << endl;
+    saved++;
+  }
+  if (saved == 0) cout << "No regex beat the corpus" << endl;
+
+  return 0;
+}
+
+static char *
+get_arg(int &idx, int argc, char **argv)
+{
+  char *arg;
+
+  if (idx >= argc) {
+    cerr << "USAGE: Invalid command line" << endl << endl;
+    exit(-1);
+  }
+
+  arg = argv[idx];
+  idx++;
+
+  return arg;
+}
+
+// reads the regexes from a corpus of JSON jobs (a missing corpus is empty)
+static bool
+read_corpus(const char *file_name, vector <string> &regexes)
+{
+  ifstream corpusFile(file_name);
+  if (!corpusFile.is_open()) return true;
+
+  string line;
+  while (getline(corpusFile, line)) {
+    if (line == "") continue;
+    try {
+      JobRequest job;
+      parse_json_job(line, job);
+      regexes.push_back(job.regex);
+    }
+    catch (EgretException const &e) {
+      cerr << file_name << ": " << e.getError() << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// runs the engine on regex and returns its cost (false if the regex is invalid)
+static bool
+measure(const string &regex, unsigned int runs, double &cost)
+{
+  cost = 0;
+  for (unsigned int i = 0; i < runs; i++) {
+    Stats stats;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector <string> result = run_engine(regex, base_substring, stats);
+    chrono::duration <double, micro> elapsed = chrono::steady_clock::now() - start;
+
+    if (result[0].substr(0, 5) == "ERROR") return false;
+
+    double run_cost = 0;
+    switch (objective) {
+    case TIME_OBJECTIVE:
+      run_cost = elapsed.count();
+      break;
+    case STATES_OBJECTIVE:
+      run_cost = stats.get("NFA states");
+      break;
+    case PATHS_OBJECTIVE:
+      run_cost = stats.get("Paths");
+      break;
+    case BYTES_OBJECTIVE:
+      for (unsigned int j = 1; j < result.size(); j++) run_cost += result[j].length();
+      break;
+    }
+
+    // the fastest run is the least noisy timing
+    if (i == 0 || run_cost < cost) cost = run_cost;
+  }
+  return true;
+}
+
+static bool
+score(const string &regex, unsigned int runs, Candidate &candidate)
+{
+  if (regex == "" || regex.length() > max_length) return false;
+
+  candidate.regex = regex;
+  if (!measure(regex, runs, candidate.cost)) return false;
+  // without a floor, trivial one character regexes score the best
+  candidate.score = candidate.cost / max((unsigned int) regex.length(), MIN_SCORE_LENGTH);
+  return true;
+}
+
+// returns a mutation of a random candidate in the pool
+static string
+mutate(const vector <Candidate> &pool)
+{
+  string regex = pool[random_index(pool.size())].regex;
+  unsigned int pos = random_index(regex.length() + 1);
+  unsigned int len = 1 + random_index(4);
+  string fragment = FRAGMENTS[random_index(NUM_FRAGMENTS)];
+
+  switch (random_index(5)) {
+
+  // insert a fragment
+  case 0:
+    regex.insert(pos, fragment);
+    break;
+
+  // replace a character with a fragment
+  case 1:
+    if (pos < regex.length()) regex.replace(pos, 1, fragment);
+    break;
+
+  // delete a range
+  case 2:
+    if (pos < regex.length()) regex.erase(pos, len);
+    break;
+
+  // duplicate a range
+  case 3:
+    if (pos < regex.length()) regex.insert(pos, regex.substr(pos, len));
+    break;
+
+  // splice with another candidate
+  case 4:
+  {
+    const string &other = pool[random_index(pool.size())].regex;
+    unsigned int other_pos = random_index(other.length() + 1);
+    regex = regex.substr(0, pos) + other.substr(other_pos);
+    break;
+  }
+  }
+
+  return regex;
+}
+
+// adds a candidate to the pool (sorted by decreasing score)
+static void
+add_to_pool(vector <Candidate> &pool, const Candidate &candidate)
+{
+  vector <Candidate>::iterator it;
+  for (it = pool.begin(); it != pool.end(); it++) {
+    if (it->regex == candidate.regex) return;
+  }
+
+  for (it = pool.begin(); it != pool.end(); it++) {
+    if (candidate.score > it->score) break;
+  }
+  pool.insert(it, candidate);
+  if (pool.size() > POOL_SIZE) pool.pop_back();
+}
+
+// removes characters from the regex while the cost and score do not drop
+static Candidate
+minimize(const Candidate &candidate)
+{
+  unsigned int runs = (objective == TIME_OBJECTIVE) ? TIMING_RUNS : 1;
+
+  Candidate best;
+  if (!score(candidate.regex, runs, best)) return candidate;
+
+  for (unsigned int len = 4; len >= 1; len /= 2) {
+    unsigned int pos = 0;
+    while (pos < best.regex.length()) {
+      string smaller = best.regex;
+      smaller.erase(pos, len);
+
+      Candidate trial;
+      if (score(smaller, runs, trial) && trial.cost >= candidate.cost * 0.9 &&
+          trial.score >= best.score) {
+        best = trial;
+      }
+      else {
+        pos++;
+      }
+    }
+  }
+  return best;
+}
+
+static string
+objective_name()
+{
+  switch (objective) {
+  case TIME_OBJECTIVE:		return "time_us";
+  case STATES_OBJECTIVE:	return "states";
+  case PATHS_OBJECTIVE:		return "paths";
+  case BYTES_OBJECTIVE:		return "bytes";
+  }
+  return "";
+}
+
+static unsigned int
+random_index(unsigned int limit)
+{
+  return uniform_int_distribution <unsigned int>(0, limit - 1)(rng);
+}
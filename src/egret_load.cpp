@@ -0,0 +1,192 @@
+/*  egret_load.cpp: load generator for the EGRET engine daemon
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Opens several connections to egretd and sends jobs round robin from a job
+// file (or a single regex) until the requested number of jobs is done, then
+// reports throughput and latency percentiles.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "UnixSocket.h"
+#include "error.h"
+#include "json.h"
+using namespace std;
+
+static vector <string> job_lines;		// jobs to send
+static atomic <unsigned long> next_job(0);	// index of next job to send
+static unsigned long total_jobs = 10000;	// number of jobs to send
+
+static char *get_arg(int &idx, int argc, char **argv);
+static void client(string socket_path, vector <double> *latencies, unsigned long *errors);
+
+int
+main(int argc, char *argv[])
+{
+  int idx = 1;
+  string socket_path = "/tmp/egretd.sock";
+  unsigned int num_connections = 8;
+
+  // Process arguments
+  while (idx < argc) {
+
+    char *arg = get_arg(idx, argc, argv);
+
+    // -s: socket path
+    if (strcmp(arg, "-s") == 0) {
+      socket_path = get_arg(idx, argc, argv);
+    }
+
+    // -c: number of connections
+    else if (strcmp(arg, "-c") == 0) {
+      num_connections = atoi(get_arg(idx, argc, argv));
+    }
+
+    // -n: number of jobs to send
+    else if (strcmp(arg, "-n") == 0) {
+      total_jobs = atol(get_arg(idx, argc, argv));
+    }
+
+    // -r: regular expression to send
+    else if (strcmp(arg, "-r") == 0) {
+      job_lines.push_back("{\"regex\":" + json_string(get_arg(idx, argc, argv)) + "}");
+    }
+
+    // -f: file of JSON jobs to send
+    else if (strcmp(arg, "-f") == 0) {
+      char *file_name = get_arg(idx, argc, argv);
+      ifstream jobFile(file_name);
+      if (!jobFile.is_open()) {
+        cerr << "USAGE: Unable to open file " << file_name << endl;
+        return -1;
+      }
+      string line;
+      while (getline(jobFile, line)) {
+        if (line != "") job_lines.push_back(line);
+      }
+    }
+
+    // everything else is invalid
+    else {
+      cerr << "USAGE: Invalid command line option: " << arg << endl;
+      return -1;
+    }
+  }
+
+  if (job_lines.empty()) {
+    cerr << "USAGE: Did not find any jobs to send (use -r or -f)" << endl;
+    return -1;
+  }
+  if (num_connections == 0) num_connections = 1;
+
+  vector <vector <double> > latencies(num_connections);
+  vector <unsigned long> errors(num_connections, 0);
+  vector <thread> clients;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (unsigned int i = 0; i < num_connections; i++) {
+    clients.push_back(thread(client, socket_path, &latencies[i], &errors[i]));
+  }
+  for (unsigned int i = 0; i < num_connections; i++) {
+    clients[i].join();
+  }
+  chrono::duration <double> elapsed = chrono::steady_clock::now() - start;
+
+  // merge the results
+  vector <double> all;
+  unsigned long error_count = 0;
+  for (unsigned int i = 0; i < num_connections; i++) {
+    all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    error_count += errors[i];
+  }
+  if (all.empty()) {
+    cerr << "No jobs completed" << endl;
+    return -1;
+  }
+  sort(all.begin(), all.end());
+
+  const int WIDTH = 30;
+  cout << left << fixed << setprecision(3);
+  cout << setw(WIDTH) << "Jobs" << "| " << all.size() << endl;
+  cout << setw(WIDTH) << "Errors" << "| " << error_count << endl;
+  cout << setw(WIDTH) << "Connections" << "| " << num_connections << endl;
+  cout << setw(WIDTH) << "Elapsed (s)" << "| " << elapsed.count() << endl;
+  cout << setw(WIDTH) << "Throughput (jobs/s)" << "| " << all.size() / elapsed.count() << endl;
+  cout << setw(WIDTH) << "Latency p50 (ms)" << "| " << all[all.size() / 2] << endl;
+  cout << setw(WIDTH) << "Latency p99 (ms)" << "| " << all[(all.size() * 99) / 100] << endl;
+  cout << setw(WIDTH) << "Latency max (ms)" << "| " << all.back() << endl;
+
+  return 0;
+}
+
+static void
+client(string socket_path, vector <double> *latencies, unsigned long *errors)
+{
+  int fd;
+  try {
+    fd = connect_unix(socket_path);
+  }
+  catch (EgretException const &e) {
+    cerr << e.getError() << endl;
+    return;
+  }
+  SocketLines conn(fd);
+
+  while (true) {
+    unsigned long job = next_job++;
+    if (job >= total_jobs) break;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    string result;
+    if (!conn.write_line(job_lines[job % job_lines.size()]) || !conn.read_line(result)) {
+      (*errors)++;
+      break;
+    }
+    chrono::duration <double, milli> elapsed = chrono::steady_clock::now() - start;
+    latencies->push_back(elapsed.count());
+
+    if (result.find("\"status\":\"ERROR\"") != string::npos) (*errors)++;
+  }
+}
+
+static char *
+get_arg(int &idx, int argc, char **argv)
+{
+  char *arg;
+
+  if (idx >= argc) {
+    cerr << "USAGE: Invalid command line" << endl << endl;
+    exit(-1);
+  }
+
+  arg = argv[idx];
+  idx++;
+
+  return arg;
+}
@@ -0,0 +1,331 @@
+/*  egretd.cpp: EGRET engine daemon serving jobs over a Unix domain socket
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Clients send JSON jobs (see JobServer.h) one per line and receive one result
+// line per job, in order.  Jobs are run by a fixed pool of workers fed by a
+// bounded queue; once the queue is full, connections stop reading until a
+// worker frees a slot.  Jobs for a (regex, base substring) pair that is
+// already queued or running are not queued again - they wait for the running
+// job and share its result.  Sending {"command": "stats"} returns counters.
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "EngineOptions.h"
+#include "JobServer.h"
+#include "MemoryUsage.h"
+#include "UnixSocket.h"
+#include "WorkQueue.h"
+#include "error.h"
+#include "json.h"
+using namespace std;
+
+// a job being computed on behalf of one or more requests
+struct Computation
+{
+  string key;			// coalescing key
+  string regex;			// regex to process
+  string base_substring;	// base substring for regex strings
+  EngineOptions options;	// engine options
+  bool done;			// set once fields is filled in
+  string fields;		// result fields
+  mutex lock;			// protects done and fields
+  condition_variable finished;	// signaled when done is set
+};
+
+typedef shared_ptr <Computation> ComputationPtr;
+
+static WorkQueue <ComputationPtr> *jobs;		// jobs waiting for a worker
+static map <string, ComputationPtr> in_flight;		// queued or running jobs
+static mutex in_flight_lock;				// protects in_flight
+
+static unsigned int max_connections = 256;
+static unsigned int max_line_length = 1 << 20;
+static atomic <unsigned int> connections(0);
+static atomic <unsigned long> request_count(0);
+static atomic <unsigned long> computed_count(0);
+static atomic <unsigned long> coalesced_count(0);
+static atomic <unsigned long> rejected_count(0);
+
+static char *get_arg(int &idx, int argc, char **argv);
+static void worker();
+static void serve_connection(int fd);
+static string submit(const JobRequest &job);
+static string stats_fields();
+
+int
+main(int argc, char *argv[])
+{
+  int idx = 1;
+  string socket_path = "/tmp/egretd.sock";
+  unsigned int num_workers = thread::hardware_concurrency();
+  unsigned int queue_size = 0;
+
+  // Process arguments
+  while (idx < argc) {
+
+    char *arg = get_arg(idx, argc, argv);
+
+    // -s: socket path
+    if (strcmp(arg, "-s") == 0) {
+      socket_path = get_arg(idx, argc, argv);
+    }
+
+    // -j: number of worker threads
+    else if (strcmp(arg, "-j") == 0) {
+      char *workers = get_arg(idx, argc, argv);
+      if (!parse_count(workers, num_workers) || num_workers == 0) {
+        cerr << "USAGE: Invalid number of workers " << workers << " (expected a positive integer)" << endl;
+        return -1;
+      }
+    }
+
+    // -q: number of jobs that can wait for a worker (0 for 4 per worker)
+    else if (strcmp(arg, "-q") == 0) {
+      char *size = get_arg(idx, argc, argv);
+      if (!parse_count(size, queue_size)) {
+        cerr << "USAGE: Invalid queue size " << size << " (expected a non-negative integer)" << endl;
+        return -1;
+      }
+    }
+
+    // -c: maximum number of open connections
+    else if (strcmp(arg, "-c") == 0) {
+      char *limit = get_arg(idx, argc, argv);
+      if (!parse_count(limit, max_connections) || max_connections == 0) {
+        cerr << "USAGE: Invalid connection limit " << limit << " (expected a positive integer)" << endl;
+        return -1;
+      }
+    }
+
+    // -l: longest job line in bytes (0 for no limit)
+    else if (strcmp(arg, "-l") == 0) {
+      char *length = get_arg(idx, argc, argv);
+      if (!parse_count(length, max_line_length)) {
+        cerr << "USAGE: Invalid line length " << length << " (expected a non-negative integer)" << endl;
+        return -1;
+      }
+    }
+
+    // -m: memory limit in bytes for each job (0 for no limit)
+    else if (strcmp(arg, "-m") == 0) {
+      char *limit = get_arg(idx, argc, argv);
+      unsigned long bytes;
+      if (!parse_count(limit, bytes)) {
+        cerr << "USAGE: Invalid memory limit " << limit << " (expected a number of bytes)" << endl;
+        return -1;
+      }
+      setMemoryLimit(bytes);
+    }
+
+    // everything else is invalid
+    else {
+      cerr << "USAGE: Invalid command line option: " << arg << endl;
+      return -1;
+    }
+  }
+
+  if (num_workers == 0) num_workers = 1;
+  if (queue_size == 0) queue_size = num_workers * 4;
+
+  int listen_fd;
+  try {
+    listen_fd = listen_unix(socket_path, 128);
+  }
+  catch (EgretException const &e) {
+    cerr << e.getError() << endl;
+    return -1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  jobs = new WorkQueue <ComputationPtr>(queue_size);
+  for (unsigned int i = 0; i < num_workers; i++) {
+    thread(worker).detach();
+  }
+  cerr << "egretd: listening on " << socket_path << " with " << num_workers
+    << " workers" << endl;
+
+  while (true) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) continue;
+
+    // turn away connections over the limit rather than queueing them
+    if (connections >= max_connections) {
+      SocketLines conn(fd);
+      conn.write_line(job_result(0, "", job_error("ERROR: Server busy")));
+      rejected_count++;
+      continue;
+    }
+    connections++;
+    thread(serve_connection, fd).detach();
+  }
+
+  return 0;
+}
+
+static void
+worker()
+{
+  ComputationPtr comp;
+  while (jobs->pop(comp)) {
+    // anything thrown here must still finish the job, or its waiters would
+    // block forever and the key would stay in flight
+    string fields;
+    try {
+      fields = run_job(comp->regex, comp->base_substring, comp->options);
+    }
+    catch (EgretException const &e) {
+      fields = job_error(e.getError());
+    }
+    catch (exception const &e) {
+      fields = job_error("ERROR (internal): " + string(e.what()));
+    }
+    computed_count++;
+
+    // later requests for the same key must start a new job
+    {
+      lock_guard <mutex> guard(in_flight_lock);
+      in_flight.erase(comp->key);
+    }
+
+    lock_guard <mutex> guard(comp->lock);
+    comp->fields = fields;
+    comp->done = true;
+    comp->finished.notify_all();
+  }
+}
+
+static void
+serve_connection(int fd)
+{
+  SocketLines conn(fd, max_line_length);
+  unsigned long line_number = 0;
+  string line;
+
+  while (conn.read_line(line)) {
+    line_number++;
+    request_count++;
+
+    string fields;
+    JobRequest job;
+    try {
+      if (conn.line_too_long()) {
+        stringstream s;
+        s << "ERROR: Job is longer than " << max_line_length << " bytes";
+        throw EgretException(s.str());
+      }
+      JsonObject object = parse_json_object(line);
+      if (object.find("command") != object.end() && object["command"].text == "stats") {
+        fields = stats_fields();
+      }
+      else {
+        parse_json_job(line, job);
+        fields = submit(job);
+      }
+    }
+    catch (EgretException const &e) {
+      fields = job_error(e.getError());
+    }
+    catch (exception const &e) {
+      fields = job_error("ERROR (internal): " + string(e.what()));
+    }
+
+    if (!conn.write_line(job_result(line_number, job.id, fields))) break;
+  }
+
+  connections--;
+}
+
+static string
+submit(const JobRequest &job)
+{
+  string key = job.regex + '\0' + job.base_substring + '\0' + job.options.get_key();
+  ComputationPtr comp;
+  bool is_new = false;
+
+  {
+    lock_guard <mutex> guard(in_flight_lock);
+    map <string, ComputationPtr>::iterator it = in_flight.find(key);
+    if (it != in_flight.end()) {
+      comp = it->second;
+      coalesced_count++;
+    }
+    else {
+      comp = make_shared <Computation>();
+      comp->key = key;
+      comp->regex = job.regex;
+      comp->base_substring = job.base_substring;
+      comp->options = job.options;
+      comp->done = false;
+      in_flight[key] = comp;
+      is_new = true;
+    }
+  }
+
+  // blocks while the queue is full, which stops this connection from reading
+  if (is_new) jobs->push(comp);
+
+  unique_lock <mutex> guard(comp->lock);
+  while (!comp->done) comp->finished.wait(guard);
+  return comp->fields;
+}
+
+static string
+stats_fields()
+{
+  stringstream s;
+  s << "\"status\":\"SUCCESS\",\"stats\":{"
+    << "\"Requests\":" << request_count
+    << ",\"Computed jobs\":" << computed_count
+    << ",\"Coalesced requests\":" << coalesced_count
+    << ",\"Rejected connections\":" << rejected_count
+    << ",\"Open connections\":" << connections << "}";
+  return s.str();
+}
+
+static char *
+get_arg(int &idx, int argc, char **argv)
+{
+  char *arg;
+
+  if (idx >= argc) {
+    cerr << "USAGE: Invalid command line" << endl << endl;
+    exit(-1);
+  }
+
+  arg = argv[idx];
+  idx++;
+
+  return arg;
+}
@@ -23,7 +23,8 @@
 #include "error.h"
 using namespace std;
 
-static string warnings = "";
+// warnings are per thread so engine runs on different threads stay separate
+static thread_local string warnings = "";
 
 void
 clearWarnings()
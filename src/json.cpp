@@ -0,0 +1,217 @@
+/*  json.cpp: minimal JSON support for line-oriented job input and output
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Unicode.h"
+#include "json.h"
+#include "error.h"
+using namespace std;
+
+static void skip_space(const string &line, unsigned int &idx);
+static void expect(const string &line, unsigned int &idx, char c);
+static string parse_string(const string &line, unsigned int &idx);
+static string parse_literal(const string &line, unsigned int &idx);
+
+JsonObject
+parse_json_object(const string &line)
+{
+  JsonObject object;
+  unsigned int idx = 0;
+
+  skip_space(line, idx);
+  expect(line, idx, '{');
+  skip_space(line, idx);
+  if (idx < line.length() && line[idx] == '}') {
+    idx++;
+  }
+  else {
+    while (true) {
+      skip_space(line, idx);
+      string name = parse_string(line, idx);
+      skip_space(line, idx);
+      expect(line, idx, ':');
+      skip_space(line, idx);
+
+      JsonValue value;
+      if (idx < line.length() && line[idx] == '"') {
+        value.is_string = true;
+        value.text = parse_string(line, idx);
+      }
+      else {
+        value.is_string = false;
+        value.text = parse_literal(line, idx);
+      }
+      object[name] = value;
+
+      skip_space(line, idx);
+      if (idx < line.length() && line[idx] == ',') {
+        idx++;
+        continue;
+      }
+      expect(line, idx, '}');
+      break;
+    }
+  }
+
+  skip_space(line, idx);
+  if (idx != line.length()) {
+    throw EgretException("ERROR: JSON - unexpected text after object");
+  }
+  return object;
+}
+
+string
+json_value(const JsonValue &value)
+{
+  if (value.is_string) return json_string(value.text);
+  return value.text;
+}
+
+string
+json_string(const string &s)
+{
+  string result = "\"";
+  for (unsigned int i = 0; i < s.length(); i++) {
+    char c = s[i];
+    switch (c) {
+    case '"':	result += "\\\""; break;
+    case '\\':	result += "\\\\"; break;
+    case '\n':	result += "\\n"; break;
+    case '\r':	result += "\\r"; break;
+    case '\t':	result += "\\t"; break;
+    default:
+      if ((unsigned char) c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        result += buf;
+      }
+      else {
+        result += c;
+      }
+    }
+  }
+  result += "\"";
+  return result;
+}
+
+string
+json_string_list(const vector <string> &strs)
+{
+  string result = "[";
+  for (unsigned int i = 0; i < strs.size(); i++) {
+    if (i > 0) result += ",";
+    result += json_string(strs[i]);
+  }
+  result += "]";
+  return result;
+}
+
+static void
+skip_space(const string &line, unsigned int &idx)
+{
+  while (idx < line.length() && isspace(line[idx])) idx++;
+}
+
+static void
+expect(const string &line, unsigned int &idx, char c)
+{
+  if (idx >= line.length() || line[idx] != c) {
+    stringstream s;
+    s << "ERROR: JSON - expected '" << c << "' at offset " << idx;
+    throw EgretException(s.str());
+  }
+  idx++;
+}
+
+static string
+parse_string(const string &line, unsigned int &idx)
+{
+  expect(line, idx, '"');
+
+  string s;
+  while (idx < line.length() && line[idx] != '"') {
+    char c = line[idx++];
+    if (c != '\\') {
+      s += c;
+      continue;
+    }
+    if (idx >= line.length()) break;
+    c = line[idx++];
+    switch (c) {
+    case '"':	s += '"'; break;
+    case '\\':	s += '\\'; break;
+    case '/':	s += '/'; break;
+    case 'b':	s += '\b'; break;
+    case 'f':	s += '\f'; break;
+    case 'n':	s += '\n'; break;
+    case 'r':	s += '\r'; break;
+    case 't':	s += '\t'; break;
+    case 'u':
+    {
+      if (idx + 4 > line.length()) {
+        throw EgretException("ERROR: JSON - truncated \\u escape");
+      }
+      unsigned int code_point;
+      stringstream hex(line.substr(idx, 4));
+      if (!(hex >> std::hex >> code_point)) {
+        throw EgretException("ERROR: JSON - invalid \\u escape");
+      }
+      idx += 4;
+      append_utf8(s, code_point);
+      break;
+    }
+    default:
+    {
+      stringstream e;
+      e << "ERROR: JSON - invalid escape \\" << c;
+      throw EgretException(e.str());
+    }
+    }
+  }
+
+  expect(line, idx, '"');
+  return s;
+}
+
+static string
+parse_literal(const string &line, unsigned int &idx)
+{
+  unsigned int start = idx;
+  while (idx < line.length() && line[idx] != ',' && line[idx] != '}' &&
+      !isspace(line[idx])) {
+    idx++;
+  }
+
+  string literal = line.substr(start, idx - start);
+  if (literal == "true" || literal == "false" || literal == "null") return literal;
+
+  // must be a number
+  stringstream s(literal);
+  double number;
+  if (literal == "" || !(s >> number) || !s.eof()) {
+    throw EgretException("ERROR: JSON - invalid value " + literal);
+  }
+  return literal;
+}
@@ -0,0 +1,52 @@
+/*  json.h: minimal JSON support for line-oriented job input and output
+
+    Copyright (C) 2016  Eric Larson and Anna Kirk
+    elarson@seattleu.edu
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// A scalar JSON value.  Strings are stored decoded, everything else (numbers,
+// true, false, null) is stored as its literal text.
+struct JsonValue
+{
+  bool is_string;
+  string text;
+};
+
+typedef map <string, JsonValue> JsonObject;
+
+// parses a flat JSON object (scalar values only), throws EgretException on error
+JsonObject parse_json_object(const string &line);
+
+// returns the value as JSON text
+string json_value(const JsonValue &value);
+
+// returns s as a quoted and escaped JSON string
+string json_string(const string &s);
+
+// returns strs as a JSON array of strings
+string json_string_list(const vector <string> &strs);
+
+#endif // JSON_H
@@ -19,15 +19,24 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <random>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
+#include "BinaryOutput.h"
+#include "JobServer.h"
+#include "MemoryUsage.h"
+#include "Trace.h"
 #include "egret.h"
 using namespace std;
 
 static char *get_arg(int &idx, int argc, char **argv);
+static void read_rules(istream &in, vector <string> &regexes);
+static void print_ruleset(RuleSet &ruleset);
 
 int
 main(int argc, char *argv[])
@@ -37,6 +46,21 @@ main(int argc, char *argv[])
   string base_substring = "evil";
   bool debug_mode = false;
   bool stat_mode = false;
+  bool serve_mode = false;
+  char *job_file = NULL;
+  char *rule_file = NULL;
+  unsigned long sample_count = 0;
+  bool sample_mode = false;
+  bool estimate_mode = false;
+  unsigned long seed = 0;
+  unsigned int min_length = 0;
+  unsigned int max_length = 32;
+  unsigned int loop_cap = 8;
+  bool regex_lines = false;
+  EngineOptions options;
+  char *binary_file = NULL;
+  char *trace_file = NULL;
+  unsigned int num_workers = thread::hardware_concurrency();
 
   // Process arguments
   while (idx < argc) {
@@ -72,6 +96,23 @@ main(int argc, char *argv[])
       regexFile.close();
     }
 
+    // -F: file with one regular expression per line ("-" for stdin)
+    // -J: file with one JSON job per line ("-" for stdin)
+    else if (strcmp(arg, "-F") == 0 || strcmp(arg, "-J") == 0) {
+      if (job_file != NULL) {
+	cerr << "USAGE: Can only have one file of jobs to process" << endl;
+	return -1;
+      }
+      regex_lines = (strcmp(arg, "-F") == 0);
+      job_file = get_arg(idx, argc, argv);
+    }
+
+    // -R: file with one rule per line ("-" for stdin) - generates the strings
+    // for all of the rules with one combined NFA
+    else if (strcmp(arg, "-R") == 0) {
+      rule_file = get_arg(idx, argc, argv);
+    }
+
     // -b: base substring for regex strings
     else if (strcmp(arg, "-b") == 0) {
       base_substring = get_arg(idx, argc, argv);
@@ -87,6 +128,112 @@ main(int argc, char *argv[])
       stat_mode = true;
     }
 
+    // --binary: write strings to a file in binary format
+    else if (strcmp(arg, "--binary") == 0) {
+      binary_file = get_arg(idx, argc, argv);
+    }
+
+    // --trace: write a Chrome trace of the run to a file
+    else if (strcmp(arg, "--trace") == 0) {
+      trace_file = get_arg(idx, argc, argv);
+    }
+
+    // --min-cover: use the fewest paths that cover every NFA edge
+    else if (strcmp(arg, "--min-cover") == 0) {
+      options.traversal = MIN_COVER_TRAVERSAL;
+    }
+
+    // --minimize: drop strings that add no edge or input coverage
+    else if (strcmp(arg, "--minimize") == 0) {
+      options.minimize = true;
+    }
+
+    // --shard: generate strings for shard i of N (numbered from 0)
+    else if (strcmp(arg, "--shard") == 0) {
+      char *shard = get_arg(idx, argc, argv);
+      if (!options.set_shard(shard)) {
+        cerr << "USAGE: Invalid shard " << shard << " (expected i/N with 0 <= i < N)" << endl;
+        return -1;
+      }
+    }
+
+    // --mutate: mutations applied to path strings (comma separated or "all")
+    else if (strcmp(arg, "--mutate") == 0) {
+      char *mutations = get_arg(idx, argc, argv);
+      if (!options.set_mutations(mutations)) {
+        cerr << "USAGE: Invalid mutations " << mutations << " (expected double_punct, "
+             << "space_before_punct, space_after_punct, remove_space, replace_word or all)" << endl;
+        return -1;
+      }
+    }
+
+    // --sample: print N random strings that match the regex (0 for no limit)
+    else if (strcmp(arg, "--sample") == 0) {
+      sample_mode = true;
+      char *count = get_arg(idx, argc, argv);
+      if (!parse_count(count, sample_count)) {
+        cerr << "USAGE: Invalid sample count " << count << " (expected a non-negative integer)" << endl;
+        return -1;
+      }
+    }
+
+    // --seed: random seed for --sample
+    else if (strcmp(arg, "--seed") == 0) {
+      char *text = get_arg(idx, argc, argv);
+      if (!parse_count(text, seed)) {
+        cerr << "USAGE: Invalid seed " << text << " (expected a non-negative integer)" << endl;
+        return -1;
+      }
+    }
+
+    // --min-length, --max-length: length bounds for --sample
+    else if (strcmp(arg, "--min-length") == 0 || strcmp(arg, "--max-length") == 0) {
+      char *length = get_arg(idx, argc, argv);
+      if (!parse_count(length, (strcmp(arg, "--min-length") == 0) ? min_length : max_length)) {
+        cerr << "USAGE: Invalid length " << length << " (expected a non-negative integer)" << endl;
+        return -1;
+      }
+    }
+
+    // --loop-cap: iterations allowed for unbounded repeats in --sample
+    else if (strcmp(arg, "--loop-cap") == 0) {
+      char *cap = get_arg(idx, argc, argv);
+      if (!parse_count(cap, loop_cap)) {
+        cerr << "USAGE: Invalid loop cap " << cap << " (expected a non-negative integer)" << endl;
+        return -1;
+      }
+    }
+
+    // --estimate: print the predicted paths, strings and bytes instead of the strings
+    else if (strcmp(arg, "--estimate") == 0) {
+      estimate_mode = true;
+    }
+
+    // --serve-stdin: run JSON jobs read from stdin (one per line)
+    else if (strcmp(arg, "--serve-stdin") == 0) {
+      serve_mode = true;
+    }
+
+    // -j: number of worker threads for --serve-stdin, -F and -J
+    else if (strcmp(arg, "-j") == 0) {
+      char *workers = get_arg(idx, argc, argv);
+      if (!parse_count(workers, num_workers) || num_workers == 0) {
+        cerr << "USAGE: Invalid number of workers " << workers << " (expected a positive integer)" << endl;
+        return -1;
+      }
+    }
+
+    // -m: memory limit in bytes for each regex (0 for no limit)
+    else if (strcmp(arg, "-m") == 0) {
+      char *limit = get_arg(idx, argc, argv);
+      unsigned long bytes;
+      if (!parse_count(limit, bytes)) {
+        cerr << "USAGE: Invalid memory limit " << limit << " (expected a number of bytes)" << endl;
+        return -1;
+      }
+      setMemoryLimit(bytes);
+    }
+
     // everything else is invalid
     else {
       cerr << "USAGE: Invalid command line option: " << arg << endl;
@@ -94,12 +241,161 @@ main(int argc, char *argv[])
     }
   }
 
+  // spans are only recorded on the thread that runs the engine directly
+  if (trace_file != NULL && (job_file != NULL || serve_mode || sample_mode || estimate_mode)) {
+    cerr << "USAGE: Cannot combine --trace with -F, -J, --serve-stdin, --sample or --estimate" << endl;
+    return -1;
+  }
+
+  if (rule_file != NULL) {
+    if (regex != "" || job_file != NULL || serve_mode) {
+      cerr << "USAGE: Cannot combine a ruleset with other regular expressions or jobs" << endl;
+      return -1;
+    }
+    if (binary_file != NULL || estimate_mode || sample_mode) {
+      cerr << "USAGE: Cannot combine a ruleset with --binary, --estimate or --sample" << endl;
+      return -1;
+    }
+
+    vector <string> regexes;
+    if (strcmp(rule_file, "-") == 0) {
+      read_rules(cin, regexes);
+    }
+    else {
+      ifstream ruleFile(rule_file);
+      if (!ruleFile.is_open()) {
+        cerr << "USAGE: Unable to open file " << rule_file << endl;
+        return -1;
+      }
+      read_rules(ruleFile, regexes);
+    }
+
+    if (trace_file != NULL) startTrace();
+    RuleSet ruleset;
+    string status = run_ruleset(regexes, base_substring, ruleset, stat_mode, options);
+    if (trace_file != NULL) {
+      stopTrace();
+      ofstream traceFile(trace_file);
+      if (!traceFile.is_open()) {
+        cerr << "USAGE: Unable to open file " << trace_file << endl;
+        return -1;
+      }
+      traceFile << getTraceJson();
+    }
+
+    cout << status << endl;
+    if (status.substr(0, 5) != "ERROR") print_ruleset(ruleset);
+    return 0;
+  }
+
+  if (job_file != NULL) {
+    if (regex != "" || serve_mode) {
+      cerr << "USAGE: Cannot combine a file of jobs with a regular expression or --serve-stdin" << endl;
+      return -1;
+    }
+
+    JobRequest defaults;
+    defaults.base_substring = base_substring;
+    defaults.options = options;
+
+    if (strcmp(job_file, "-") == 0) {
+      run_job_file(cin, cout, num_workers, regex_lines, defaults);
+      return 0;
+    }
+    ifstream jobFile(job_file);
+    if (!jobFile.is_open()) {
+      cerr << "USAGE: Unable to open file " << job_file << endl;
+      return -1;
+    }
+    run_job_file(jobFile, cout, num_workers, regex_lines, defaults);
+    return 0;
+  }
+
+  if (serve_mode) {
+    if (regex != "") {
+      cerr << "USAGE: Cannot specify a regular expression with --serve-stdin" << endl;
+      return -1;
+    }
+    serve_json_jobs(cin, cout, num_workers);
+    return 0;
+  }
+
   if (regex == "") {
     cerr << "USAGE: Did not find a regular expression to process" << endl;
     return -1;
   }
 
-  vector <string> test_strings = run_engine(regex, base_substring, debug_mode, stat_mode);
+  if (sample_mode) {
+    if (estimate_mode || binary_file != NULL) {
+      cerr << "USAGE: Cannot combine --sample with --estimate or --binary" << endl;
+      return -1;
+    }
+    if (min_length > max_length) {
+      cerr << "USAGE: Minimum length " << min_length << " is greater than maximum length "
+           << max_length << endl;
+      return -1;
+    }
+
+    RegexSampler sampler;
+    string status = build_sampler(regex, sampler, min_length, max_length, loop_cap);
+    cout << status << endl;
+    if (status.substr(0, 5) == "ERROR") return 0;
+
+    mt19937_64 rng(seed);
+    string sample;
+    for (unsigned long i = 0; sample_count == 0 || i < sample_count; i++) {
+      if (!sampler.sample(rng, sample)) break;
+      cout << sample << '\n';
+    }
+    return 0;
+  }
+
+  if (estimate_mode) {
+    TestEstimate estimate;
+    string status = estimate_engine(regex, estimate, base_substring, options);
+    cout << status << endl;
+    if (status.substr(0, 5) == "ERROR") return 0;
+
+    cout << "Paths: " << estimate.paths << endl;
+    cout << "Strings: " << estimate.strings << endl;
+    cout << "Bytes: " << estimate.bytes << endl;
+    return 0;
+  }
+
+  if (trace_file != NULL) startTrace();
+  vector <string> test_strings = run_engine(regex, base_substring, debug_mode, stat_mode,
+      options);
+
+  if (trace_file != NULL) {
+    stopTrace();
+    ofstream traceFile(trace_file);
+    if (!traceFile.is_open()) {
+      cerr << "USAGE: Unable to open file " << trace_file << endl;
+      return -1;
+    }
+    traceFile << getTraceJson();
+  }
+
+  if (binary_file != NULL) {
+    ofstream binaryFile(binary_file, ios::binary);
+    if (!binaryFile.is_open()) {
+      cerr << "USAGE: Unable to open file " << binary_file << endl;
+      return -1;
+    }
+
+    // classify the strings when the regex can be matched natively
+    vector <StringClass> classes;
+    RegexMatcher matcher;
+    if (test_strings[0].substr(0, 5) != "ERROR" &&
+        build_matcher(regex, matcher).substr(0, 5) != "ERROR" && matcher.is_supported()) {
+      for (unsigned int i = 1; i < test_strings.size(); i++) {
+        classes.push_back(matcher.classify(test_strings[i]));
+      }
+    }
+    write_binary_output(binaryFile, test_strings, classes);
+    return 0;
+  }
+
   vector <string>::iterator it;
   for (it = test_strings.begin(); it != test_strings.end(); it++) {
     cout << *it << endl;
@@ -108,6 +404,45 @@ main(int argc, char *argv[])
   return 0;
 }
 
+// reads one rule per line (skipping empty lines)
+static void
+read_rules(istream &in, vector <string> &regexes)
+{
+  string line;
+  while (getline(in, line)) {
+    if (line != "" && line[line.length() - 1] == '\r') {
+      line.erase(line.length() - 1);
+    }
+    if (line != "") regexes.push_back(line);
+  }
+}
+
+// prints each rule with its status and strings - each string is followed by
+// a tab and the rules that match it
+static void
+print_ruleset(RuleSet &ruleset)
+{
+  const vector <string> &strings = ruleset.get_strings();
+  for (unsigned int rule = 0; rule < ruleset.get_num_rules(); rule++) {
+    cout << "Rule " << rule << ": " << ruleset.get_regex(rule) << endl;
+    string status = ruleset.get_status(rule);
+    cout << status;
+    if (status[status.length() - 1] != '\n') cout << endl;
+
+    const vector <unsigned int> &rule_strings = ruleset.get_rule_strings(rule);
+    vector <unsigned int>::const_iterator it;
+    for (it = rule_strings.begin(); it != rule_strings.end(); it++) {
+      cout << strings[*it] << '\t';
+      const vector <unsigned int> &matches = ruleset.get_matching_rules(*it);
+      for (unsigned int i = 0; i < matches.size(); i++) {
+        if (i > 0) cout << ' ';
+        cout << matches[i];
+      }
+      cout << '\n';
+    }
+  }
+}
+
 static char *
 get_arg(int &idx, int argc, char **argv)
 {
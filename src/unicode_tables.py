@@ -0,0 +1,89 @@
+# unicode_tables.py: Generates UnicodeTables.cpp from Python's unicodedata
+#
+# Copyright (C) 2016  Eric Larson and Anna Kirk
+# elarson@seattleu.edu
+#
+# This file is part of EGRET.
+#
+# EGRET is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# EGRET is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with EGRET.  If not, see <http://www.gnu.org/licenses/>.
+
+# The classes match Python's re module for str patterns, so the engine agrees
+# with the matcher used to check its strings.  Run with the Python whose
+# Unicode version should be used: python3 unicode_tables.py > UnicodeTables.cpp
+
+import re
+import sys
+import unicodedata
+
+MAX_CODE_POINT = 0x10FFFF
+
+def find_intervals(pattern):
+    regex = re.compile(pattern)
+    intervals = []
+    start = None
+    for c in range(MAX_CODE_POINT + 1):
+        member = not (0xD800 <= c <= 0xDFFF) and regex.match(chr(c)) is not None
+        if member and start is None:
+            start = c
+        elif not member and start is not None:
+            intervals.append((start, c - 1))
+            start = None
+    if start is not None:
+        intervals.append((start, MAX_CODE_POINT))
+    return intervals
+
+def write_table(out, name, intervals):
+    out.write("const CharInterval %s[] = {\n" % name)
+    for i in range(0, len(intervals), 4):
+        row = ", ".join("{0x%04X, 0x%04X}" % iv for iv in intervals[i:i + 4])
+        out.write("  %s,\n" % row)
+    out.write("};\n")
+    out.write("const unsigned int %s_COUNT = %d;\n" % (name, len(intervals)))
+
+out = sys.stdout
+out.write("""/*  UnicodeTables.cpp: Code point intervals for the Unicode character classes
+
+    Generated by unicode_tables.py from Unicode %s - do not edit.
+
+    This file is part of EGRET.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Unicode.h"
+
+extern const CharInterval WORD_INTERVALS[];
+extern const unsigned int WORD_INTERVALS_COUNT;
+extern const CharInterval DIGIT_INTERVALS[];
+extern const unsigned int DIGIT_INTERVALS_COUNT;
+extern const CharInterval SPACE_INTERVALS[];
+extern const unsigned int SPACE_INTERVALS_COUNT;
+
+""" % unicodedata.unidata_version)
+write_table(out, "WORD_INTERVALS", find_intervals(r"\w"))
+out.write("\n")
+write_table(out, "DIGIT_INTERVALS", find_intervals(r"\d"))
+out.write("\n")
+write_table(out, "SPACE_INTERVALS", find_intervals(r"\s"))